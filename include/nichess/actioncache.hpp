@@ -0,0 +1,47 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace nichess {
+
+/*
+ * Legal actions of every piece, generated when first asked for and kept until a square the piece's
+ * actions depend on changes: its own square, the squares its rays reach up to the first piece
+ * (the second one behind a piece it can throw), its neighborhood or its pawn and knight squares.
+ * Health point changes that leave the owners of squares as they were only affect the piece on
+ * the changed square.
+ *
+ * Observes game from construction to destruction, so it mustn't outlive it.
+ */
+class ActionCache: public SquareObserver {
+  public:
+    // Lists served from the cache and lists generated.
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+
+    ActionCache(Game& observed);
+    ~ActionCache();
+    ActionCache(const ActionCache&) = delete;
+    ActionCache& operator=(const ActionCache&) = delete;
+    void squareChanged(int squareIndex, const Piece& before, const Piece& after) override;
+    void refresh(const Game& game) override;
+
+    // Legal actions of the piece on squareIndex, whichever player it belongs to.
+    const std::vector<PlayerAction>& actionsAt(int squareIndex);
+    // Squares whose actions are currently cached.
+    uint64_t cachedSquares() const;
+
+  private:
+    Game& game;
+    std::vector<PlayerAction> actions[NUM_SQUARES];
+    // Squares read when generating actions[i].
+    uint64_t dependencies[NUM_SQUARES];
+    uint64_t valid;
+
+    uint64_t computeDependencies(int squareIndex) const;
+};
+
+} // namespace nichess
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+
+#include <cstdint>
+
+namespace nichess {
+
+/*
+ * Squares every piece can hit with a single target ability, kept up to date from the square
+ * changes of the observed game. Own pieces' squares count as attacked, like defended squares in
+ * chess. Rays end at the first occupied square. Throws need two pieces and aren't included.
+ *
+ * A changed square only touches the attacks of the piece on it and of the mages, warriors and
+ * assassins whose rays reach it.
+ */
+class AttackMap: public SquareObserver {
+  public:
+    AttackMap();
+    void squareChanged(int squareIndex, const Piece& before, const Piece& after) override;
+    void refresh(const Game& game) override;
+
+    // Squares of player's pieces that can hit squareIndex.
+    uint64_t attackers(Player player, int squareIndex) const;
+    int attackCount(Player player, int squareIndex) const;
+    bool isAttacked(Player player, int squareIndex) const;
+    // Squares hit by the piece on squareIndex, empty if there is none.
+    uint64_t attacksFrom(int squareIndex) const;
+    // Every square hit by at least one of player's pieces.
+    uint64_t attackedSquares(Player player) const;
+
+  private:
+    PieceType types[NUM_SQUARES];
+    uint64_t occupied;
+    uint64_t pieceAttacks[NUM_SQUARES];
+    uint64_t attackersBySquare[NUM_PLAYERS][NUM_SQUARES];
+
+    uint64_t computeAttacks(int squareIndex) const;
+    void removeAttacks(int squareIndex);
+    void addAttacks(int squareIndex);
+    // Sliders whose rays reach squareIndex, as a bitset of their squares.
+    uint64_t slidersThrough(int squareIndex) const;
+};
+
+/*
+ * Squares of the pieces of both players that can hit squareIndex with a single target ability,
+ * computed from scratch. squares holds the piece on every square, occupied the squares that count
+ * as occupied; pieces on other squares are ignored.
+ */
+uint64_t attackersOf(const Piece squares[], uint64_t occupied, int squareIndex);
+
+} // namespace nichess
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+
+#include <charconv>
+#include <cstddef>
+
+namespace nichess {
+
+/*
+ * The text format of Game::boardToString and Game::boardFromString, for example
+ * "0|0-warrior-60,0-knight-60,...,empty,...," with the side to move before the bar and every
+ * square followed by a comma. Neither direction allocates.
+ */
+
+// Enough room for any board, health points included.
+const size_t MAX_BOARD_STRING_SIZE = 2 + NUM_SQUARES * 23;
+
+// Writes to [first, last). Like std::to_chars, ec is std::errc::value_too_large if it doesn't fit.
+std::to_chars_result writeBoard(char* first, char* last, const Piece squares[], Player player);
+std::to_chars_result writeBoard(char* first, char* last, const Game& game);
+/*
+ * Parses one board from [first, last) into the piece on every square, ptr points past the last
+ * square's comma. ec is std::errc::invalid_argument if the text isn't a board, the squares are
+ * then unspecified. A Game can be set up from the result with Game::setPosition.
+ */
+std::from_chars_result parseBoard(const char* first, const char* last, Piece squares[], Player& player);
+
+} // namespace nichess
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace nichess {
+
+const uint32_t BOOK_MAGIC = 0x314B'424E; // "NBK1"
+const uint32_t BOOK_VERSION = 2;
+const int BOOK_HEADER_SIZE = 32;
+
+/*
+ * One book action. Entries are sorted by key and, within a position, by decreasing weight.
+ */
+class BookEntry {
+  public:
+    // canonicalKey of the position before the action.
+    uint64_t key;
+    // Mirrored if the key is the mirror image's.
+    PackedAction action;
+    // Number of games that played the action, saturates at UINT16_MAX.
+    uint16_t weight;
+    // Average result of those games for the player making the action, in [-1000, 1000].
+    int16_t score;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(BookEntry) == 16, "BookEntry is stored as is in the book file");
+
+/*
+ * Collects statistics from complete games and writes them as a book file.
+ *
+ * File format:
+ *   header (32 bytes): magic, version, number of entries, reserved
+ *   BookEntry per entry
+ */
+class OpeningBookBuilder {
+  public:
+    // Only the first maxPly positions of every game are added.
+    int maxPly = 20;
+    // Actions played in fewer games are left out of the file.
+    int minGames = 1;
+
+    // Replays actions from the start position. winner is empty for a draw.
+    void addGame(const std::vector<PlayerAction>& actions, std::optional<Player> winner);
+    size_t numGames() const;
+    // Returns the number of entries written. Throws std::runtime_error if the file can't be written.
+    size_t write(const std::string& path) const;
+
+  private:
+    class ActionStats {
+      public:
+        uint32_t games = 0;
+        int32_t scoreSum = 0; // +1 per win, -1 per loss
+    };
+
+    size_t games = 0;
+    std::unordered_map<uint64_t, std::map<PackedAction, ActionStats>> positions;
+};
+
+/*
+ * Memory-mapped book. Loading maps the file and checks the header, probing is an interpolation
+ * search over the sorted keys, which are close to uniformly distributed.
+ */
+class OpeningBook {
+  public:
+    OpeningBook();
+    OpeningBook(const OpeningBook& other) = delete;
+    OpeningBook& operator=(const OpeningBook& other) = delete;
+    ~OpeningBook();
+    // Throws std::runtime_error if the file can't be mapped or has the wrong format.
+    void load(const std::string& path);
+    // Entries [first, last) of key, a canonicalKey, empty if the position isn't in the book.
+    void find(uint64_t key, const BookEntry*& first, const BookEntry*& last) const;
+    // The book action with the highest weight that is legal in game.
+    std::optional<PlayerAction> bestAction(Game& game) const;
+    // Picks a legal book action with probability proportional to its weight, random is any
+    // uniformly distributed number.
+    std::optional<PlayerAction> sampleAction(Game& game, uint64_t random) const;
+    size_t size() const;
+
+  private:
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    const BookEntry* entries = nullptr;
+    size_t numEntries = 0;
+
+    void unload();
+};
+
+} // namespace nichess
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+#include "nichess/mcts.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nichess {
+
+/*
+ * One leaf position waiting for the batch callback. game, actions and priors belong to the
+ * submitting thread, which is blocked until the batch is done.
+ */
+class BrokerRequest {
+  public:
+    Game* game;
+    const std::vector<PlayerAction>* actions;
+    // Filled by the batch callback, one probability per action.
+    std::vector<float>* priors;
+    // Filled by the batch callback, value for game->currentPlayer in [-1, 1].
+    float value = 0;
+    bool done = false;
+    std::exception_ptr error;
+};
+
+/*
+ * Collects leaf evaluations from any number of threads into batches for a neural network.
+ * A batch is handed to the callback on the broker's own thread as soon as batchSize requests
+ * are waiting, or when the oldest waiting request is older than timeout.
+ * With fewer submitting threads than batchSize every batch waits for the timeout.
+ */
+class EvaluationBroker {
+  public:
+    typedef std::function<void(std::vector<BrokerRequest*>& batch)> BatchCallback;
+
+    EvaluationBroker(BatchCallback evaluateBatch, int maxBatchSize = 32, std::chrono::microseconds batchTimeout = std::chrono::microseconds(1000));
+    EvaluationBroker(const EvaluationBroker& other) = delete;
+    EvaluationBroker& operator=(const EvaluationBroker& other) = delete;
+    ~EvaluationBroker();
+    // Blocks until the batch containing this position has been evaluated. Exceptions thrown by
+    // the callback are rethrown here.
+    float evaluate(Game& game, const std::vector<PlayerAction>& actions, std::vector<float>& priors);
+    uint64_t numBatches() const;
+    uint64_t numRequests() const;
+    double averageBatchSize() const;
+
+  private:
+    BatchCallback callback;
+    size_t batchSize;
+    std::chrono::microseconds timeout;
+    std::mutex mutex;
+    std::condition_variable requestAdded;
+    std::condition_variable batchDone;
+    std::vector<BrokerRequest*> pending;
+    std::chrono::steady_clock::time_point oldestPending;
+    bool stopping = false;
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> requests;
+    std::thread worker;
+
+    void run();
+};
+
+/*
+ * Leaf evaluator for MCTS that goes through a broker. Give every search thread its own
+ * BrokerEvaluator, all of them can share one broker.
+ */
+class BrokerEvaluator: public LeafEvaluator {
+  public:
+    BrokerEvaluator(EvaluationBroker* evaluationBroker);
+    float evaluate(Game& game, const std::vector<PlayerAction>& actions, std::vector<float>& priors) override;
+
+  private:
+    EvaluationBroker* broker;
+};
+
+} // namespace nichess
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+
+namespace nichess {
+
+// Value of each piece type at full health points, indexed by PieceType.
+extern const int PIECE_VALUE[NUM_PIECE_TYPE];
+extern const int STARTING_HEALTH_POINTS[NUM_PIECE_TYPE];
+
+/*
+ * Static evaluation used at the leaves of the alpha-beta search.
+ */
+class Evaluator {
+  public:
+    virtual ~Evaluator() {}
+    // Score from the perspective of game.currentPlayer.
+    virtual int evaluate(Game& game) = 0;
+    // Called by the search before the first and after the last evaluate of game. Evaluators that
+    // keep their own incremental state hook into the game here.
+    virtual void attach(Game& game) { }
+    virtual void detach(Game& game) { }
+};
+
+/*
+ * Sum of health points of each side.
+ */
+class MaterialEvaluator: public Evaluator {
+  public:
+    int evaluate(Game& game) override;
+};
+
+/*
+ * Material, piece-square and mobility terms from Game::evalAccumulator plus king danger.
+ */
+class StaticEvaluator: public Evaluator {
+  public:
+    int evaluate(Game& game) override;
+};
+
+// Score from the perspective of game.currentPlayer.
+int evaluate(Game& game);
+// Danger to player's king from enemy pieces around it. Higher is worse for player.
+int kingDanger(Game& game, Player player);
+
+} // namespace nichess
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+
+namespace nichess {
+
+// Exchange value of a king, the game is over when it is killed.
+const int EXCHANGE_KING_VALUE = 20000;
+
+/*
+ * Static damage exchange on one square, the analogue of static exchange evaluation. Both sides take
+ * turns hitting the piece on the square with single target abilities and may stop at any time.
+ * A hit that kills moves the attacker onto the square, where it is the next target, and the side
+ * killing uses its least valuable attacker that can kill. A hit that doesn't kill ends the
+ * exchange, the target's owner is free to answer elsewhere. Sliders lined up behind an attacker
+ * join when it leaves its square. Throws aren't considered.
+ *
+ * Values are in the units of PIECE_VALUE, proportional to health points, and read the board
+ * through Game::syncedSquares without making actions.
+ */
+
+// Gain of action for the player making it, an ability on an enemy piece.
+int damageExchange(Game& game, const PlayerAction& action);
+// Best gain of the enemy of the piece on squareIndex from attacking it, 0 if it shouldn't.
+int squareExchange(Game& game, int squareIndex);
+
+} // namespace nichess
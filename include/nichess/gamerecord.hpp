@@ -0,0 +1,112 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace nichess {
+
+const uint32_t GAME_RECORD_MAGIC = 0x3152'474E; // "NGR1"
+const uint32_t GAME_RECORD_VERSION = 2;
+const int GAME_RECORD_HEADER_SIZE = 32;
+const int DEFAULT_CHECKPOINT_INTERVAL = 32;
+
+/*
+ * Writes games to a record file as they come, only the index is kept in memory.
+ *
+ * Every checkpointInterval plies the position is stored as well, so that any position can be set
+ * up by replaying fewer than checkpointInterval actions. Checkpoints stop at the first position
+ * without both kings.
+ *
+ * File format:
+ *   header (32 bytes): magic, version, number of games, offset of the index, checkpoint interval,
+ *     reserved
+ *   per game: number of actions as a varint, result byte (winning player, 2 for none), number of
+ *     checkpoints as a varint, start position as written by packPosition, PackedAction per
+ *     action, packed position per checkpoint
+ *   index: offset of every game from the start of the file, 8 bytes each, 8 byte aligned
+ */
+class GameRecordWriter {
+  public:
+    // 0 for no checkpoints. Can't change after the first game.
+    int checkpointInterval = DEFAULT_CHECKPOINT_INTERVAL;
+
+    // Throws std::runtime_error if the file can't be created.
+    GameRecordWriter(const std::string& filePath);
+    GameRecordWriter(const GameRecordWriter& other) = delete;
+    GameRecordWriter& operator=(const GameRecordWriter& other) = delete;
+    // Finishes the file if finish wasn't called.
+    ~GameRecordWriter();
+    // actions are played from start. winner is empty for a draw or an unfinished game.
+    void addGame(const Game& start, const std::vector<PlayerAction>& actions, std::optional<Player> winner);
+    size_t numGames() const;
+    // Bytes written so far.
+    uint64_t size() const;
+    // Writes the index and the header. Throws std::runtime_error if the file can't be written.
+    void finish();
+
+  private:
+    std::string path;
+    std::ofstream out;
+    std::vector<uint64_t> offsets;
+    uint64_t offset;
+    int writtenInterval = 0;
+    bool finished = false;
+};
+
+/*
+ * One game in a mapped record file, valid as long as the reader that returned it.
+ */
+class RecordedGame {
+  public:
+    std::optional<Player> winner;
+    size_t numActions;
+    size_t numCheckpoints;
+    int checkpointInterval;
+    // Packed start position, actions and checkpoints, in the mapping.
+    const uint8_t* start;
+    const uint8_t* actions;
+    const uint8_t* checkpoints;
+
+    PlayerAction action(size_t ply) const;
+    // Sets game up in the start position.
+    void startPosition(Game& game) const;
+    // Sets game up in the position after ply actions from the closest checkpoint before it.
+    // Repetitions before the checkpoint aren't known.
+    void positionAt(size_t ply, Game& game) const;
+    // Sets game up in the start position and calls f before every action, then once after the
+    // last one with a null action. Actions are made on game in place.
+    void replay(Game& game, const std::function<void(const Game& game, const PlayerAction* next)>& f) const;
+};
+
+/*
+ * Memory-mapped record file. Games are read straight from the mapping.
+ */
+class GameRecordReader {
+  public:
+    GameRecordReader();
+    GameRecordReader(const GameRecordReader& other) = delete;
+    GameRecordReader& operator=(const GameRecordReader& other) = delete;
+    ~GameRecordReader();
+    // Throws std::runtime_error if the file can't be mapped or has the wrong format.
+    void load(const std::string& path);
+    size_t numGames() const;
+    // Throws std::runtime_error if the game's data is out of bounds.
+    RecordedGame game(size_t gameIndex) const;
+
+  private:
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    const uint8_t* index = nullptr;
+    size_t games = 0;
+    int checkpointInterval = 0;
+
+    void unload();
+};
+
+} // namespace nichess
@@ -0,0 +1,259 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+
+namespace nichess {
+
+class OpeningBook;
+
+const uint32_t MCTS_NULL_NODE = UINT32_MAX;
+
+/*
+ * Leaf evaluation for the tree search.
+ */
+class LeafEvaluator {
+  public:
+    virtual ~LeafEvaluator() {}
+    // Returns the value of game for game.currentPlayer in [-1, 1] and fills priors with one
+    // probability per action. game has to be left unchanged.
+    virtual float evaluate(Game& game, const std::vector<PlayerAction>& actions, std::vector<float>& priors) = 0;
+};
+
+/*
+ * Uniform priors, value from a random playout of at most maxPlies plies.
+ * Playouts that don't finish count as a draw.
+ */
+class RandomPlayoutEvaluator: public LeafEvaluator {
+  public:
+    int maxPlies;
+    RandomPlayoutEvaluator(int playoutPlies = 100, unsigned int seed = 0);
+    float evaluate(Game& game, const std::vector<PlayerAction>& actions, std::vector<float>& priors) override;
+
+  private:
+    std::mt19937 rng;
+    std::vector<UndoInfo> undoStack;
+};
+
+/*
+ * Uniform priors, value is the static evaluation squashed to [-1, 1].
+ */
+class StaticLeafEvaluator: public LeafEvaluator {
+  public:
+    // Static evaluation that maps to a value of tanh(1).
+    float scale;
+    StaticLeafEvaluator(float evaluationScale = 400);
+    float evaluate(Game& game, const std::vector<PlayerAction>& actions, std::vector<float>& priors) override;
+};
+
+/*
+ * Forwards to a function, typically a neural network.
+ */
+class CallbackLeafEvaluator: public LeafEvaluator {
+  public:
+    std::function<float(Game&, const std::vector<PlayerAction>&, std::vector<float>&)> callback;
+    CallbackLeafEvaluator(std::function<float(Game&, const std::vector<PlayerAction>&, std::vector<float>&)> evaluateFunction);
+    float evaluate(Game& game, const std::vector<PlayerAction>& actions, std::vector<float>& priors) override;
+};
+
+class MCTSEdge {
+  public:
+    PackedAction action;
+    float prior;
+    // Index of the child node or MCTS_NULL_NODE if the action was never taken.
+    std::atomic<uint32_t> child;
+    // Simulations that went through this edge. Equal to the child's visits unless the child is
+    // shared with other edges.
+    std::atomic<uint32_t> visits;
+};
+
+// Node values are kept in fixed point so that they can be updated with fetch_add.
+const int64_t MCTS_VALUE_SCALE = 1 << 16;
+
+enum class MCTSNodeState: uint8_t {
+  UNEXPANDED, EXPANDING, EXPANDED, TERMINAL
+};
+
+class MCTSNode {
+  public:
+    // Sum of values from the perspective of the player that made the action leading to this node,
+    // multiplied by MCTS_VALUE_SCALE.
+    std::atomic<int64_t> valueSum;
+    std::atomic<uint32_t> visits;
+    // Simulations currently passing through this node, each counts as a lost visit.
+    std::atomic<uint32_t> virtualLoss;
+    // Written by the expanding thread before state is set to EXPANDED.
+    uint32_t firstEdge;
+    uint16_t numEdges;
+    std::atomic<MCTSNodeState> state;
+    // Only used by terminal nodes, from the perspective of the player to move.
+    float terminalValue;
+    // Zobrist hash of the position, never 0.
+    uint64_t key;
+
+    float value() const;
+};
+
+/*
+ * Nodes and edges live in two contiguous arrays allocated once. A node's edges are the
+ * numEdges consecutive edges starting at firstEdge. Allocation is a lock-free bump of the counters.
+ */
+class MCTSArena {
+  public:
+    std::unique_ptr<MCTSNode[]> nodes;
+    std::unique_ptr<MCTSEdge[]> edges;
+    uint32_t nodeCapacity;
+    uint32_t edgeCapacity;
+    std::atomic<uint32_t> numNodes;
+    std::atomic<uint32_t> numEdges;
+
+    MCTSArena(uint32_t maxNodes, uint32_t maxEdges);
+    void clear();
+    // Returns MCTS_NULL_NODE when the arena is full.
+    uint32_t allocateNode();
+    // Returns the index of the first edge or MCTS_NULL_NODE when the arena is full.
+    uint32_t allocateEdges(uint32_t count);
+    size_t memoryUsage() const;
+};
+
+class MCTSLimits {
+  public:
+    // 0 means no limit.
+    uint64_t visits = 0;
+    int moveTime = 0; // milliseconds
+};
+
+class MCTSResult {
+  public:
+    PlayerAction bestAction;
+    // Simulations run by this search.
+    uint64_t visits = 0;
+    // Visits of the root kept from earlier searches.
+    uint64_t reusedVisits = 0;
+    double visitsPerSecond = 0;
+    // Root value for the player to move, in [-1, 1].
+    float value = 0;
+    // Simulations that ran into a node being expanded by another thread and were retried.
+    uint64_t collisions = 0;
+    // Node recycling, see MCTS::recycleNodes.
+    uint64_t collections = 0;
+    uint64_t prunedNodes = 0;
+    double pruneRate = 0; // pruned nodes per second
+    // Bytes used by the tree and bytes allocated for the arenas.
+    size_t memoryUsage = 0;
+    size_t memoryReserved = 0;
+    std::vector<PlayerAction> rootActions;
+    std::vector<uint32_t> rootVisits;
+    // True if the action was taken from the opening book without searching.
+    bool fromBook = false;
+};
+
+/*
+ * Monte Carlo tree search with PUCT selection. Runs one thread per leaf evaluator on a shared tree,
+ * the first thread walks the game passed to search with makeAction/undoAction, the others walk
+ * their own copy of it. Threads are spread over the tree with virtual loss, and a node is only
+ * expanded by the thread that moves it from UNEXPANDED to EXPANDING.
+ */
+class MCTS {
+  public:
+    float cpuct = 1.5f;
+    // Number of lost visits added per simulation passing through a node.
+    uint32_t virtualLoss = 1;
+    // When the arena is full, pause all threads and drop the least visited subtrees so that at
+    // most recycleKeepFraction of the arena stays in use. Memory stays fixed at two arenas.
+    // Otherwise leaves are evaluated without growing the tree.
+    bool recycleNodes = false;
+    float recycleKeepFraction = 0.5f;
+    // Share nodes between transpositions through a hash table keyed by Game::zobristHash, which turns
+    // the tree into a graph. Repetitions and the move counter are not part of the key, actions
+    // leading back to a position on the current path are scored as a draw.
+    bool useTranspositions = false;
+    // Positions found in the book are answered with the book's best action, not owned.
+    const OpeningBook* book = nullptr;
+
+    MCTS(LeafEvaluator* evaluator, uint32_t nodeCapacity = 1 << 20, uint32_t edgeCapacity = 1 << 24);
+    // One search thread per evaluator, evaluators are never shared between threads.
+    MCTS(const std::vector<LeafEvaluator*>& evaluators, uint32_t nodeCapacity = 1 << 20, uint32_t edgeCapacity = 1 << 24);
+    // Continues with the tree of the previous search if advance led it to this position,
+    // otherwise starts a new tree.
+    MCTSResult search(Game& game, const MCTSLimits& limits);
+    // Tells the search that action was played, game is the position after it. The subtree of
+    // action becomes the new tree and the rest is dropped. Call it for every action of both
+    // players between two searches.
+    void advance(Game& game, const PlayerAction& action);
+    void reset();
+    // May be called from any thread.
+    void stop();
+    // Bytes allocated for the arenas.
+    size_t memoryReserved() const;
+    int numThreads() const;
+    const MCTSArena& getArena() const;
+    uint32_t getRoot() const;
+
+  private:
+    class Worker {
+      public:
+        LeafEvaluator* evaluator;
+        std::vector<uint32_t> path;
+        std::vector<UndoInfo> undoStack;
+        std::vector<PlayerAction> actions;
+        std::vector<float> priors;
+        std::vector<uint32_t> edgePath;
+        uint64_t collisions = 0;
+        uint64_t simulations = 0;
+    };
+
+    class MCTSTableEntry {
+      public:
+        std::atomic<uint64_t> key;
+        std::atomic<uint32_t> node;
+    };
+
+    std::vector<Worker> workers;
+    std::unique_ptr<MCTSArena> arena;
+    // Destination of the subtree kept by advance, allocated on first use.
+    std::unique_ptr<MCTSArena> spareArena;
+    uint32_t root;
+    long int rootHash;
+    // Open addressing, allocated while useTranspositions is on.
+    std::unique_ptr<MCTSTableEntry[]> table;
+    size_t tableMask = 0;
+    std::atomic<bool> stopFlag;
+    std::atomic<uint64_t> startedSimulations;
+
+    std::atomic<bool> collectionRequested;
+    std::mutex collectionMutex;
+    std::condition_variable collectionDone;
+    size_t activeWorkers = 0;
+    size_t pausedWorkers = 0;
+    uint64_t collectionGeneration = 0;
+    uint64_t collections = 0;
+    uint64_t prunedNodes = 0;
+
+    void run(Worker& worker, Game& game, const MCTSLimits& limits, std::chrono::steady_clock::time_point deadline);
+    // Returns false if the simulation collided with an expansion and has to be retried.
+    bool simulate(Worker& worker, Game& game);
+    float expand(Worker& worker, uint32_t nodeIdx, Game& game);
+    uint32_t selectEdge(const MCTSNode& node) const;
+    void revert(Worker& worker, Game& game);
+    void compact(uint32_t oldRoot, uint32_t minVisits);
+    void clearTable();
+    void rebuildTable();
+    uint32_t findOrCreateNode(uint64_t key);
+    void collect();
+    void arenaFull();
+    void pauseForCollection();
+    void leaveCollection();
+    void finishCollection();
+};
+
+} // namespace nichess
@@ -3,6 +3,7 @@
 #include "constants.hpp"
 #include "gamecache.hpp"
 
+#include <cstdint>
 #include <vector>
 #include <optional>
 #include <tuple>
@@ -47,6 +48,41 @@ class PlayerAction {
     ActionType actionType;
     PlayerAction();
     PlayerAction(int srcIdx, int dstIdx, ActionType actionType);
+    bool operator==(const PlayerAction& other) const;
+    bool operator!=(const PlayerAction& other) const;
+};
+
+/*
+ * Evaluation terms that are updated incrementally whenever a square changes.
+ * Weights and piece-square tables are in evaluation.cpp.
+ */
+class EvalAccumulator {
+  public:
+    // Material weighted by remaining health points.
+    int material[NUM_PLAYERS];
+    int pieceSquare[NUM_PLAYERS];
+    // Empty squares around each piece, weighted by piece type.
+    int mobility[NUM_PLAYERS];
+
+    EvalAccumulator();
+    void clear();
+    // squares is the board as seen before squareIndex changes to after.
+    void update(const Piece squares[], int squareIndex, const Piece& after);
+    bool operator==(const EvalAccumulator& other) const;
+};
+
+class Game;
+
+/*
+ * Receives the same per-square deltas as Game::evalAccumulator.
+ */
+class SquareObserver {
+  public:
+    virtual ~SquareObserver() {}
+    // Piece or health points on squareIndex changed from before to after.
+    virtual void squareChanged(int squareIndex, const Piece& before, const Piece& after) = 0;
+    // Game state was recomputed from scratch, observer has to do the same.
+    virtual void refresh(const Game& game) = 0;
 };
 
 class UndoInfo {
@@ -57,6 +93,8 @@ class UndoInfo {
     // health points. t1 and t2 are used for that.
     int t1 = -1;
     int t2 = -1;
+    // Bitmask of squares whose piece or health points were changed by the action.
+    uint64_t changedSquares = 0;
     UndoInfo();
     UndoInfo(PlayerAction playerAction);
 };
@@ -70,13 +108,26 @@ class Game {
     int moveNumber;
     std::map<long int, int> repetitions;
     bool repetitionsDraw;
+    // Copy of the board as seen by the incremental accumulators. Only changes through syncSquare.
+    Piece syncedSquares[NUM_SQUARES];
+    EvalAccumulator evalAccumulator;
+    // Not owned and not copied by the copy constructor.
+    std::vector<SquareObserver*> squareObservers;
 
     Game();
     Game(const Game& other);
     Game(const std::string encodedBoard);
     ~Game();
     void undoMove(PlayerAction action);
+    // Legality checks for a single action, without generating the others.
     bool isActionLegal(int srcIdx, int dstIdx);
+    bool isActionLegal(const PlayerAction& action);
+    // Type of the legal action from srcIdx to dstIdx, there is at most one.
+    std::optional<ActionType> legalActionType(int srcIdx, int dstIdx);
+    // True if the other player has an action that damages player's king. Doesn't generate actions.
+    bool isKingThreatened(Player player);
+    // Number of actions of the other player that damage player's king.
+    int kingThreatCount(Player player);
     UndoInfo makeAction(PlayerAction playerAction);
     void undoAction(UndoInfo undoInfo);
     long int zobristHash();
@@ -89,6 +140,7 @@ class Game {
     std::vector<PlayerAction> _p1PawnMoves(Piece* piece);
     std::vector<PlayerAction> _p2PawnMoves(Piece* piece);
     std::vector<PlayerAction> _assassinMoves(Piece* piece);
+    // Actions of the piece, whichever player it belongs to. ActionCache keeps them between actions.
     std::vector<PlayerAction> legalMovesByPiece(Piece* piece);
     std::vector<PlayerAction> legalMovesBySquare(int srcSquareIdx);
     std::vector<PlayerAction> _defaultAbilities(Piece* piece);
@@ -119,15 +171,35 @@ class Game {
     std::vector<Piece*> getAllPiecesByPlayer(Player player);
     std::string boardToString();
     void boardFromString(std::string encodedBoard);
+    // Replaces the position with the given pieces, reusing the board's Piece objects.
+    // Needs exactly one king per player. Move number and repetitions start over.
+    void setPieces(const std::vector<Piece>& pieces, Player player);
+    // Same with squares[i] on square i, squareIndex is ignored. Repetitions start over.
+    void setPosition(const Piece squares[], Player player, int startMoveNumber);
     bool isGameOver();
     bool isGameDraw();
     std::optional<Player> winner();
     std::string dump() const;
     void reset();
+    void syncSquare(int squareIndex);
+    void syncSquares(uint64_t squares);
+    void resyncAll();
+    void addSquareObserver(SquareObserver* observer);
+    void removeSquareObserver(SquareObserver* observer);
 };
 
+/*
+ * 16 bit encoding of a PlayerAction: 6 bits source square, 6 bits destination square and
+ * 4 bits action type, from least to most significant.
+ */
+typedef uint16_t PackedAction;
+PackedAction packAction(const PlayerAction& action);
+PlayerAction unpackAction(PackedAction packedAction);
+
 int coordinatesToBoardIndex(int column, int row);
 std::tuple<int, int> boardIndexToCoordinates(int squareIndex);
 unsigned long long perft(Game& game, int depth);
+// legal[i] is whether actions[i] is legal in games[i]. A game can appear any number of times.
+void validateActions(Game* const games[], const PlayerAction actions[], size_t count, bool legal[]);
 
 } // namespace nichess
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+#include "nichess/evaluation.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace nichess {
+
+// Health points are multiples of 10, same buckets as in Zobrist::pieceTypeToSquareToHPToKey.
+const int NNUE_NUM_HP_BUCKETS = 7;
+// Features are (piece type, square, hp bucket), piece type seen from the perspective's player.
+const int NNUE_NUM_FEATURES = (NUM_PIECE_TYPE - 1) * NUM_SQUARES * NNUE_NUM_HP_BUCKETS;
+const int NNUE_HIDDEN_SIZE = 256;
+// Accumulator values are clipped to [0, NNUE_CLIP] before the output layer.
+const int NNUE_CLIP = 127;
+const int NNUE_OUTPUT_SHIFT = 8;
+const uint32_t NNUE_MAGIC = 0x4555'4E4E; // "NNUE"
+const uint32_t NNUE_VERSION = 1;
+
+enum class NNUEKernel: int {
+  SCALAR, AVX2, AVX512
+};
+
+/*
+ * Weights of the network, memory-mapped from a binary file:
+ *   header (64 bytes): magic, version, number of features, hidden size, output bias
+ *   int16 featureBias[NNUE_HIDDEN_SIZE]
+ *   int16 featureWeights[NNUE_NUM_FEATURES][NNUE_HIDDEN_SIZE]
+ *   int16 outputWeights[2 * NNUE_HIDDEN_SIZE]   (side to move half first)
+ */
+class NNUENetwork {
+  public:
+    const int16_t* featureBias = nullptr;
+    const int16_t* featureWeights = nullptr;
+    const int16_t* outputWeights = nullptr;
+    int32_t outputBias = 0;
+
+    NNUENetwork();
+    NNUENetwork(const std::string& path);
+    NNUENetwork(const NNUENetwork& other) = delete;
+    NNUENetwork& operator=(const NNUENetwork& other) = delete;
+    ~NNUENetwork();
+    // Throws std::runtime_error if the file can't be mapped or has the wrong format.
+    void load(const std::string& path);
+    bool isLoaded() const;
+    // Writes a network file, used by training tools and tests.
+    static void write(const std::string& path, const std::vector<int16_t>& featureBias, const std::vector<int16_t>& featureWeights, const std::vector<int16_t>& outputWeights, int32_t outputBias);
+
+  private:
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    void unload();
+};
+
+int nnueFeatureIndex(PieceType pt, int squareIndex, int healthPoints, Player perspective);
+
+// Best kernel supported by the cpu is selected at startup.
+NNUEKernel getNNUEKernel();
+// Returns false if the cpu doesn't support kernel.
+bool setNNUEKernel(NNUEKernel kernel);
+bool isNNUEKernelSupported(NNUEKernel kernel);
+
+/*
+ * First layer of the network for both perspectives, updated from the per-square deltas of the
+ * game it observes.
+ */
+class NNUEAccumulator: public SquareObserver {
+  public:
+    alignas(64) int16_t values[NUM_PLAYERS][NNUE_HIDDEN_SIZE];
+
+    NNUEAccumulator(const NNUENetwork& weights);
+    void squareChanged(int squareIndex, const Piece& before, const Piece& after) override;
+    void refresh(const Game& game) override;
+    // Score from the perspective of sideToMove.
+    int output(Player sideToMove) const;
+
+  private:
+    const NNUENetwork& network;
+    void addFeature(PieceType pt, int squareIndex, int healthPoints);
+    void removeFeature(PieceType pt, int squareIndex, int healthPoints);
+};
+
+/*
+ * Drop-in evaluator for AlphaBetaSearch.
+ */
+class NNUEEvaluator: public Evaluator {
+  public:
+    NNUEEvaluator(const NNUENetwork& network);
+    int evaluate(Game& game) override;
+    void attach(Game& game) override;
+    void detach(Game& game) override;
+
+  private:
+    NNUEAccumulator accumulator;
+    Game* attachedGame = nullptr;
+};
+
+} // namespace nichess
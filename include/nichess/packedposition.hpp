@@ -0,0 +1,30 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace nichess {
+
+/*
+ * Binary encoding of a position, little endian:
+ *   8 bytes   occupied squares as a bitmask
+ *   2 bytes   side to move in the lowest bit, move number in the others
+ *   (n+1)/2   piece type of every occupied square in ascending order, 4 bits each, low nibble first
+ *   n bytes   health points of every occupied square in the same order
+ * where n is the number of occupied squares, 58 bytes for the starting position. Repetitions
+ * aren't stored.
+ */
+const size_t MAX_PACKED_POSITION_SIZE = 8 + 2 + NUM_SQUARES / 2 + NUM_SQUARES;
+
+// Writes the position to out, which needs room for MAX_PACKED_POSITION_SIZE bytes. Returns the number of bytes written.
+size_t packPosition(const Game& game, uint8_t* out);
+// Replaces game's position with the one at in, which has size bytes. Returns the number of bytes read.
+size_t unpackPosition(const uint8_t* in, size_t size, Game& game);
+// Only decodes, into the piece on every square. Setting up a Game costs much more.
+size_t unpackSquares(const uint8_t* in, size_t size, Piece squares[], Player& player, int& moveNumber);
+// Size of the packed position at in, 0 if size bytes are too few to tell.
+size_t packedPositionSize(const uint8_t* in, size_t size);
+
+} // namespace nichess
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace nichess {
+
+/*
+ * Dense policy vectors have one entry per source and destination square. There is at most one
+ * legal action from a square to another, so the action type isn't needed.
+ */
+const int POLICY_SIZE = NUM_SQUARES * NUM_SQUARES;
+// Quantized visit fractions are in units of 1 / POLICY_WEIGHT_SCALE.
+const uint32_t POLICY_WEIGHT_SCALE = 65535;
+const size_t MAX_SPARSE_POLICY_LENGTH = 65535;
+
+int policyIndex(const PlayerAction& action);
+// The legal action of game with the given policy index, if there is one.
+std::optional<PlayerAction> policyAction(Game& game, int index);
+
+/*
+ * Sparse encoding of a visit distribution, little endian:
+ *   2 bytes      number of entries n
+ *   4n bytes     policy index and visit fraction of every entry, 2 bytes each, the fraction
+ *                quantized to POLICY_WEIGHT_SCALE
+ * Actions whose fraction rounds to 0 are left out, the weights sum to about POLICY_WEIGHT_SCALE.
+ */
+
+// Room needed for a policy over count actions.
+size_t maxSparsePolicySize(size_t count);
+
+// Writes the distribution of visits over actions to out, which needs room for
+// maxSparsePolicySize(count) bytes. count can't exceed MAX_SPARSE_POLICY_LENGTH. Returns the
+// number of bytes written.
+size_t encodeSparsePolicy(const PlayerAction actions[], const uint32_t visits[], size_t count, uint8_t* out);
+// Size of the sparse policy at in, 0 if size bytes are too few.
+size_t sparsePolicySize(const uint8_t* in, size_t size);
+// Number of entries of the sparse policy at in.
+size_t sparsePolicyLength(const uint8_t* in);
+// Copies the entries of the sparse policy at in, weights normalized to sum to 1. Returns the
+// number of entries.
+size_t decodeSparsePolicy(const uint8_t* in, uint16_t indices[], float fractions[]);
+// Expands count sparse policies into dense, count rows of POLICY_SIZE floats that sum to 1 or
+// are all 0 for an empty policy.
+void expandSparsePolicies(const uint8_t* const policies[], size_t count, float dense[]);
+
+} // namespace nichess
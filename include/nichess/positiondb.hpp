@@ -0,0 +1,119 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace nichess {
+
+const uint32_t POSITION_DB_MAGIC = 0x3144'504E; // "NPD1"
+const uint32_t POSITION_DB_VERSION = 1;
+const int POSITION_DB_HEADER_SIZE = 64;
+
+/*
+ * 128 bit position key. key1 is the canonicalKey, so mirror images are one position. key2 is an
+ * independent hash of the same orientation, never 0 so that it marks empty slots.
+ */
+class PositionKey {
+  public:
+    uint64_t key1;
+    uint64_t key2;
+
+    bool operator==(const PositionKey& other) const;
+};
+
+PositionKey positionKey(const Game& game);
+// Same for the position with squares[i] on square i.
+PositionKey positionKey(const Piece squares[], Player player);
+
+/*
+ * Outcome counts of one position for the player to move.
+ */
+class PositionEntry {
+  public:
+    PositionKey key;
+    uint32_t wins;
+    uint32_t draws;
+    uint32_t losses;
+    uint32_t reserved;
+
+    uint64_t games() const;
+};
+
+static_assert(sizeof(PositionEntry) == 32, "PositionEntry is stored as is in the database file");
+
+/*
+ * Outcome statistics of positions in a memory-mapped open addressing hash table with linear
+ * probing. The capacity is a power of two and the home slot of a key is given by the top bits of
+ * key2, so that keys sorted by key2 are sorted by home slot whatever the capacity. The table
+ * doubles when it gets fuller than maxLoad, which rewrites the file.
+ *
+ * Bulk inserts sort their entries first, so that the mapping is written front to back instead of
+ * at random. Tables larger than memory stay usable that way.
+ *
+ * File format:
+ *   header (64 bytes): magic, version, capacity, number of entries, reserved
+ *   PositionEntry per slot, empty slots are all zero
+ */
+class PositionDatabase {
+  public:
+    double maxLoad = 0.75;
+
+    PositionDatabase();
+    PositionDatabase(const PositionDatabase& other) = delete;
+    PositionDatabase& operator=(const PositionDatabase& other) = delete;
+    ~PositionDatabase();
+    // Creates an empty database with room for at least capacity entries, replacing any file at
+    // filePath. Throws std::runtime_error if the file can't be created.
+    void create(const std::string& filePath, uint64_t capacity);
+    // Opens an existing database for reading and writing. Throws std::runtime_error if the file
+    // can't be mapped or has the wrong format.
+    void open(const std::string& filePath);
+    // Writes the mapping back to the file and unmaps it.
+    void close();
+    // Writes changes to the file.
+    void flush();
+
+    // Nullptr if the position isn't in the database. Valid until the table grows or is closed.
+    const PositionEntry* find(const PositionKey& key) const;
+    // Adds outcome, 1 win, 0 draw or -1 loss, to the position's counts.
+    void add(const PositionKey& key, int outcome);
+    // Adds the counts of every entry to the counts of its position.
+    void insertBatch(std::vector<PositionEntry>& entries);
+    // Adds all entries of other.
+    void merge(const PositionDatabase& other);
+    // Adds every sample of the self-play shards. numThreads threads read shards and then insert
+    // into disjoint ranges of slots. Throws std::runtime_error if a shard can't be read.
+    void build(const std::vector<std::string>& shards, int numThreads);
+
+    uint64_t size() const;
+    uint64_t capacity() const;
+
+  private:
+    std::string path;
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    PositionEntry* slots = nullptr;
+    uint64_t mask = 0;
+    int shift = 64;
+    uint64_t numEntries = 0;
+
+    void map(const std::string& filePath, bool create, uint64_t capacity);
+    void writeHeader();
+    uint64_t home(const PositionKey& key) const;
+    // Grows the table until count more entries fit below maxLoad.
+    void reserve(uint64_t count);
+    // Adds entry's counts in slots [first, last) starting at its home slot. Returns false if
+    // probing would leave the range, counts new entries in added.
+    bool insert(const PositionEntry& entry, uint64_t first, uint64_t last, uint64_t& added);
+    // Inserts sorted entries whose home slots are in [first, last). Entries that don't fit go to
+    // overflow. Returns the number of new entries.
+    uint64_t insertRange(const PositionEntry* begin, const PositionEntry* end, uint64_t first, uint64_t last, std::vector<PositionEntry>& overflow);
+    // Sorts entries by key2 and key1 and merges the counts of equal keys.
+    static void sortByHome(std::vector<PositionEntry>& entries);
+};
+
+} // namespace nichess
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+#include "nichess/evaluation.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace nichess {
+
+const int MAX_SEARCH_DEPTH = 64;
+const int MATE_SCORE = 1000000;
+// Scores above this are "king kill in N plies" scores.
+const int MATE_BOUND = MATE_SCORE - 1000;
+const int INFINITE_SCORE = MATE_SCORE + 1;
+// Tablebase wins score below king kills found by the search.
+const int TABLEBASE_WIN_SCORE = MATE_BOUND - 1000;
+
+class Tablebase;
+class OpeningBook;
+class KingKillSolver;
+
+/*
+ * Limits for a single search. A value of 0 means "no limit". All times are in milliseconds,
+ * measured from the start of the search.
+ */
+class SearchLimits {
+  public:
+    int depth = MAX_SEARCH_DEPTH;
+    uint64_t nodes = 0;
+    // Exact time to spend on the move. Acts as a hard deadline.
+    int moveTime = 0;
+    // No new iteration is started after the soft deadline.
+    int softDeadline = 0;
+    // Search is aborted as soon as the hard deadline is reached.
+    int hardDeadline = 0;
+    // Number of nodes between two checks of the stop flag and the clock.
+    int checkInterval = 128;
+};
+
+/*
+ * Sent to the info callback after every completed iteration.
+ */
+class SearchInfo {
+  public:
+    int depth;
+    int score;
+    uint64_t nodes;
+    uint64_t nps;
+    int64_t elapsed; // milliseconds
+    std::vector<PlayerAction> pv;
+};
+
+class SearchResult {
+  public:
+    PlayerAction bestAction;
+    int score = 0;
+    // Depth of the last completed iteration.
+    int depth = 0;
+    uint64_t nodes = 0;
+    int64_t elapsed = 0; // microseconds
+    std::vector<PlayerAction> pv;
+    // True if the search was cut short by the stop flag, a deadline or the node budget.
+    bool stopped = false;
+    // True if the action was taken from the opening book without searching.
+    bool fromBook = false;
+};
+
+/*
+ * Iterative deepening alpha-beta search.
+ * stop() may be called from any thread, the search returns the best action of the
+ * last completed iteration shortly after. A stop while no search is running has no
+ * effect.
+ */
+class AlphaBetaSearch {
+  public:
+    std::function<void(const SearchInfo&)> infoCallback;
+    // Probed at every node below the root, not owned.
+    const Tablebase* tablebase = nullptr;
+    // Positions found in the book are answered with the book's best action, not owned.
+    const OpeningBook* book = nullptr;
+    // Tried at the root only, before the search, within the search's limits. A forced king kill
+    // is played right away. Not owned.
+    KingKillSolver* solver = nullptr;
+
+    AlphaBetaSearch();
+    AlphaBetaSearch(Evaluator* leafEvaluator);
+    SearchResult search(Game& game, const SearchLimits& limits);
+    void stop();
+    bool isStopped() const;
+
+  private:
+    StaticEvaluator defaultEvaluator;
+    Evaluator* evaluator;
+    std::atomic<bool> stopFlag;
+    std::chrono::steady_clock::time_point startTime;
+    std::chrono::steady_clock::time_point hardDeadline;
+    bool hasHardDeadline;
+    uint64_t nodeBudget;
+    uint64_t nodes;
+    int checkCountdown;
+    int checkInterval;
+    bool aborted;
+    std::vector<std::vector<PlayerAction>> pvTable;
+    std::vector<int> pvLength;
+    std::vector<PlayerAction> previousPv;
+
+    int negamax(Game& game, int depth, int ply, int alpha, int beta);
+    bool shouldAbort();
+    void orderActions(Game& game, std::vector<PlayerAction>& actions, int ply);
+};
+
+} // namespace nichess
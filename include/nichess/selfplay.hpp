@@ -0,0 +1,193 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+#include "nichess/mcts.hpp"
+#include "nichess/search.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace nichess {
+
+class OpeningBook;
+
+const uint32_t SELF_PLAY_SHARD_MAGIC = 0x3153'504E; // "NPS1"
+const uint32_t SELF_PLAY_SHARD_VERSION = 2;
+const int SELF_PLAY_SHARD_HEADER_SIZE = 32;
+
+enum class SelfPlayEngine {
+  RANDOM, ALPHA_BETA, MCTS
+};
+
+class SelfPlayConfig {
+  public:
+    int numThreads = 1;
+    SelfPlayEngine engine = SelfPlayEngine::MCTS;
+    // Games to start over all threads, dropped ones included, 0 to play until stop is called.
+    uint64_t numGames = 0;
+    // Searches without any limit never end.
+    SearchLimits searchLimits;
+    MCTSLimits mctsLimits;
+    // Arena of every thread's MCTS.
+    uint32_t mctsNodeCapacity = 1 << 16;
+    uint32_t mctsEdgeCapacity = 1 << 20;
+    // Called once per thread for the MCTS leaf evaluator. Defaults to StaticLeafEvaluator.
+    std::function<std::unique_ptr<LeafEvaluator>(int thread)> evaluatorFactory;
+    // The first randomPlies actions of every game are sampled from the book, or uniformly when
+    // the book has no entry, and aren't recorded.
+    int randomPlies = 4;
+    const OpeningBook* book = nullptr;
+    // MCTS picks actions in proportion to the root visits before this ply and the most visited
+    // one after.
+    int samplingPlies = 16;
+    // Longer games are recorded as draws.
+    int maxPlies = 300;
+    uint64_t seed = 0;
+    // Shards are written to shardPrefix-00000.shard, shardPrefix-00001.shard and so on. A shard is
+    // closed before it grows past shardSize bytes unless a single block is larger.
+    std::string shardPrefix = "selfplay";
+    uint64_t shardSize = 256 << 20;
+    // Every thread fills one block while the other is being written.
+    size_t blockSize = 1 << 20;
+
+    // Limits the searches to 200 MCTS visits and depth 4 alpha-beta.
+    SelfPlayConfig();
+};
+
+class SelfPlayStats {
+  public:
+    uint64_t games = 0;
+    // Games left without a legal action before they ended, e.g. by a search that ran out of
+    // time. They aren't written.
+    uint64_t droppedGames = 0;
+    uint64_t positions = 0;
+    uint64_t bytesWritten = 0;
+    uint64_t shards = 0;
+    double seconds = 0;
+    double gamesPerHour = 0;
+    double positionsPerSecond = 0;
+};
+
+/*
+ * Plays games between copies of one engine on numThreads threads and writes every position with
+ * its policy target and the outcome to shard files.
+ *
+ * Threads write finished games to their own block. Once a block holds blockSize bytes it goes to
+ * the writer thread and the thread goes on with its second block, so that threads only wait when
+ * the disk falls behind.
+ *
+ * Shard format:
+ *   header (32 bytes): magic, version, number of samples, number of games, reserved
+ *   per sample: position as written by packPosition, outcome for the player to move as an int8
+ *     (1 win, 0 draw, -1 loss), policy as written by encodeSparsePolicy
+ * The policy is the distribution of root visits for MCTS and the chosen action for the others.
+ */
+class SelfPlay {
+  public:
+    SelfPlay(const SelfPlayConfig& selfPlayConfig);
+    SelfPlay(const SelfPlay& other) = delete;
+    SelfPlay& operator=(const SelfPlay& other) = delete;
+    ~SelfPlay();
+    // Blocks until numGames are played or stop is called. Rethrows the first exception of any
+    // thread, std::runtime_error if a shard can't be written.
+    SelfPlayStats run();
+    // May be called from any thread, unfinished games are dropped.
+    void stop();
+    // May be called from any thread while run is going.
+    SelfPlayStats stats() const;
+    // Paths of the shards written so far.
+    std::vector<std::string> shards() const;
+
+  private:
+    class Block {
+      public:
+        std::vector<uint8_t> data;
+        uint64_t samples = 0;
+        uint64_t games = 0;
+        bool writing = false;
+    };
+
+    SelfPlayConfig config;
+    std::atomic<bool> stopFlag;
+    std::atomic<uint64_t> gamesStarted;
+    std::atomic<uint64_t> games;
+    std::atomic<uint64_t> droppedGames;
+    std::atomic<uint64_t> positions;
+    std::atomic<uint64_t> bytesWritten;
+    std::chrono::steady_clock::time_point startTime;
+    std::chrono::steady_clock::time_point endTime;
+    bool running = false;
+
+    mutable std::mutex mutex;
+    std::condition_variable blockQueued;
+    std::condition_variable blockWritten;
+    std::deque<Block*> queue;
+    bool workersDone = false;
+    std::exception_ptr error;
+    std::vector<std::string> shardPaths;
+
+    // State of the writer thread.
+    std::ofstream shard;
+    uint64_t shardBytes = 0;
+    uint64_t shardSamples = 0;
+    uint64_t shardGames = 0;
+
+    void playGames(int thread);
+    void writeBlocks();
+    void submit(Block* block);
+    void waitWritten(Block* block);
+    void openShard();
+    void closeShard();
+    void fail(std::exception_ptr e);
+};
+
+/*
+ * One sample of a shard. position and policy point into the reader's mapping, policy can be
+ * handed to decodeSparsePolicy and expandSparsePolicies.
+ */
+class SelfPlaySample {
+  public:
+    const uint8_t* position;
+    int outcome;
+    const uint8_t* policy;
+};
+
+/*
+ * Memory-mapped shard, read from front to back.
+ */
+class SelfPlayShardReader {
+  public:
+    SelfPlayShardReader();
+    SelfPlayShardReader(const SelfPlayShardReader& other) = delete;
+    SelfPlayShardReader& operator=(const SelfPlayShardReader& other) = delete;
+    ~SelfPlayShardReader();
+    // Throws std::runtime_error if the file can't be mapped or has the wrong format.
+    void load(const std::string& path);
+    uint64_t numSamples() const;
+    uint64_t numGames() const;
+    // Reads the next sample, false after the last one. Throws std::runtime_error if the sample
+    // is corrupt.
+    bool next(SelfPlaySample& sample);
+    void rewind();
+
+  private:
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    const uint8_t* cursor = nullptr;
+    uint64_t samples = 0;
+    uint64_t games = 0;
+
+    void unload();
+};
+
+} // namespace nichess
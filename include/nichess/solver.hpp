@@ -0,0 +1,120 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace nichess {
+
+enum class SolverResult: uint8_t {
+  // The player to move kills the enemy king within the ply limit whatever the opponent does.
+  WIN,
+  // There is no forced king kill within the ply limit.
+  NO_WIN,
+  // The node budget, the deadline or the stop flag ran out.
+  UNKNOWN
+};
+
+/*
+ * Proven and disproven positions, kept between solves and shared by every solver given the same
+ * table. Proofs depend on the remaining plies: a position won with d plies left is won with more,
+ * and one that isn't won with d plies left isn't won with fewer.
+ */
+class SolverTable {
+  public:
+    // sizeMb is rounded down to a power of two number of entries.
+    SolverTable(size_t sizeMb = 16);
+    // Returns WIN, NO_WIN or UNKNOWN if the table can't tell at this number of remaining plies.
+    SolverResult probe(uint64_t key, int plies) const;
+    void storeWin(uint64_t key, int plies);
+    void storeNoWin(uint64_t key, int plies);
+    void clear();
+
+  private:
+    class SolverTableEntry {
+      public:
+        uint64_t key;
+        // Fewest remaining plies the position was proven with, -1 if never.
+        int8_t winPlies;
+        // Most remaining plies the position was disproven with, -1 if never.
+        int8_t noWinPlies;
+    };
+
+    std::vector<SolverTableEntry> entries;
+    size_t mask;
+
+    SolverTableEntry& entry(uint64_t key);
+};
+
+class SolverOutcome {
+  public:
+    SolverResult result = SolverResult::UNKNOWN;
+    // First action of the king kill if result is WIN.
+    PlayerAction bestAction;
+    // Length of the shortest king kill found, in plies.
+    int plies = 0;
+    uint64_t nodes = 0;
+};
+
+/*
+ * Limits of a single solve on top of the solver's own. Checked between node expansions.
+ */
+class SolverLimits {
+  public:
+    // 0 means no limit beyond KingKillSolver::nodeBudget.
+    uint64_t nodes = 0;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    // Set from another thread to give up, not owned.
+    const std::atomic<bool>* stopFlag = nullptr;
+};
+
+/*
+ * Proof-number search for a forced king kill by the player to move. OR nodes are the attacker's
+ * turns and AND nodes the defender's. The search only looks at king health, repetitions and the
+ * move counter are ignored so that table entries don't depend on the path to a position.
+ * Running out of actions counts as no win, like in AlphaBetaSearch.
+ * Iterates over the odd ply limits up to maxPlies, so that the first kill found is the shortest one.
+ */
+class KingKillSolver {
+  public:
+    int maxPlies = 7;
+    // Nodes of the proof tree over all iterations.
+    uint64_t nodeBudget = 1 << 20;
+
+    // Uses its own table if table is nullptr, otherwise table isn't owned.
+    KingKillSolver(SolverTable* sharedTable = nullptr);
+    SolverOutcome solve(Game& game, const SolverLimits& limits = SolverLimits());
+
+  private:
+    class PNNode {
+      public:
+        uint32_t proof;
+        uint32_t disproof;
+        uint32_t parent;
+        uint32_t firstChild;
+        uint16_t numChildren;
+        uint8_t plies; // remaining
+        bool expanded;
+        PackedAction action;
+    };
+
+    std::unique_ptr<SolverTable> ownTable;
+    SolverTable* table;
+    Player attacker;
+    std::vector<PNNode> tree;
+    std::vector<UndoInfo> undoStack;
+    SolverLimits limits;
+    int checkCountdown;
+
+    // Solves the root with a limit of plies in a tree of at most budget nodes.
+    SolverResult prove(Game& game, int plies, uint64_t budget);
+    void expand(uint32_t nodeIdx, Game& game, bool orNode);
+    void update(uint32_t nodeIdx, Game& game, bool orNode);
+    bool shouldAbort();
+};
+
+} // namespace nichess
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+
+#include <cstdint>
+
+namespace nichess {
+
+/*
+ * Left-right mirror image of positions and actions, square (x, y) goes to (7 - x, y).
+ *
+ * Every rule but castling looks the same in the mirror. Castling starts from the king's square
+ * 4 or 60 towards a warrior in a corner of the first row, and the mirror image of a castle, from
+ * square 3 or 59, isn't an action. The starting position isn't its own mirror image either, king
+ * and mage swap columns. So a position and its mirror image only have the same actions while
+ * neither of them can castle, and only share their game tree once neither player can ever castle
+ * again, which takes a player without warriors and pawns, the only pieces that turn into
+ * warriors.
+ */
+
+int mirrorSquare(int squareIndex);
+// Throws std::runtime_error for castles, which have no mirror image.
+PlayerAction mirrorAction(const PlayerAction& action);
+// Mirror image of a policyIndex, castles included.
+int mirrorPolicyIndex(int index);
+void mirrorSquares(const Piece squares[], Piece mirrored[]);
+// Replaces game's position with its mirror image through Game::setPosition, so repetitions
+// start over.
+void mirrorGame(Game& game);
+
+// No castle is legal in the position or in its mirror image, so mirrorAction maps the legal
+// actions of one onto the other's. Training samples can be mirrored.
+bool mirrorPreservesActions(const Game& game);
+// Neither player can castle any more, the position and its mirror image are equivalent.
+bool mirrorIsExact(const Game& game);
+
+// Game::zobristHash of game's mirror image.
+uint64_t mirroredZobristHash(const Game& game);
+
+class CanonicalKey {
+  public:
+    uint64_t key;
+    // True if key is the mirror image's hash, actions stored under key are mirrored.
+    bool mirrored;
+};
+
+// The smaller of Game::zobristHash and mirroredZobristHash where mirrorIsExact, otherwise
+// Game::zobristHash. Mirror images get the same key.
+CanonicalKey canonicalKey(const Game& game);
+// Same for the position with squares[i] on square i.
+CanonicalKey canonicalKey(const Piece squares[], Player player);
+
+// Writes the mirror image of the sparse policy at in to out, which needs as many bytes.
+void mirrorSparsePolicy(const uint8_t* in, uint8_t* out);
+
+} // namespace nichess
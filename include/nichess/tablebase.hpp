@@ -0,0 +1,122 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace nichess {
+
+// From the perspective of the player to move.
+enum class TablebaseResult: uint8_t {
+  DRAW = 0, WIN = 1, LOSS = 2, INVALID = 3
+};
+
+const uint32_t TABLEBASE_MAGIC = 0x3142'544E; // "NTB1"
+const uint32_t TABLEBASE_VERSION = 1;
+const int TABLEBASE_HEADER_SIZE = 64;
+const int TABLEBASE_MAX_PIECES = 8;
+
+/*
+ * Indexing of the positions of one ending. The material is a sorted list of piece types with
+ * one king per player. A position is the player to move and the square and health points of
+ * every piece, health points in steps of 10 up to the piece's starting health points:
+ *   index = ((player * 64 + square_0) * levels_0 + hp_0 / 10 - 1) * 64 + square_1 ...
+ * Pieces of the same type can be in any order, all orders have the same value.
+ */
+class TablebaseLayout {
+  public:
+    std::vector<PieceType> pieces;
+    std::vector<int> hpLevels;
+    uint64_t size;
+
+    TablebaseLayout(const std::vector<PieceType>& material);
+    uint64_t index(Player player, const int squares[], const int healthPoints[]) const;
+    void decode(uint64_t index, Player& player, int squares[], int healthPoints[]) const;
+};
+
+// Throws std::runtime_error if the material isn't a valid ending.
+std::vector<PieceType> tablebaseMaterial(std::vector<PieceType> pieces);
+// Same for every order of the pieces.
+uint64_t tablebaseMaterialKey(const std::vector<PieceType>& material);
+// Uppercase for player 1, lowercase for player 2, for example "KMk".
+std::string tablebaseName(const std::vector<PieceType>& material);
+
+class TablebaseStats {
+  public:
+    std::string name;
+    uint64_t positions = 0;
+    uint64_t wins = 0;
+    uint64_t losses = 0;
+    uint64_t draws = 0;
+    uint64_t invalid = 0;
+    double seconds = 0;
+};
+
+/*
+ * Retrograde analysis. One forward pass over all positions records every position's successors
+ * in the same ending and resolves actions that kill the king or change the material through the
+ * smaller tables. Wins and losses are then propagated backwards through the predecessors until
+ * nothing changes, the remaining positions are draws. Both passes are split over numThreads
+ * threads.
+ * The move counter and repetitions are ignored, a draw means neither side can force a king kill.
+ *
+ * File format, one file <name>.ntb per ending:
+ *   header (64 bytes): magic, version, number of pieces, reserved, number of positions, piece types
+ *   2 bit TablebaseResult per position, 4 positions per byte starting at the low bits
+ */
+class TablebaseGenerator {
+  public:
+    TablebaseGenerator(const std::string& outputDirectory, int threads = 0);
+    // Generates material and every ending it can turn into by losing pieces or promoting pawns.
+    std::vector<TablebaseStats> generate(const std::vector<PieceType>& material);
+
+  private:
+    class GeneratedTable {
+      public:
+        TablebaseLayout layout;
+        std::vector<uint8_t> values;
+    };
+
+    std::string directory;
+    int numThreads;
+    std::unordered_map<uint64_t, GeneratedTable> tables;
+
+    TablebaseStats generateTable(const std::vector<PieceType>& material);
+};
+
+/*
+ * Memory-mapped tables, probing costs one index computation and one byte read.
+ */
+class Tablebase {
+  public:
+    Tablebase();
+    Tablebase(const Tablebase& other) = delete;
+    Tablebase& operator=(const Tablebase& other) = delete;
+    ~Tablebase();
+    // Throws std::runtime_error if the file can't be mapped or has the wrong format.
+    void load(const std::string& path);
+    // Loads every .ntb file in directory and returns the number of tables loaded.
+    int loadDirectory(const std::string& directory);
+    // Empty if there is no table for the game's material.
+    std::optional<TablebaseResult> probe(Game& game) const;
+    size_t numTables() const;
+    int maxPieces() const;
+
+  private:
+    class MappedTable {
+      public:
+        TablebaseLayout layout;
+        void* mapping;
+        size_t mappingSize;
+        const uint8_t* data;
+    };
+
+    std::unordered_map<uint64_t, MappedTable> tables;
+    int largestTable = 0;
+};
+
+} // namespace nichess
@@ -0,0 +1,132 @@
+#include "nichess/actioncache.hpp"
+#include "nichess/gamecache.hpp"
+
+using namespace nichess;
+
+static uint64_t squareSet(const std::vector<int>& squares) {
+  uint64_t set = 0;
+  for(int s: squares) {
+    set |= 1ULL << s;
+  }
+  return set;
+}
+
+/*
+ * Squares along the line up to the first piece. With throws the piece right next to the thrower
+ * may be thrown, then the line goes on up to the next piece.
+ */
+static uint64_t rayDependencies(Piece* const board[], int squareIndex, int direction, bool throws) {
+  const std::vector<int>& line = GameCache::squareToDirectionToLine[squareIndex][direction];
+  uint64_t set = 0;
+  for(size_t i = 0; i < line.size(); i++) {
+    set |= 1ULL << line[i];
+    if(board[line[i]]->type == PieceType::NO_PIECE) continue;
+    if(i > 0 || !throws) break;
+    for(size_t j = i + 1; j < line.size(); j++) {
+      set |= 1ULL << line[j];
+      if(board[line[j]]->type != PieceType::NO_PIECE) break;
+    }
+    break;
+  }
+  return set;
+}
+
+ActionCache::ActionCache(Game& observed): game(observed) {
+  valid = 0;
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    dependencies[i] = 0;
+  }
+  game.addSquareObserver(this);
+}
+
+ActionCache::~ActionCache() {
+  game.removeSquareObserver(this);
+}
+
+uint64_t ActionCache::computeDependencies(int squareIndex) const {
+  uint64_t set = 1ULL << squareIndex;
+  Piece* const* board = game.board;
+  switch(board[squareIndex]->type) {
+    case P1_KING:
+    case P2_KING:
+      set |= squareSet(GameCache::squareToNeighboringSquares[squareIndex]);
+      // castling looks at the whole first or last row
+      if(squareIndex == 4 || squareIndex == 60) {
+        set |= 0xFFULL << (squareIndex - 4);
+      }
+      break;
+    case P1_KNIGHT:
+    case P2_KNIGHT:
+      set |= squareSet(GameCache::squareToKnightActionSquares[squareIndex]);
+      break;
+    case P1_PAWN:
+      set |= squareSet(GameCache::squareToP1PawnMoveSquares[squareIndex]);
+      set |= squareSet(GameCache::squareToP1PawnAbilitySquares[squareIndex]);
+      break;
+    case P2_PAWN:
+      set |= squareSet(GameCache::squareToP2PawnMoveSquares[squareIndex]);
+      set |= squareSet(GameCache::squareToP2PawnAbilitySquares[squareIndex]);
+      break;
+    case P1_MAGE:
+    case P2_MAGE:
+      for(int d = 0; d < NUM_DIRECTIONS_WITHOUT_INVALID; d++) {
+        set |= rayDependencies(board, squareIndex, d, d % 2 == 1);
+      }
+      break;
+    case P1_WARRIOR:
+    case P2_WARRIOR:
+      for(Direction d: NON_DIAGONAL_DIRECTIONS) {
+        set |= rayDependencies(board, squareIndex, d, true);
+      }
+      break;
+    case P1_ASSASSIN:
+    case P2_ASSASSIN:
+      set |= squareSet(GameCache::squareToNeighboringNonDiagonalSquares[squareIndex]);
+      for(Direction d: DIAGONAL_DIRECTIONS) {
+        set |= rayDependencies(board, squareIndex, d, false);
+      }
+      break;
+    default:
+      break;
+  }
+  return set;
+}
+
+void ActionCache::squareChanged(int squareIndex, const Piece& before, const Piece& after) {
+  valid &= ~(1ULL << squareIndex);
+  // Other pieces only look at which player a square belongs to.
+  if(before.type == after.type) return;
+  uint64_t bit = 1ULL << squareIndex;
+  for(uint64_t s = valid; s; s &= s - 1) {
+    int i = __builtin_ctzll(s);
+    if(dependencies[i] & bit) {
+      valid &= ~(1ULL << i);
+    }
+  }
+}
+
+void ActionCache::refresh(const Game&) {
+  valid = 0;
+}
+
+const std::vector<PlayerAction>& ActionCache::actionsAt(int squareIndex) {
+  uint64_t bit = 1ULL << squareIndex;
+  if(valid & bit) {
+    hits++;
+    return actions[squareIndex];
+  }
+  misses++;
+  Piece* piece = game.board[squareIndex];
+  if(piece->type == PieceType::NO_PIECE || piece->healthPoints <= 0) {
+    actions[squareIndex].clear();
+  } else {
+    actions[squareIndex] = game.legalActionsByPiece(piece);
+  }
+  dependencies[squareIndex] = computeDependencies(squareIndex);
+  valid |= bit;
+  return actions[squareIndex];
+}
+
+uint64_t ActionCache::cachedSquares() const {
+  return valid;
+}
@@ -0,0 +1,252 @@
+#include "nichess/attackmap.hpp"
+#include "nichess/gamecache.hpp"
+#include "nichess/util.hpp"
+
+using namespace nichess;
+
+static bool isDiagonal(int direction) {
+  return direction % 2 == 1;
+}
+
+/*
+ * Squares of every ray as a bitset. The square closest to the origin is the lowest set bit for
+ * rays going to higher indexes and the highest set bit for the others.
+ */
+class RayTable {
+  public:
+    uint64_t rays[NUM_SQUARES][NUM_DIRECTIONS_WITHOUT_INVALID];
+    bool ascending[NUM_DIRECTIONS_WITHOUT_INVALID];
+
+    RayTable() {
+      for(int d = 0; d < NUM_DIRECTIONS_WITHOUT_INVALID; d++) {
+        ascending[d] = d == NORTH || d == NORTHEAST || d == EAST || d == NORTHWEST;
+        for(int s = 0; s < NUM_SQUARES; s++) {
+          rays[s][d] = 0;
+          for(int t: GameCache::squareToDirectionToLine[s][d]) {
+            rays[s][d] |= 1ULL << t;
+          }
+        }
+      }
+    }
+
+    // Closest square of blockers, which is a non empty subset of the ray.
+    int closest(uint64_t blockers, int direction) const {
+      return ascending[direction] ? __builtin_ctzll(blockers) : 63 - __builtin_clzll(blockers);
+    }
+};
+
+// Built on first use, GameCache's tables are initialized in another translation unit.
+static const RayTable& rayTable() {
+  static const RayTable table;
+  return table;
+}
+
+AttackMap::AttackMap() {
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    types[i] = PieceType::NO_PIECE;
+    pieceAttacks[i] = 0;
+    attackersBySquare[PLAYER_1][i] = 0;
+    attackersBySquare[PLAYER_2][i] = 0;
+  }
+  occupied = 0;
+}
+
+uint64_t AttackMap::computeAttacks(int squareIndex) const {
+  uint64_t attacks = 0;
+  const std::vector<int>* squares = nullptr;
+  bool orthogonalRays = false;
+  bool diagonalRays = false;
+  switch(types[squareIndex]) {
+    case P1_KING:
+    case P2_KING:
+      squares = &GameCache::squareToNeighboringSquares[squareIndex];
+      break;
+    case P1_KNIGHT:
+    case P2_KNIGHT:
+      squares = &GameCache::squareToKnightActionSquares[squareIndex];
+      break;
+    case P1_PAWN:
+      squares = &GameCache::squareToP1PawnAbilitySquares[squareIndex];
+      break;
+    case P2_PAWN:
+      squares = &GameCache::squareToP2PawnAbilitySquares[squareIndex];
+      break;
+    case P1_MAGE:
+    case P2_MAGE:
+      orthogonalRays = true;
+      diagonalRays = true;
+      break;
+    case P1_WARRIOR:
+    case P2_WARRIOR:
+      orthogonalRays = true;
+      break;
+    case P1_ASSASSIN:
+    case P2_ASSASSIN:
+      squares = &GameCache::squareToNeighboringNonDiagonalSquares[squareIndex];
+      diagonalRays = true;
+      break;
+    default:
+      return 0;
+  }
+  if(squares != nullptr) {
+    for(int s: *squares) {
+      attacks |= 1ULL << s;
+    }
+  }
+  const RayTable& rays = rayTable();
+  for(int d = 0; d < NUM_DIRECTIONS_WITHOUT_INVALID; d++) {
+    if(isDiagonal(d) ? !diagonalRays : !orthogonalRays) continue;
+    uint64_t ray = rays.rays[squareIndex][d];
+    uint64_t blockers = ray & occupied;
+    if(blockers) {
+      ray &= ~rays.rays[rays.closest(blockers, d)][d];
+    }
+    attacks |= ray;
+  }
+  return attacks;
+}
+
+void AttackMap::removeAttacks(int squareIndex) {
+  if(types[squareIndex] == PieceType::NO_PIECE) return;
+  Player owner = pieceBelongsToPlayer(types[squareIndex], PLAYER_1) ? PLAYER_1 : PLAYER_2;
+  uint64_t attacks = pieceAttacks[squareIndex];
+  while(attacks) {
+    attackersBySquare[owner][__builtin_ctzll(attacks)] &= ~(1ULL << squareIndex);
+    attacks &= attacks - 1;
+  }
+  pieceAttacks[squareIndex] = 0;
+}
+
+void AttackMap::addAttacks(int squareIndex) {
+  if(types[squareIndex] == PieceType::NO_PIECE) return;
+  Player owner = pieceBelongsToPlayer(types[squareIndex], PLAYER_1) ? PLAYER_1 : PLAYER_2;
+  uint64_t attacks = computeAttacks(squareIndex);
+  pieceAttacks[squareIndex] = attacks;
+  while(attacks) {
+    attackersBySquare[owner][__builtin_ctzll(attacks)] |= 1ULL << squareIndex;
+    attacks &= attacks - 1;
+  }
+}
+
+uint64_t AttackMap::slidersThrough(int squareIndex) const {
+  const RayTable& rays = rayTable();
+  uint64_t sliders = 0;
+  for(int d = 0; d < NUM_DIRECTIONS_WITHOUT_INVALID; d++) {
+    uint64_t blockers = rays.rays[squareIndex][d] & occupied;
+    if(!blockers) continue;
+    int s = rays.closest(blockers, d);
+    PieceType type = types[s];
+    bool mage = type == P1_MAGE || type == P2_MAGE;
+    bool warrior = type == P1_WARRIOR || type == P2_WARRIOR;
+    bool assassin = type == P1_ASSASSIN || type == P2_ASSASSIN;
+    if(mage || (warrior && !isDiagonal(d)) || (assassin && isDiagonal(d))) {
+      sliders |= 1ULL << s;
+    }
+  }
+  return sliders;
+}
+
+void AttackMap::squareChanged(int squareIndex, const Piece& before, const Piece& after) {
+  if(before.type == after.type) return;
+  // Rays through the square only change if it becomes empty or occupied.
+  uint64_t sliders = 0;
+  if((before.type == PieceType::NO_PIECE) != (after.type == PieceType::NO_PIECE)) {
+    sliders = slidersThrough(squareIndex);
+  }
+  removeAttacks(squareIndex);
+  for(uint64_t s = sliders; s; s &= s - 1) {
+    removeAttacks(__builtin_ctzll(s));
+  }
+  types[squareIndex] = after.type;
+  if(after.type == PieceType::NO_PIECE) {
+    occupied &= ~(1ULL << squareIndex);
+  } else {
+    occupied |= 1ULL << squareIndex;
+  }
+  addAttacks(squareIndex);
+  for(uint64_t s = sliders; s; s &= s - 1) {
+    addAttacks(__builtin_ctzll(s));
+  }
+}
+
+void AttackMap::refresh(const Game& game) {
+  occupied = 0;
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    types[i] = game.syncedSquares[i].type;
+    if(types[i] != PieceType::NO_PIECE) {
+      occupied |= 1ULL << i;
+    }
+    pieceAttacks[i] = 0;
+    attackersBySquare[PLAYER_1][i] = 0;
+    attackersBySquare[PLAYER_2][i] = 0;
+  }
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    addAttacks(i);
+  }
+}
+
+uint64_t AttackMap::attackers(Player player, int squareIndex) const {
+  return attackersBySquare[player][squareIndex];
+}
+
+int AttackMap::attackCount(Player player, int squareIndex) const {
+  return __builtin_popcountll(attackersBySquare[player][squareIndex]);
+}
+
+bool AttackMap::isAttacked(Player player, int squareIndex) const {
+  return attackersBySquare[player][squareIndex] != 0;
+}
+
+uint64_t AttackMap::attacksFrom(int squareIndex) const {
+  return pieceAttacks[squareIndex];
+}
+
+uint64_t AttackMap::attackedSquares(Player player) const {
+  uint64_t squares = 0;
+  for(uint64_t s = occupied; s; s &= s - 1) {
+    int square = __builtin_ctzll(s);
+    if(pieceBelongsToPlayer(types[square], player)) {
+      squares |= pieceAttacks[square];
+    }
+  }
+  return squares;
+}
+
+uint64_t nichess::attackersOf(const Piece squares[], uint64_t occupied, int squareIndex) {
+  uint64_t attackers = 0;
+  auto add = [&](int s, PieceType type1, PieceType type2) {
+    if((occupied & (1ULL << s)) && (squares[s].type == type1 || squares[s].type == type2)) {
+      attackers |= 1ULL << s;
+    }
+  };
+  for(int s: GameCache::squareToNeighboringSquares[squareIndex]) {
+    add(s, P1_KING, P2_KING);
+  }
+  for(int s: GameCache::squareToKnightActionSquares[squareIndex]) {
+    add(s, P1_KNIGHT, P2_KNIGHT);
+  }
+  // A pawn hits the squares from which a pawn of the other player would hit it.
+  for(int s: GameCache::squareToP2PawnAbilitySquares[squareIndex]) {
+    add(s, P1_PAWN, P1_PAWN);
+  }
+  for(int s: GameCache::squareToP1PawnAbilitySquares[squareIndex]) {
+    add(s, P2_PAWN, P2_PAWN);
+  }
+  for(int s: GameCache::squareToNeighboringNonDiagonalSquares[squareIndex]) {
+    add(s, P1_ASSASSIN, P2_ASSASSIN);
+  }
+  const RayTable& rays = rayTable();
+  for(int d = 0; d < NUM_DIRECTIONS_WITHOUT_INVALID; d++) {
+    uint64_t blockers = rays.rays[squareIndex][d] & occupied;
+    if(!blockers) continue;
+    int s = rays.closest(blockers, d);
+    PieceType type = squares[s].type;
+    bool mage = type == P1_MAGE || type == P2_MAGE;
+    bool warrior = type == P1_WARRIOR || type == P2_WARRIOR;
+    bool assassin = type == P1_ASSASSIN || type == P2_ASSASSIN;
+    if(mage || (warrior && !isDiagonal(d)) || (assassin && isDiagonal(d))) {
+      attackers |= 1ULL << s;
+    }
+  }
+  return attackers;
+}
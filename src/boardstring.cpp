@@ -0,0 +1,102 @@
+#include "nichess/boardstring.hpp"
+
+#include <cstring>
+
+using namespace nichess;
+
+// Indexed by player 1's piece types, player 2's are the same.
+static const int NUM_PIECE_NAMES = PieceType::P2_KING;
+static const char* const PIECE_NAMES[NUM_PIECE_NAMES] = {"king", "mage", "warrior", "assassin", "knight", "pawn"};
+static const size_t PIECE_NAME_LENGTHS[NUM_PIECE_NAMES] = {4, 4, 7, 8, 6, 4};
+
+static char* writeText(char* first, char* last, const char* text, size_t length) {
+  if((size_t)(last - first) < length) return nullptr;
+  std::memcpy(first, text, length);
+  return first + length;
+}
+
+std::to_chars_result nichess::writeBoard(char* first, char* last, const Piece squares[], Player player) {
+  const std::to_chars_result tooLarge = {last, std::errc::value_too_large};
+  std::to_chars_result result = std::to_chars(first, last, (int)player);
+  if(result.ec != std::errc() || result.ptr == last) return tooLarge;
+  char* p = result.ptr;
+  *p++ = '|';
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    PieceType type = squares[i].type;
+    if(type == PieceType::NO_PIECE) {
+      p = writeText(p, last, "empty,", 6);
+      if(p == nullptr) return tooLarge;
+      continue;
+    }
+    int nameIndex = type < PieceType::P2_KING ? type : type - PieceType::P2_KING;
+    const char* name = PIECE_NAMES[nameIndex];
+    size_t nameLength = PIECE_NAME_LENGTHS[nameIndex];
+    if((size_t)(last - p) < nameLength + 3) return tooLarge;
+    *p++ = type < PieceType::P2_KING ? '0' : '1';
+    *p++ = '-';
+    std::memcpy(p, name, nameLength);
+    p += nameLength;
+    *p++ = '-';
+    result = std::to_chars(p, last, squares[i].healthPoints);
+    if(result.ec != std::errc() || result.ptr == last) return tooLarge;
+    p = result.ptr;
+    *p++ = ',';
+  }
+  return {p, std::errc()};
+}
+
+std::to_chars_result nichess::writeBoard(char* first, char* last, const Game& game) {
+  Piece squares[NUM_SQUARES];
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    squares[i].type = game.board[i]->type;
+    squares[i].healthPoints = game.board[i]->healthPoints;
+  }
+  return writeBoard(first, last, squares, game.currentPlayer);
+}
+
+// Matches text at p and moves past it.
+static bool consume(const char*& p, const char* last, const char* text, size_t length) {
+  if((size_t)(last - p) < length || std::memcmp(p, text, length) != 0) return false;
+  p += length;
+  return true;
+}
+
+// Piece type from the name starting at p for player, which is 0 or 1. NO_PIECE if there is none.
+static PieceType consumePieceName(const char*& p, const char* last, int player) {
+  int offset = player == 0 ? 0 : PieceType::P2_KING;
+  for(int type = 0; type < NUM_PIECE_NAMES; type++) {
+    if(consume(p, last, PIECE_NAMES[type], PIECE_NAME_LENGTHS[type])) {
+      return (PieceType)(type + offset);
+    }
+  }
+  return PieceType::NO_PIECE;
+}
+
+std::from_chars_result nichess::parseBoard(const char* first, const char* last, Piece squares[], Player& player) {
+  const std::from_chars_result invalid = {first, std::errc::invalid_argument};
+  int playerValue;
+  std::from_chars_result result = std::from_chars(first, last, playerValue);
+  if(result.ec != std::errc() || (playerValue != 0 && playerValue != 1)) return invalid;
+  const char* p = result.ptr;
+  if(!consume(p, last, "|", 1)) return invalid;
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    squares[i].squareIndex = i;
+    if(consume(p, last, "empty,", 6)) {
+      squares[i].type = PieceType::NO_PIECE;
+      squares[i].healthPoints = 0;
+      continue;
+    }
+    if(p == last || (*p != '0' && *p != '1')) return invalid;
+    int owner = *p++ - '0';
+    if(!consume(p, last, "-", 1)) return invalid;
+    PieceType type = consumePieceName(p, last, owner);
+    if(type == PieceType::NO_PIECE || !consume(p, last, "-", 1)) return invalid;
+    result = std::from_chars(p, last, squares[i].healthPoints);
+    if(result.ec != std::errc()) return invalid;
+    p = result.ptr;
+    if(!consume(p, last, ",", 1)) return invalid;
+    squares[i].type = type;
+  }
+  player = (Player)playerValue;
+  return {p, std::errc()};
+}
@@ -0,0 +1,215 @@
+#include "nichess/book.hpp"
+#include "nichess/symmetry.hpp"
+#include "nichess/util.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+using namespace nichess;
+
+class BookHeader {
+  public:
+    uint32_t magic;
+    uint32_t version;
+    uint64_t numEntries;
+    uint8_t reserved[16];
+};
+
+static_assert(sizeof(BookHeader) == BOOK_HEADER_SIZE, "BookHeader has to match BOOK_HEADER_SIZE");
+
+void OpeningBookBuilder::addGame(const std::vector<PlayerAction>& actions, std::optional<Player> winner) {
+  Game game = Game();
+  int plies = std::min((int)actions.size(), maxPly);
+  for(int i = 0; i < plies; i++) {
+    const PlayerAction& action = actions[i];
+    if(action.actionType == ActionType::SKIP) break;
+    // Mirror images share their entries, actions are stored as seen from the key's side.
+    CanonicalKey canonical = canonicalKey(game);
+    ActionStats& stats = positions[canonical.key][packAction(canonical.mirrored ? mirrorAction(action) : action)];
+    stats.games++;
+    if(winner) {
+      stats.scoreSum += winner.value() == game.currentPlayer ? 1 : -1;
+    }
+    game.makeAction(action);
+  }
+  games++;
+}
+
+size_t OpeningBookBuilder::numGames() const {
+  return games;
+}
+
+size_t OpeningBookBuilder::write(const std::string& path) const {
+  std::vector<BookEntry> entries;
+  for(const auto& position: positions) {
+    for(const auto& action: position.second) {
+      const ActionStats& stats = action.second;
+      if(stats.games < (uint32_t)minGames) continue;
+      BookEntry entry;
+      entry.key = position.first;
+      entry.action = action.first;
+      entry.weight = (uint16_t)std::min<uint32_t>(stats.games, UINT16_MAX);
+      entry.score = (int16_t)(1000 * (int64_t)stats.scoreSum / (int64_t)stats.games);
+      entry.reserved = 0;
+      entries.push_back(entry);
+    }
+  }
+  std::sort(entries.begin(), entries.end(), [](const BookEntry& a, const BookEntry& b) {
+    if(a.key != b.key) return a.key < b.key;
+    if(a.weight != b.weight) return a.weight > b.weight;
+    return a.action < b.action;
+  });
+
+  BookHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = BOOK_MAGIC;
+  header.version = BOOK_VERSION;
+  header.numEntries = entries.size();
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if(!out) {
+    throw std::runtime_error("Could not open book file " + path + " for writing");
+  }
+  out.write((const char*)&header, sizeof(header));
+  out.write((const char*)entries.data(), entries.size() * sizeof(BookEntry));
+  if(!out) {
+    throw std::runtime_error("Could not write book file " + path);
+  }
+  return entries.size();
+}
+
+OpeningBook::OpeningBook() {}
+
+OpeningBook::~OpeningBook() {
+  unload();
+}
+
+void OpeningBook::unload() {
+  if(mapping != nullptr) {
+    munmap(mapping, mappingSize);
+  }
+  mapping = nullptr;
+  mappingSize = 0;
+  entries = nullptr;
+  numEntries = 0;
+}
+
+void OpeningBook::load(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd < 0) {
+    throw std::runtime_error("Could not open book file " + path);
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size < (size_t)BOOK_HEADER_SIZE) {
+    close(fd);
+    throw std::runtime_error("Book file " + path + " is too small");
+  }
+  size_t size = st.st_size;
+  void* m = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(m == MAP_FAILED) {
+    throw std::runtime_error("Could not map book file " + path);
+  }
+
+  BookHeader header;
+  std::memcpy(&header, m, sizeof(header));
+  if(header.magic != BOOK_MAGIC || header.version != BOOK_VERSION || size != BOOK_HEADER_SIZE + header.numEntries * sizeof(BookEntry)) {
+    munmap(m, size);
+    throw std::runtime_error("Book file " + path + " has the wrong format");
+  }
+  unload();
+  mapping = m;
+  mappingSize = size;
+  entries = (const BookEntry*)((const uint8_t*)m + BOOK_HEADER_SIZE);
+  numEntries = header.numEntries;
+}
+
+void OpeningBook::find(uint64_t key, const BookEntry*& first, const BookEntry*& last) const {
+  // Everything before lo is smaller than key, everything from hi on is at least key.
+  size_t lo = 0;
+  size_t hi = numEntries;
+  for(int step = 0; step < 8 && hi - lo > 8; step++) {
+    uint64_t loKey = entries[lo].key;
+    uint64_t hiKey = entries[hi - 1].key;
+    if(key <= loKey) {
+      hi = lo;
+      break;
+    }
+    if(key > hiKey) {
+      lo = hi;
+      break;
+    }
+    size_t pos = lo + (size_t)((long double)(key - loKey) / (long double)(hiKey - loKey) * (hi - 1 - lo));
+    if(entries[pos].key < key) {
+      lo = pos + 1;
+    } else {
+      hi = pos;
+    }
+  }
+  first = std::lower_bound(entries + lo, entries + hi, key, [](const BookEntry& e, uint64_t k) {
+    return e.key < k;
+  });
+  last = first;
+  while(last != entries + numEntries && last->key == key) {
+    last++;
+  }
+}
+
+// The entry's action in game, which is the mirror image of the key's position if mirrored.
+static std::optional<PlayerAction> entryAction(Game& game, const BookEntry& entry, bool mirrored) {
+  PlayerAction action = unpackAction(entry.action);
+  if(mirrored) {
+    // Only a hash collision can put a castle here.
+    if(action.actionType == ActionType::MOVE_CASTLE) return std::nullopt;
+    action = mirrorAction(action);
+  }
+  // Guards against hash collisions.
+  if(!game.isActionLegal(action)) return std::nullopt;
+  return action;
+}
+
+std::optional<PlayerAction> OpeningBook::bestAction(Game& game) const {
+  if(game.isGameOver()) return std::nullopt;
+  const BookEntry* first;
+  const BookEntry* last;
+  CanonicalKey canonical = canonicalKey(game);
+  find(canonical.key, first, last);
+  for(const BookEntry* e = first; e != last; e++) {
+    std::optional<PlayerAction> action = entryAction(game, *e, canonical.mirrored);
+    if(action) return action;
+  }
+  return std::nullopt;
+}
+
+std::optional<PlayerAction> OpeningBook::sampleAction(Game& game, uint64_t random) const {
+  if(game.isGameOver()) return std::nullopt;
+  const BookEntry* first;
+  const BookEntry* last;
+  CanonicalKey canonical = canonicalKey(game);
+  find(canonical.key, first, last);
+  uint64_t totalWeight = 0;
+  for(const BookEntry* e = first; e != last; e++) {
+    if(entryAction(game, *e, canonical.mirrored)) {
+      totalWeight += e->weight;
+    }
+  }
+  if(totalWeight == 0) return std::nullopt;
+  uint64_t r = random % totalWeight;
+  for(const BookEntry* e = first; e != last; e++) {
+    std::optional<PlayerAction> action = entryAction(game, *e, canonical.mirrored);
+    if(!action) continue;
+    if(r < e->weight) return action;
+    r -= e->weight;
+  }
+  return std::nullopt;
+}
+
+size_t OpeningBook::size() const {
+  return numEntries;
+}
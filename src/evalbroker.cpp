@@ -0,0 +1,94 @@
+#include "nichess/evalbroker.hpp"
+
+#include <algorithm>
+
+using namespace nichess;
+
+EvaluationBroker::EvaluationBroker(BatchCallback evaluateBatch, int maxBatchSize, std::chrono::microseconds batchTimeout):
+  callback(evaluateBatch),
+  batchSize(std::max(maxBatchSize, 1)),
+  timeout(batchTimeout),
+  batches(0),
+  requests(0)
+{
+  worker = std::thread(&EvaluationBroker::run, this);
+}
+
+EvaluationBroker::~EvaluationBroker() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  requestAdded.notify_one();
+  worker.join();
+}
+
+float EvaluationBroker::evaluate(Game& game, const std::vector<PlayerAction>& actions, std::vector<float>& priors) {
+  BrokerRequest request;
+  request.game = &game;
+  request.actions = &actions;
+  request.priors = &priors;
+  std::unique_lock<std::mutex> lock(mutex);
+  if(pending.empty()) {
+    oldestPending = std::chrono::steady_clock::now();
+  }
+  pending.push_back(&request);
+  requestAdded.notify_one();
+  batchDone.wait(lock, [&request]() { return request.done; });
+  if(request.error) {
+    std::rethrow_exception(request.error);
+  }
+  return request.value;
+}
+
+void EvaluationBroker::run() {
+  std::vector<BrokerRequest*> batch;
+  std::unique_lock<std::mutex> lock(mutex);
+  while(true) {
+    requestAdded.wait(lock, [this]() { return stopping || !pending.empty(); });
+    if(pending.empty()) break;
+    requestAdded.wait_until(lock, oldestPending + timeout, [this]() { return stopping || pending.size() >= batchSize; });
+
+    size_t count = std::min(pending.size(), batchSize);
+    batch.assign(pending.begin(), pending.begin() + count);
+    pending.erase(pending.begin(), pending.begin() + count);
+    // Leftover requests start a new timeout.
+    oldestPending = std::chrono::steady_clock::now();
+    lock.unlock();
+
+    std::exception_ptr error;
+    try {
+      callback(batch);
+    } catch(...) {
+      error = std::current_exception();
+    }
+    batches++;
+    requests += count;
+
+    lock.lock();
+    for(BrokerRequest* request: batch) {
+      request->error = error;
+      request->done = true;
+    }
+    batchDone.notify_all();
+  }
+}
+
+uint64_t EvaluationBroker::numBatches() const {
+  return batches;
+}
+
+uint64_t EvaluationBroker::numRequests() const {
+  return requests;
+}
+
+double EvaluationBroker::averageBatchSize() const {
+  uint64_t b = batches;
+  return b == 0 ? 0 : (double)requests / b;
+}
+
+BrokerEvaluator::BrokerEvaluator(EvaluationBroker* evaluationBroker): broker(evaluationBroker) { }
+
+float BrokerEvaluator::evaluate(Game& game, const std::vector<PlayerAction>& actions, std::vector<float>& priors) {
+  return broker->evaluate(game, actions, priors);
+}
@@ -0,0 +1,230 @@
+#include "nichess/evaluation.hpp"
+#include "nichess/util.hpp"
+
+using namespace nichess;
+
+const int nichess::PIECE_VALUE[NUM_PIECE_TYPE] = {
+  0, 500, 450, 350, 350, 100,
+  0, 500, 450, 350, 350, 100,
+  0
+};
+
+const int nichess::STARTING_HEALTH_POINTS[NUM_PIECE_TYPE] = {
+  KING_STARTING_HEALTH_POINTS, MAGE_STARTING_HEALTH_POINTS, WARRIOR_STARTING_HEALTH_POINTS,
+  ASSASSIN_STARTING_HEALTH_POINTS, KNIGHT_STARTING_HEALTH_POINTS, PAWN_STARTING_HEALTH_POINTS,
+  KING_STARTING_HEALTH_POINTS, MAGE_STARTING_HEALTH_POINTS, WARRIOR_STARTING_HEALTH_POINTS,
+  ASSASSIN_STARTING_HEALTH_POINTS, KNIGHT_STARTING_HEALTH_POINTS, PAWN_STARTING_HEALTH_POINTS,
+  1
+};
+
+// Mobility weight per empty neighboring square.
+static const int MOBILITY_WEIGHT[NUM_PIECE_TYPE] = {
+  3, 4, 3, 4, 3, 1,
+  3, 4, 3, 4, 3, 1,
+  0
+};
+
+const int KING_ZONE_ATTACKER_WEIGHT = 40;
+const int KING_BLOCKED_ESCAPE_WEIGHT = 5;
+
+/*
+ * Piece-square tables from player 1's point of view, indexed by P1 piece type.
+ * Row 0 (player 1's back rank) comes first. Player 2 uses the tables mirrored vertically.
+ */
+static const int PIECE_SQUARE_TABLE[6][NUM_SQUARES] = {
+  // king
+  {
+     10,  15,  10,   0,   0,  10,  15,  10,
+      0,   0,  -5, -10, -10,  -5,   0,   0,
+    -20, -20, -25, -30, -30, -25, -20, -20,
+    -30, -30, -35, -40, -40, -35, -30, -30,
+    -40, -40, -45, -50, -50, -45, -40, -40,
+    -50, -50, -55, -60, -60, -55, -50, -50,
+    -60, -60, -65, -70, -70, -65, -60, -60,
+    -70, -70, -75, -80, -80, -75, -70, -70
+  },
+  // mage
+  {
+    -10,  -5,  -5,   0,   0,  -5,  -5, -10,
+     -5,   0,   5,   5,   5,   5,   0,  -5,
+     -5,   5,  10,  10,  10,  10,   5,  -5,
+      0,   5,  10,  15,  15,  10,   5,   0,
+      0,   5,  10,  15,  15,  10,   5,   0,
+     -5,   5,  10,  10,  10,  10,   5,  -5,
+     -5,   0,   5,   5,   5,   5,   0,  -5,
+    -10,  -5,  -5,   0,   0,  -5,  -5, -10
+  },
+  // warrior
+  {
+      0,   0,   5,  10,  10,   5,   0,   0,
+     -5,   0,   0,   5,   5,   0,   0,  -5,
+     -5,   0,   5,   5,   5,   5,   0,  -5,
+      0,   0,   5,  10,  10,   5,   0,   0,
+      0,   5,  10,  10,  10,  10,   5,   0,
+      5,  10,  10,  15,  15,  10,  10,   5,
+     10,  15,  15,  20,  20,  15,  15,  10,
+      5,   5,   5,  10,  10,   5,   5,   5
+  },
+  // assassin
+  {
+    -10, -10,  -5,  -5,  -5,  -5, -10, -10,
+    -10,   0,   0,   5,   5,   0,   0, -10,
+     -5,   0,  10,  10,  10,  10,   0,  -5,
+     -5,   5,  10,  15,  15,  10,   5,  -5,
+     -5,   5,  10,  15,  15,  10,   5,  -5,
+     -5,   0,  10,  10,  10,  10,   0,  -5,
+    -10,   0,   0,   5,   5,   0,   0, -10,
+    -10, -10,  -5,  -5,  -5,  -5, -10, -10
+  },
+  // knight
+  {
+    -50, -40, -30, -30, -30, -30, -40, -50,
+    -40, -20,   0,   5,   5,   0, -20, -40,
+    -30,   5,  10,  15,  15,  10,   5, -30,
+    -30,   0,  15,  20,  20,  15,   0, -30,
+    -30,   5,  15,  20,  20,  15,   5, -30,
+    -30,   0,  10,  15,  15,  10,   0, -30,
+    -40, -20,   0,   0,   0,   0, -20, -40,
+    -50, -40, -30, -30, -30, -30, -40, -50
+  },
+  // pawn
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      5,   5,  10,  15,  15,  10,   5,   5,
+     10,  10,  15,  25,  25,  15,  10,  10,
+     20,  20,  25,  35,  35,  25,  20,  20,
+     40,  40,  45,  55,  55,  45,  40,  40,
+     80,  80,  80,  80,  80,  80,  80,  80,
+      0,   0,   0,   0,   0,   0,   0,   0
+  }
+};
+
+static inline Player owner(PieceType pt) {
+  return pt < P2_KING ? PLAYER_1 : PLAYER_2;
+}
+
+static inline int materialValue(const Piece& p) {
+  return PIECE_VALUE[p.type] * p.healthPoints / STARTING_HEALTH_POINTS[p.type];
+}
+
+static inline int pieceSquareValue(const Piece& p, int squareIndex) {
+  if(p.type < P2_KING) {
+    return PIECE_SQUARE_TABLE[p.type][squareIndex];
+  }
+  return PIECE_SQUARE_TABLE[p.type - P2_KING][squareIndex ^ 56];
+}
+
+static inline int emptyNeighbors(const Piece squares[], int squareIndex) {
+  int retval = 0;
+  const std::vector<int> &neighbors = GameCache::squareToNeighboringSquares[squareIndex];
+  for(size_t i = 0; i < neighbors.size(); i++) {
+    if(squares[neighbors[i]].type == NO_PIECE) retval++;
+  }
+  return retval;
+}
+
+EvalAccumulator::EvalAccumulator() {
+  clear();
+}
+
+void EvalAccumulator::clear() {
+  for(int i = 0; i < NUM_PLAYERS; i++) {
+    material[i] = 0;
+    pieceSquare[i] = 0;
+    mobility[i] = 0;
+  }
+}
+
+void EvalAccumulator::update(const Piece squares[], int squareIndex, const Piece& after) {
+  const Piece& before = squares[squareIndex];
+  if(before.type != NO_PIECE) {
+    Player p = owner(before.type);
+    material[p] -= materialValue(before);
+    pieceSquare[p] -= pieceSquareValue(before, squareIndex);
+    mobility[p] -= MOBILITY_WEIGHT[before.type] * emptyNeighbors(squares, squareIndex);
+  }
+  if(after.type != NO_PIECE) {
+    Player p = owner(after.type);
+    material[p] += materialValue(after);
+    pieceSquare[p] += pieceSquareValue(after, squareIndex);
+    mobility[p] += MOBILITY_WEIGHT[after.type] * emptyNeighbors(squares, squareIndex);
+  }
+
+  // Square becoming empty or occupied changes the mobility of the pieces around it.
+  bool wasEmpty = before.type == NO_PIECE;
+  bool isEmpty = after.type == NO_PIECE;
+  if(wasEmpty != isEmpty) {
+    int delta = isEmpty ? 1 : -1;
+    const std::vector<int> &neighbors = GameCache::squareToNeighboringSquares[squareIndex];
+    for(size_t i = 0; i < neighbors.size(); i++) {
+      const Piece& neighbor = squares[neighbors[i]];
+      if(neighbor.type == NO_PIECE) continue;
+      mobility[owner(neighbor.type)] += delta * MOBILITY_WEIGHT[neighbor.type];
+    }
+  }
+}
+
+bool EvalAccumulator::operator==(const EvalAccumulator& other) const {
+  for(int i = 0; i < NUM_PLAYERS; i++) {
+    if(material[i] != other.material[i] || pieceSquare[i] != other.pieceSquare[i] || mobility[i] != other.mobility[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Enemy pieces next to the king or a knight's jump away, and occupied escape squares.
+ * Only looks at the squares around the king.
+ */
+int nichess::kingDanger(Game& game, Player player) {
+  Piece* king = game.playerToKing[player];
+  if(king->healthPoints <= 0) return 0;
+  Player opponent = ~player;
+  int danger = 0;
+  const std::vector<int> &neighbors = GameCache::squareToNeighboringSquares[king->squareIndex];
+  for(size_t i = 0; i < neighbors.size(); i++) {
+    PieceType pt = game.board[neighbors[i]]->type;
+    if(pt == NO_PIECE) continue;
+    if(pieceBelongsToPlayer(pt, opponent)) {
+      danger += KING_ZONE_ATTACKER_WEIGHT;
+    } else {
+      danger += KING_BLOCKED_ESCAPE_WEIGHT;
+    }
+  }
+  PieceType enemyKnight = player == PLAYER_1 ? P2_KNIGHT : P1_KNIGHT;
+  const std::vector<int> &knightSquares = GameCache::squareToKnightActionSquares[king->squareIndex];
+  for(size_t i = 0; i < knightSquares.size(); i++) {
+    if(game.board[knightSquares[i]]->type == enemyKnight) {
+      danger += KING_ZONE_ATTACKER_WEIGHT;
+    }
+  }
+  return danger;
+}
+
+int nichess::evaluate(Game& game) {
+  Player us = game.currentPlayer;
+  Player them = ~us;
+  const EvalAccumulator& acc = game.evalAccumulator;
+  int score = acc.material[us] - acc.material[them];
+  score += acc.pieceSquare[us] - acc.pieceSquare[them];
+  score += acc.mobility[us] - acc.mobility[them];
+  score -= kingDanger(game, us) - kingDanger(game, them);
+  return score;
+}
+
+int MaterialEvaluator::evaluate(Game& game) {
+  int score = 0;
+  for(Piece* p: game.playerToPieces[game.currentPlayer]) {
+    if(p->healthPoints > 0) score += p->healthPoints;
+  }
+  for(Piece* p: game.playerToPieces[~game.currentPlayer]) {
+    if(p->healthPoints > 0) score -= p->healthPoints;
+  }
+  return score;
+}
+
+int StaticEvaluator::evaluate(Game& game) {
+  return nichess::evaluate(game);
+}
@@ -0,0 +1,136 @@
+#include "nichess/exchange.hpp"
+#include "nichess/attackmap.hpp"
+#include "nichess/evaluation.hpp"
+#include "nichess/util.hpp"
+
+#include <algorithm>
+#include <climits>
+
+using namespace nichess;
+
+static int abilityDamage(PieceType type) {
+  switch(type) {
+    case P1_KING:
+    case P2_KING:
+      return KING_ABILITY_POINTS;
+    case P1_MAGE:
+    case P2_MAGE:
+      return MAGE_ABILITY_POINTS;
+    case P1_WARRIOR:
+    case P2_WARRIOR:
+      return WARRIOR_ABILITY_POINTS;
+    case P1_ASSASSIN:
+    case P2_ASSASSIN:
+      return ASSASSIN_ABILITY_POINTS;
+    case P1_KNIGHT:
+    case P2_KNIGHT:
+      return KNIGHT_ABILITY_POINTS;
+    case P1_PAWN:
+    case P2_PAWN:
+      return PAWN_ABILITY_POINTS;
+    default:
+      return 0;
+  }
+}
+
+static int exchangeValue(PieceType type, int healthPoints) {
+  if(type == P1_KING || type == P2_KING) return EXCHANGE_KING_VALUE;
+  return PIECE_VALUE[type] * healthPoints / STARTING_HEALTH_POINTS[type];
+}
+
+static Player owner(PieceType type) {
+  return pieceBelongsToPlayer(type, PLAYER_1) ? PLAYER_1 : PLAYER_2;
+}
+
+/*
+ * The piece that kills on target and becomes the next target. Pawns that reach the last row are
+ * promoted. Returns the promotion's gain.
+ */
+static int occupyTarget(const Piece& attacker, int target, PieceType& type, int& healthPoints) {
+  type = attacker.type;
+  healthPoints = attacker.healthPoints;
+  if((type == P1_PAWN && target >= NUM_SQUARES - NUM_COLUMNS) || (type == P2_PAWN && target < NUM_COLUMNS)) {
+    int before = exchangeValue(type, healthPoints);
+    type = type == P1_PAWN ? P1_WARRIOR : P2_WARRIOR;
+    healthPoints = WARRIOR_STARTING_HEALTH_POINTS;
+    return exchangeValue(type, healthPoints) - before;
+  }
+  return 0;
+}
+
+// Best gain of side from attacking the piece of the other side on target, at least 0.
+static int exchange(const Piece squares[], uint64_t occupied, int target, PieceType type, int healthPoints, Player side) {
+  uint64_t attackers = attackersOf(squares, occupied, target);
+  int bestHit = 0;
+  int killer = -1;
+  int killerValue = INT_MAX;
+  for(; attackers; attackers &= attackers - 1) {
+    int s = __builtin_ctzll(attackers);
+    if(owner(squares[s].type) != side) continue;
+    int damage = abilityDamage(squares[s].type);
+    if(damage >= healthPoints) {
+      int value = exchangeValue(squares[s].type, squares[s].healthPoints);
+      if(value < killerValue) {
+        killer = s;
+        killerValue = value;
+      }
+    } else {
+      bestHit = std::max(bestHit, exchangeValue(type, healthPoints) - exchangeValue(type, healthPoints - damage));
+    }
+  }
+  if(killer < 0) return bestHit;
+
+  int gain = exchangeValue(type, healthPoints);
+  if(type == P1_KING || type == P2_KING) return gain;
+  PieceType nextType;
+  int nextHealthPoints;
+  gain += occupyTarget(squares[killer], target, nextType, nextHealthPoints);
+  gain -= exchange(squares, occupied & ~(1ULL << killer), target, nextType, nextHealthPoints, ~side);
+  return std::max(bestHit, gain);
+}
+
+static uint64_t occupiedSquares(const Game& game) {
+  uint64_t occupied = 0;
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    if(game.syncedSquares[i].type != PieceType::NO_PIECE) {
+      occupied |= 1ULL << i;
+    }
+  }
+  return occupied;
+}
+
+int nichess::damageExchange(Game& game, const PlayerAction& action) {
+  switch(action.actionType) {
+    case ActionType::ABILITY_KING_DAMAGE:
+    case ActionType::ABILITY_MAGE_DAMAGE:
+    case ActionType::ABILITY_P1_PAWN_DAMAGE_AND_PROMOTION:
+    case ActionType::ABILITY_P2_PAWN_DAMAGE_AND_PROMOTION:
+    case ActionType::ABILITY_WARRIOR_DAMAGE:
+    case ActionType::ABILITY_ASSASSIN_DAMAGE:
+    case ActionType::ABILITY_KNIGHT_DAMAGE:
+    case ActionType::ABILITY_PAWN_DAMAGE:
+      break;
+    default:
+      return 0;
+  }
+  const Piece* squares = game.syncedSquares;
+  const Piece& attacker = squares[action.srcIdx];
+  const Piece& target = squares[action.dstIdx];
+  int damage = abilityDamage(attacker.type);
+  if(damage < target.healthPoints) {
+    return exchangeValue(target.type, target.healthPoints) - exchangeValue(target.type, target.healthPoints - damage);
+  }
+  int gain = exchangeValue(target.type, target.healthPoints);
+  if(target.type == P1_KING || target.type == P2_KING) return gain;
+  PieceType nextType;
+  int nextHealthPoints;
+  gain += occupyTarget(attacker, action.dstIdx, nextType, nextHealthPoints);
+  uint64_t occupied = occupiedSquares(game) & ~(1ULL << action.srcIdx);
+  return gain - exchange(squares, occupied, action.dstIdx, nextType, nextHealthPoints, ~owner(attacker.type));
+}
+
+int nichess::squareExchange(Game& game, int squareIndex) {
+  const Piece& target = game.syncedSquares[squareIndex];
+  if(target.type == PieceType::NO_PIECE) return 0;
+  return exchange(game.syncedSquares, occupiedSquares(game), squareIndex, target.type, target.healthPoints, ~owner(target.type));
+}
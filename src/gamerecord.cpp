@@ -0,0 +1,285 @@
+#include "nichess/gamerecord.hpp"
+#include "nichess/packedposition.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace nichess;
+
+class GameRecordHeader {
+  public:
+    uint32_t magic;
+    uint32_t version;
+    uint64_t numGames;
+    uint64_t indexOffset;
+    uint32_t checkpointInterval;
+    uint8_t reserved[4];
+};
+
+static_assert(sizeof(GameRecordHeader) == GAME_RECORD_HEADER_SIZE, "GameRecordHeader has to match GAME_RECORD_HEADER_SIZE");
+
+static const uint8_t NO_WINNER = 2;
+// Action count, result, checkpoint count and start position.
+static const size_t MAX_GAME_PREFIX_SIZE = 10 + 1 + 10 + MAX_PACKED_POSITION_SIZE;
+
+static size_t writeVarint(uint64_t value, uint8_t* out) {
+  size_t n = 0;
+  while(value >= 0x80) {
+    out[n++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[n++] = (uint8_t)value;
+  return n;
+}
+
+// Returns the number of bytes read, 0 if the varint doesn't end before last.
+static size_t readVarint(const uint8_t* in, const uint8_t* last, uint64_t& value) {
+  value = 0;
+  for(size_t n = 0; n < 10 && in + n < last; n++) {
+    value |= (uint64_t)(in[n] & 0x7F) << (7 * n);
+    if(!(in[n] & 0x80)) return n + 1;
+  }
+  return 0;
+}
+
+GameRecordWriter::GameRecordWriter(const std::string& filePath): path(filePath), out(filePath, std::ios::binary | std::ios::trunc) {
+  if(!out) {
+    throw std::runtime_error("Could not open game record file " + path + " for writing");
+  }
+  // The header is written again by finish.
+  GameRecordHeader header;
+  std::memset(&header, 0, sizeof(header));
+  out.write((const char*)&header, sizeof(header));
+  offset = sizeof(header);
+}
+
+GameRecordWriter::~GameRecordWriter() {
+  if(finished) return;
+  try {
+    finish();
+  } catch(const std::runtime_error& e) {
+  }
+}
+
+void GameRecordWriter::addGame(const Game& start, const std::vector<PlayerAction>& actions, std::optional<Player> winner) {
+  if(finished) {
+    throw std::runtime_error("Game record file " + path + " is already finished");
+  }
+  if(start.playerToKing[PLAYER_1]->healthPoints <= 0 || start.playerToKing[PLAYER_2]->healthPoints <= 0) {
+    throw std::runtime_error("Game record start positions need both kings");
+  }
+  if(checkpointInterval < 0 || (!offsets.empty() && checkpointInterval != writtenInterval)) {
+    throw std::runtime_error("Game record checkpoint interval can't change");
+  }
+  writtenInterval = checkpointInterval;
+
+  std::vector<uint8_t> checkpoints;
+  size_t numCheckpoints = 0;
+  if(checkpointInterval > 0 && actions.size() >= (size_t)checkpointInterval) {
+    Game game = Game(start);
+    for(size_t ply = 1; ply <= actions.size(); ply++) {
+      game.makeAction(actions[ply - 1]);
+      if(ply % checkpointInterval != 0) continue;
+      if(game.playerToKing[PLAYER_1]->healthPoints <= 0 || game.playerToKing[PLAYER_2]->healthPoints <= 0) break;
+      size_t size = checkpoints.size();
+      checkpoints.resize(size + MAX_PACKED_POSITION_SIZE);
+      checkpoints.resize(size + packPosition(game, checkpoints.data() + size));
+      numCheckpoints++;
+    }
+  }
+
+  uint8_t prefix[MAX_GAME_PREFIX_SIZE];
+  size_t n = writeVarint(actions.size(), prefix);
+  prefix[n++] = winner ? (uint8_t)*winner : NO_WINNER;
+  n += writeVarint(numCheckpoints, prefix + n);
+  n += packPosition(start, prefix + n);
+  out.write((const char*)prefix, n);
+  std::vector<PackedAction> packedActions(actions.size());
+  for(size_t i = 0; i < actions.size(); i++) {
+    packedActions[i] = packAction(actions[i]);
+  }
+  out.write((const char*)packedActions.data(), packedActions.size() * sizeof(PackedAction));
+  out.write((const char*)checkpoints.data(), checkpoints.size());
+  offsets.push_back(offset);
+  offset += n + packedActions.size() * sizeof(PackedAction) + checkpoints.size();
+}
+
+size_t GameRecordWriter::numGames() const {
+  return offsets.size();
+}
+
+uint64_t GameRecordWriter::size() const {
+  return offset;
+}
+
+void GameRecordWriter::finish() {
+  if(finished) return;
+  finished = true;
+  const char padding[8] = {0};
+  uint64_t indexOffset = (offset + 7) / 8 * 8;
+  out.write(padding, indexOffset - offset);
+  out.write((const char*)offsets.data(), offsets.size() * sizeof(uint64_t));
+
+  GameRecordHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = GAME_RECORD_MAGIC;
+  header.version = GAME_RECORD_VERSION;
+  header.numGames = offsets.size();
+  header.indexOffset = indexOffset;
+  header.checkpointInterval = writtenInterval;
+  out.seekp(0);
+  out.write((const char*)&header, sizeof(header));
+  out.close();
+  if(!out) {
+    throw std::runtime_error("Could not write game record file " + path);
+  }
+}
+
+PlayerAction RecordedGame::action(size_t ply) const {
+  PackedAction packed;
+  std::memcpy(&packed, actions + ply * sizeof(PackedAction), sizeof(packed));
+  return unpackAction(packed);
+}
+
+void RecordedGame::startPosition(Game& game) const {
+  unpackPosition(start, MAX_PACKED_POSITION_SIZE, game);
+}
+
+void RecordedGame::positionAt(size_t ply, Game& game) const {
+  if(ply > numActions) {
+    throw std::runtime_error("Game record ply out of range");
+  }
+  size_t checkpoint = checkpointInterval > 0 ? std::min(ply / checkpointInterval, numCheckpoints) : 0;
+  if(checkpoint == 0) {
+    startPosition(game);
+  } else {
+    // Checkpoints were checked to be in bounds by GameRecordReader::game.
+    const uint8_t* p = checkpoints;
+    for(size_t i = 1; i < checkpoint; i++) {
+      p += packedPositionSize(p, MAX_PACKED_POSITION_SIZE);
+    }
+    unpackPosition(p, MAX_PACKED_POSITION_SIZE, game);
+  }
+  for(size_t i = checkpoint * checkpointInterval; i < ply; i++) {
+    game.makeAction(action(i));
+  }
+}
+
+void RecordedGame::replay(Game& game, const std::function<void(const Game& game, const PlayerAction* next)>& f) const {
+  startPosition(game);
+  for(size_t i = 0; i < numActions; i++) {
+    PlayerAction next = action(i);
+    f(game, &next);
+    game.makeAction(next);
+  }
+  f(game, nullptr);
+}
+
+GameRecordReader::GameRecordReader() {}
+
+GameRecordReader::~GameRecordReader() {
+  unload();
+}
+
+void GameRecordReader::unload() {
+  if(mapping != nullptr) {
+    munmap(mapping, mappingSize);
+  }
+  mapping = nullptr;
+  mappingSize = 0;
+  index = nullptr;
+  games = 0;
+  checkpointInterval = 0;
+}
+
+void GameRecordReader::load(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd < 0) {
+    throw std::runtime_error("Could not open game record file " + path);
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size < (size_t)GAME_RECORD_HEADER_SIZE) {
+    close(fd);
+    throw std::runtime_error("Game record file " + path + " is too small");
+  }
+  size_t size = st.st_size;
+  void* m = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(m == MAP_FAILED) {
+    throw std::runtime_error("Could not map game record file " + path);
+  }
+  // Games are mostly read in order.
+  madvise(m, size, MADV_SEQUENTIAL);
+
+  GameRecordHeader header;
+  std::memcpy(&header, m, sizeof(header));
+  if(header.magic != GAME_RECORD_MAGIC || header.version != GAME_RECORD_VERSION || header.indexOffset > size ||
+      (size - header.indexOffset) / sizeof(uint64_t) != header.numGames) {
+    munmap(m, size);
+    throw std::runtime_error("Game record file " + path + " has the wrong format");
+  }
+  unload();
+  mapping = m;
+  mappingSize = size;
+  index = (const uint8_t*)m + header.indexOffset;
+  games = header.numGames;
+  checkpointInterval = header.checkpointInterval;
+}
+
+size_t GameRecordReader::numGames() const {
+  return games;
+}
+
+RecordedGame GameRecordReader::game(size_t gameIndex) const {
+  if(gameIndex >= games) {
+    throw std::runtime_error("Game record index out of range");
+  }
+  const uint8_t* data = (const uint8_t*)mapping;
+  // Games end where the index starts.
+  const uint8_t* last = index;
+  uint64_t offset;
+  std::memcpy(&offset, index + gameIndex * sizeof(uint64_t), sizeof(offset));
+  if(offset < (uint64_t)GAME_RECORD_HEADER_SIZE || offset >= (uint64_t)(last - data)) {
+    throw std::runtime_error("Game record offset out of range");
+  }
+  const uint8_t* p = data + offset;
+  uint64_t numActions;
+  uint64_t numCheckpoints;
+  size_t n = readVarint(p, last, numActions);
+  if(n == 0 || p + n >= last || p[n] > NO_WINNER) {
+    throw std::runtime_error("Game record is corrupt");
+  }
+  RecordedGame game;
+  game.winner = p[n] == NO_WINNER ? std::nullopt : std::optional<Player>((Player)p[n]);
+  game.numActions = numActions;
+  p += n + 1;
+  n = readVarint(p, last, numCheckpoints);
+  if(n == 0 || numCheckpoints > numActions) {
+    throw std::runtime_error("Game record is corrupt");
+  }
+  game.numCheckpoints = numCheckpoints;
+  game.checkpointInterval = checkpointInterval;
+  game.start = p + n;
+  size_t positionSize = packedPositionSize(game.start, last - game.start);
+  if(positionSize == 0 || positionSize > (size_t)(last - game.start) ||
+      numActions > (size_t)(last - game.start - positionSize) / sizeof(PackedAction)) {
+    throw std::runtime_error("Game record is corrupt");
+  }
+  game.actions = game.start + positionSize;
+  game.checkpoints = game.actions + numActions * sizeof(PackedAction);
+  p = game.checkpoints;
+  for(size_t i = 0; i < numCheckpoints; i++) {
+    positionSize = packedPositionSize(p, last - p);
+    if(positionSize == 0 || positionSize > (size_t)(last - p)) {
+      throw std::runtime_error("Game record is corrupt");
+    }
+    p += positionSize;
+  }
+  return game;
+}
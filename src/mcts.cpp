@@ -0,0 +1,645 @@
+#include "nichess/mcts.hpp"
+#include "nichess/book.hpp"
+#include "nichess/evaluation.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <thread>
+
+using namespace nichess;
+
+RandomPlayoutEvaluator::RandomPlayoutEvaluator(int playoutPlies, unsigned int seed): maxPlies(playoutPlies), rng(seed) { }
+
+float RandomPlayoutEvaluator::evaluate(Game& game, const std::vector<PlayerAction>& actions, std::vector<float>& priors) {
+  priors.assign(actions.size(), actions.empty() ? 0 : 1.0f / actions.size());
+  Player player = game.currentPlayer;
+  undoStack.clear();
+  for(int i = 0; i < maxPlies && !game.isGameOver(); i++) {
+    std::vector<PlayerAction> legalActions = game.generateLegalActions();
+    if(legalActions.empty()) break;
+    undoStack.push_back(game.makeAction(legalActions[rng() % legalActions.size()]));
+  }
+  float value = 0;
+  std::optional<Player> winner = game.winner();
+  if(winner) {
+    value = *winner == player ? 1 : -1;
+  }
+  while(!undoStack.empty()) {
+    game.undoAction(undoStack.back());
+    undoStack.pop_back();
+  }
+  return value;
+}
+
+StaticLeafEvaluator::StaticLeafEvaluator(float evaluationScale): scale(evaluationScale) { }
+
+float StaticLeafEvaluator::evaluate(Game& game, const std::vector<PlayerAction>& actions, std::vector<float>& priors) {
+  priors.assign(actions.size(), actions.empty() ? 0 : 1.0f / actions.size());
+  return std::tanh(nichess::evaluate(game) / scale);
+}
+
+CallbackLeafEvaluator::CallbackLeafEvaluator(std::function<float(Game&, const std::vector<PlayerAction>&, std::vector<float>&)> evaluateFunction): callback(evaluateFunction) { }
+
+float CallbackLeafEvaluator::evaluate(Game& game, const std::vector<PlayerAction>& actions, std::vector<float>& priors) {
+  return callback(game, actions, priors);
+}
+
+float MCTSNode::value() const {
+  uint32_t n = visits.load(std::memory_order_relaxed);
+  if(n == 0) return 0;
+  return (float)valueSum.load(std::memory_order_relaxed) / MCTS_VALUE_SCALE / n;
+}
+
+MCTSArena::MCTSArena(uint32_t maxNodes, uint32_t maxEdges):
+  nodes(new MCTSNode[maxNodes]),
+  edges(new MCTSEdge[maxEdges]),
+  nodeCapacity(maxNodes),
+  edgeCapacity(maxEdges),
+  numNodes(0),
+  numEdges(0)
+{ }
+
+void MCTSArena::clear() {
+  numNodes = 0;
+  numEdges = 0;
+}
+
+uint32_t MCTSArena::allocateNode() {
+  uint32_t idx = numNodes.load(std::memory_order_relaxed);
+  do {
+    if(idx >= nodeCapacity) return MCTS_NULL_NODE;
+  } while(!numNodes.compare_exchange_weak(idx, idx + 1, std::memory_order_relaxed));
+  MCTSNode& node = nodes[idx];
+  node.valueSum.store(0, std::memory_order_relaxed);
+  node.visits.store(0, std::memory_order_relaxed);
+  node.virtualLoss.store(0, std::memory_order_relaxed);
+  node.firstEdge = 0;
+  node.numEdges = 0;
+  node.terminalValue = 0;
+  node.key = 0;
+  node.state.store(MCTSNodeState::UNEXPANDED, std::memory_order_relaxed);
+  return idx;
+}
+
+uint32_t MCTSArena::allocateEdges(uint32_t count) {
+  uint32_t first = numEdges.load(std::memory_order_relaxed);
+  do {
+    if(edgeCapacity - first < count) return MCTS_NULL_NODE;
+  } while(!numEdges.compare_exchange_weak(first, first + count, std::memory_order_relaxed));
+  return first;
+}
+
+size_t MCTSArena::memoryUsage() const {
+  return (size_t)numNodes.load() * sizeof(MCTSNode) + (size_t)numEdges.load() * sizeof(MCTSEdge);
+}
+
+MCTS::MCTS(LeafEvaluator* evaluator, uint32_t nodeCapacity, uint32_t edgeCapacity):
+  MCTS(std::vector<LeafEvaluator*>{evaluator}, nodeCapacity, edgeCapacity)
+{ }
+
+MCTS::MCTS(const std::vector<LeafEvaluator*>& evaluators, uint32_t nodeCapacity, uint32_t edgeCapacity):
+  arena(new MCTSArena(nodeCapacity, edgeCapacity)),
+  root(MCTS_NULL_NODE),
+  rootHash(0),
+  stopFlag(false),
+  startedSimulations(0),
+  collectionRequested(false)
+{
+  if(evaluators.empty()) {
+    throw std::invalid_argument("MCTS needs at least one leaf evaluator");
+  }
+  workers.resize(evaluators.size());
+  for(size_t i = 0; i < evaluators.size(); i++) {
+    workers[i].evaluator = evaluators[i];
+  }
+}
+
+void MCTS::reset() {
+  arena->clear();
+  root = MCTS_NULL_NODE;
+}
+
+static inline uint64_t tableKey(long int hash) {
+  // 0 marks an empty slot.
+  return hash == 0 ? 1 : (uint64_t)hash;
+}
+
+void MCTS::clearTable() {
+  if(!table) {
+    size_t size = 1;
+    while(size < 2 * (size_t)arena->nodeCapacity) size <<= 1;
+    table.reset(new MCTSTableEntry[size]);
+    tableMask = size - 1;
+  }
+  for(size_t i = 0; i <= tableMask; i++) {
+    table[i].key.store(0, std::memory_order_relaxed);
+    table[i].node.store(MCTS_NULL_NODE, std::memory_order_relaxed);
+  }
+}
+
+/*
+ * Returns the node of the position with the given key, allocating it if there is none yet.
+ * Returns MCTS_NULL_NODE when the arena is full.
+ */
+uint32_t MCTS::findOrCreateNode(uint64_t key) {
+  uint32_t newNode = MCTS_NULL_NODE;
+  for(size_t probe = 0, i = key & tableMask; probe <= tableMask; probe++, i = (i + 1) & tableMask) {
+    MCTSTableEntry& entry = table[i];
+    uint64_t entryKey = entry.key.load(std::memory_order_acquire);
+    if(entryKey == 0) {
+      if(newNode == MCTS_NULL_NODE) {
+        newNode = arena->allocateNode();
+        if(newNode == MCTS_NULL_NODE) return MCTS_NULL_NODE;
+        arena->nodes[newNode].key = key;
+      }
+      if(entry.key.compare_exchange_strong(entryKey, key, std::memory_order_acq_rel)) {
+        entry.node.store(newNode, std::memory_order_release);
+        return newNode;
+      }
+      // entryKey now holds the key another thread put into the slot.
+    }
+    if(entryKey == key) {
+      // If a node was allocated above it stays unreachable.
+      uint32_t node;
+      while((node = entry.node.load(std::memory_order_acquire)) == MCTS_NULL_NODE) {
+        std::this_thread::yield();
+      }
+      return node;
+    }
+  }
+  return MCTS_NULL_NODE;
+}
+
+void MCTS::rebuildTable() {
+  clearTable();
+  for(uint32_t i = 0; i < arena->numNodes; i++) {
+    uint64_t key = arena->nodes[i].key;
+    for(size_t j = key & tableMask;; j = (j + 1) & tableMask) {
+      if(table[j].key.load(std::memory_order_relaxed) == 0) {
+        table[j].key.store(key, std::memory_order_relaxed);
+        table[j].node.store(i, std::memory_order_relaxed);
+        break;
+      }
+    }
+  }
+}
+
+/*
+ * Copies the subtree below oldRoot from arena to spareArena, which then becomes the arena.
+ * Children with fewer than minVisits visits are dropped together with their subtrees, the edge
+ * leading to them looks unvisited afterwards. Nodes of the old arena are reclaimed in O(1)
+ * by clearing it.
+ */
+void MCTS::compact(uint32_t oldRoot, uint32_t minVisits) {
+  if(!spareArena) {
+    spareArena.reset(new MCTSArena(arena->nodeCapacity, arena->edgeCapacity));
+  }
+  MCTSArena& src = *arena;
+  MCTSArena& dst = *spareArena;
+  dst.clear();
+  // Old to new index, nodes reached through several edges are only copied once.
+  std::vector<uint32_t> remap(src.numNodes, MCTS_NULL_NODE);
+  std::vector<std::pair<uint32_t, uint32_t>> stack;
+  uint32_t newRoot = dst.allocateNode();
+  remap[oldRoot] = newRoot;
+  stack.emplace_back(oldRoot, newRoot);
+  while(!stack.empty()) {
+    uint32_t srcIdx = stack.back().first;
+    uint32_t dstIdx = stack.back().second;
+    stack.pop_back();
+    const MCTSNode& from = src.nodes[srcIdx];
+    MCTSNode& to = dst.nodes[dstIdx];
+    to.valueSum.store(from.valueSum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    to.visits.store(from.visits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    to.terminalValue = from.terminalValue;
+    to.key = from.key;
+    MCTSNodeState state = from.state.load(std::memory_order_relaxed);
+    to.state.store(state, std::memory_order_relaxed);
+    if(state != MCTSNodeState::EXPANDED) continue;
+    // Both arenas have the same capacity, so the subtree always fits.
+    uint32_t firstEdge = dst.allocateEdges(from.numEdges);
+    to.firstEdge = firstEdge;
+    to.numEdges = from.numEdges;
+    for(uint32_t i = 0; i < from.numEdges; i++) {
+      const MCTSEdge& fromEdge = src.edges[from.firstEdge + i];
+      MCTSEdge& toEdge = dst.edges[firstEdge + i];
+      toEdge.action = fromEdge.action;
+      toEdge.prior = fromEdge.prior;
+      uint32_t child = fromEdge.child.load(std::memory_order_relaxed);
+      bool keep = child != MCTS_NULL_NODE && src.nodes[child].visits.load(std::memory_order_relaxed) >= minVisits;
+      uint32_t newChild = MCTS_NULL_NODE;
+      if(keep) {
+        newChild = remap[child];
+        if(newChild == MCTS_NULL_NODE) {
+          newChild = dst.allocateNode();
+          remap[child] = newChild;
+          stack.emplace_back(child, newChild);
+        }
+      }
+      toEdge.child.store(newChild, std::memory_order_relaxed);
+      toEdge.visits.store(keep ? fromEdge.visits.load(std::memory_order_relaxed) : 0, std::memory_order_relaxed);
+    }
+  }
+  std::swap(arena, spareArena);
+  spareArena->clear();
+  root = newRoot;
+  if(useTranspositions) {
+    rebuildTable();
+  }
+}
+
+/*
+ * Keeps the most visited nodes, at most recycleKeepFraction of the arena. In a tree children never
+ * have more visits than their parent, so all nodes above a visit threshold stay connected to the
+ * root. In a graph the nodes above the threshold that are only reachable through pruned ones are
+ * dropped as well.
+ */
+void MCTS::collect() {
+  std::vector<std::pair<uint32_t, uint16_t>> nodeStats;
+  std::vector<bool> seen(arena->numNodes, false);
+  std::vector<uint32_t> stack{root};
+  seen[root] = true;
+  while(!stack.empty()) {
+    const MCTSNode& node = arena->nodes[stack.back()];
+    stack.pop_back();
+    bool expanded = node.state.load(std::memory_order_relaxed) == MCTSNodeState::EXPANDED;
+    nodeStats.emplace_back(node.visits.load(std::memory_order_relaxed), expanded ? node.numEdges : 0);
+    if(!expanded) continue;
+    for(uint32_t i = node.firstEdge; i < node.firstEdge + node.numEdges; i++) {
+      uint32_t child = arena->edges[i].child.load(std::memory_order_relaxed);
+      if(child != MCTS_NULL_NODE && !seen[child]) {
+        seen[child] = true;
+        stack.push_back(child);
+      }
+    }
+  }
+  std::sort(nodeStats.begin(), nodeStats.end(), [](const std::pair<uint32_t, uint16_t>& a, const std::pair<uint32_t, uint16_t>& b) {
+    return a.first > b.first;
+  });
+  uint64_t maxNodes = arena->nodeCapacity * recycleKeepFraction;
+  uint64_t maxEdges = arena->edgeCapacity * recycleKeepFraction;
+  uint64_t keptNodes = 0;
+  uint64_t keptEdges = 0;
+  uint32_t minVisits = 0;
+  for(const std::pair<uint32_t, uint16_t>& stat: nodeStats) {
+    if(keptNodes + 1 > maxNodes || keptEdges + stat.second > maxEdges) {
+      minVisits = stat.first + 1;
+      break;
+    }
+    keptNodes++;
+    keptEdges += stat.second;
+  }
+  compact(root, minVisits);
+  prunedNodes += nodeStats.size() - arena->numNodes;
+  collections++;
+}
+
+// Called between simulations. The last worker to arrive runs the collection.
+void MCTS::pauseForCollection() {
+  std::unique_lock<std::mutex> lock(collectionMutex);
+  if(!collectionRequested.load(std::memory_order_relaxed)) return;
+  pausedWorkers++;
+  if(pausedWorkers == activeWorkers) {
+    finishCollection();
+  } else {
+    uint64_t generation = collectionGeneration;
+    collectionDone.wait(lock, [&]() { return collectionGeneration != generation; });
+  }
+}
+
+void MCTS::leaveCollection() {
+  std::unique_lock<std::mutex> lock(collectionMutex);
+  activeWorkers--;
+  if(collectionRequested.load(std::memory_order_relaxed) && activeWorkers > 0 && pausedWorkers == activeWorkers) {
+    finishCollection();
+  }
+}
+
+// collectionMutex has to be held.
+void MCTS::finishCollection() {
+  collect();
+  pausedWorkers = 0;
+  collectionGeneration++;
+  collectionRequested.store(false, std::memory_order_relaxed);
+  collectionDone.notify_all();
+}
+
+void MCTS::arenaFull() {
+  if(recycleNodes) {
+    collectionRequested.store(true, std::memory_order_relaxed);
+  }
+}
+
+void MCTS::advance(Game& game, const PlayerAction& action) {
+  if(root == MCTS_NULL_NODE) return;
+  const MCTSNode& rootNode = arena->nodes[root];
+  uint32_t child = MCTS_NULL_NODE;
+  if(rootNode.state.load() == MCTSNodeState::EXPANDED) {
+    PackedAction packed = packAction(action);
+    for(uint32_t i = rootNode.firstEdge; i < rootNode.firstEdge + rootNode.numEdges; i++) {
+      if(arena->edges[i].action == packed) {
+        child = arena->edges[i].child.load();
+        break;
+      }
+    }
+  }
+  if(child == MCTS_NULL_NODE) {
+    reset();
+    return;
+  }
+  compact(child, 0);
+  rootHash = game.zobristHash();
+}
+
+void MCTS::stop() {
+  stopFlag.store(true, std::memory_order_relaxed);
+}
+
+size_t MCTS::memoryReserved() const {
+  size_t arenaSize = (size_t)arena->nodeCapacity * sizeof(MCTSNode) + (size_t)arena->edgeCapacity * sizeof(MCTSEdge);
+  return spareArena ? 2 * arenaSize : arenaSize;
+}
+
+int MCTS::numThreads() const {
+  return workers.size();
+}
+
+const MCTSArena& MCTS::getArena() const {
+  return *arena;
+}
+
+uint32_t MCTS::getRoot() const {
+  return root;
+}
+
+// Value of a finished game for the player to move.
+static float gameOverValue(Game& game) {
+  std::optional<Player> winner = game.winner();
+  return winner ? (*winner == game.currentPlayer ? 1 : -1) : 0;
+}
+
+/*
+ * Creates the edges of a node in the EXPANDING state and returns the value of the position for the
+ * player to move. If the arena is full the node goes back to UNEXPANDED and is only evaluated.
+ */
+float MCTS::expand(Worker& worker, uint32_t nodeIdx, Game& game) {
+  MCTSNode& node = arena->nodes[nodeIdx];
+  if(game.isGameOver()) {
+    node.terminalValue = gameOverValue(game);
+    node.state.store(MCTSNodeState::TERMINAL, std::memory_order_release);
+    return node.terminalValue;
+  }
+  worker.actions = game.generateLegalActions();
+  if(worker.actions.empty()) {
+    node.terminalValue = 0;
+    node.state.store(MCTSNodeState::TERMINAL, std::memory_order_release);
+    return 0;
+  }
+  float value = worker.evaluator->evaluate(game, worker.actions, worker.priors);
+  uint32_t firstEdge = arena->allocateEdges(worker.actions.size());
+  if(firstEdge == MCTS_NULL_NODE) {
+    arenaFull();
+    node.state.store(MCTSNodeState::UNEXPANDED, std::memory_order_release);
+    return value;
+  }
+  for(size_t i = 0; i < worker.actions.size(); i++) {
+    MCTSEdge& edge = arena->edges[firstEdge + i];
+    edge.action = packAction(worker.actions[i]);
+    edge.prior = worker.priors[i];
+    edge.child.store(MCTS_NULL_NODE, std::memory_order_relaxed);
+    edge.visits.store(0, std::memory_order_relaxed);
+  }
+  node.firstEdge = firstEdge;
+  node.numEdges = worker.actions.size();
+  node.state.store(MCTSNodeState::EXPANDED, std::memory_order_release);
+  return value;
+}
+
+/*
+ * PUCT: Q + cpuct * P * sqrt(N) / (1 + n). n counts the visits of the edge, Q is the value of the
+ * child node, which may include visits through other edges when transpositions are shared.
+ * Unvisited actions have Q = 0. Virtual losses count as visits with a value of -1.
+ */
+uint32_t MCTS::selectEdge(const MCTSNode& node) const {
+  uint32_t parentVisits = node.visits.load(std::memory_order_relaxed) + node.virtualLoss.load(std::memory_order_relaxed);
+  float sqrtVisits = std::sqrt((float)parentVisits);
+  float bestScore = -INFINITY;
+  uint32_t best = node.firstEdge;
+  for(uint32_t i = node.firstEdge; i < node.firstEdge + node.numEdges; i++) {
+    const MCTSEdge& edge = arena->edges[i];
+    float q = 0;
+    uint32_t edgeVisits = edge.visits.load(std::memory_order_relaxed);
+    uint32_t childIdx = edge.child.load(std::memory_order_acquire);
+    if(childIdx != MCTS_NULL_NODE) {
+      const MCTSNode& child = arena->nodes[childIdx];
+      uint32_t loss = child.virtualLoss.load(std::memory_order_relaxed) * virtualLoss;
+      uint32_t childVisits = child.visits.load(std::memory_order_relaxed) + loss;
+      if(childVisits > 0) {
+        q = ((float)child.valueSum.load(std::memory_order_relaxed) / MCTS_VALUE_SCALE - loss) / childVisits;
+      }
+      edgeVisits += loss;
+    }
+    float score = q + cpuct * edge.prior * sqrtVisits / (1 + edgeVisits);
+    if(score > bestScore) {
+      bestScore = score;
+      best = i;
+    }
+  }
+  return best;
+}
+
+void MCTS::revert(Worker& worker, Game& game) {
+  for(uint32_t nodeIdx: worker.path) {
+    arena->nodes[nodeIdx].virtualLoss.fetch_sub(1, std::memory_order_relaxed);
+  }
+  while(!worker.undoStack.empty()) {
+    game.undoAction(worker.undoStack.back());
+    worker.undoStack.pop_back();
+  }
+}
+
+bool MCTS::simulate(Worker& worker, Game& game) {
+  worker.path.clear();
+  worker.edgePath.clear();
+  worker.undoStack.clear();
+  uint32_t nodeIdx = root;
+  float value;
+  while(true) {
+    MCTSNode& node = arena->nodes[nodeIdx];
+    node.virtualLoss.fetch_add(1, std::memory_order_relaxed);
+    worker.path.push_back(nodeIdx);
+    MCTSNodeState state = node.state.load(std::memory_order_acquire);
+    if(state == MCTSNodeState::UNEXPANDED) {
+      if(node.state.compare_exchange_strong(state, MCTSNodeState::EXPANDING, std::memory_order_acquire)) {
+        value = expand(worker, nodeIdx, game);
+        break;
+      }
+      // Lost the race, state now holds what the other thread made of the node.
+    }
+    if(state == MCTSNodeState::TERMINAL) {
+      value = node.terminalValue;
+      break;
+    }
+    if(state != MCTSNodeState::EXPANDED) {
+      // Another thread is expanding this node.
+      revert(worker, game);
+      worker.collisions++;
+      return false;
+    }
+    uint32_t edgeIdx = selectEdge(node);
+    MCTSEdge& edge = arena->edges[edgeIdx];
+    worker.edgePath.push_back(edgeIdx);
+    worker.undoStack.push_back(game.makeAction(unpackAction(edge.action)));
+    uint32_t child = edge.child.load(std::memory_order_acquire);
+    if(child == MCTS_NULL_NODE) {
+      uint32_t newChild = useTranspositions ? findOrCreateNode(tableKey(game.zobristHash())) : arena->allocateNode();
+      if(newChild == MCTS_NULL_NODE) {
+        // Arena is full, evaluate without growing the tree.
+        arenaFull();
+        if(game.isGameOver()) {
+          value = gameOverValue(game);
+        } else {
+          worker.actions = game.generateLegalActions();
+          value = worker.actions.empty() ? 0 : worker.evaluator->evaluate(game, worker.actions, worker.priors);
+        }
+        value = -value;
+        break;
+      }
+      // If another thread was faster its node is used and newChild stays unreachable.
+      if(edge.child.compare_exchange_strong(child, newChild, std::memory_order_acq_rel)) {
+        child = newChild;
+      }
+    }
+    if(useTranspositions && std::find(worker.path.begin(), worker.path.end(), child) != worker.path.end()) {
+      // The action leads back to a position on the path, score the cycle as a draw.
+      value = 0;
+      break;
+    }
+    nodeIdx = child;
+  }
+
+  // value is for the player to move at the last node of the path, nodes store values for the
+  // player that moved into them.
+  for(size_t i = worker.path.size(); i-- > 0;) {
+    value = -value;
+    MCTSNode& node = arena->nodes[worker.path[i]];
+    node.valueSum.fetch_add((int64_t)(value * MCTS_VALUE_SCALE), std::memory_order_relaxed);
+    node.visits.fetch_add(1, std::memory_order_relaxed);
+    node.virtualLoss.fetch_sub(1, std::memory_order_relaxed);
+  }
+  for(uint32_t edgeIdx: worker.edgePath) {
+    arena->edges[edgeIdx].visits.fetch_add(1, std::memory_order_relaxed);
+  }
+  worker.path.clear();
+  revert(worker, game);
+  worker.simulations++;
+  return true;
+}
+
+void MCTS::run(Worker& worker, Game& game, const MCTSLimits& limits, std::chrono::steady_clock::time_point deadline) {
+  uint64_t count = 0;
+  while(!stopFlag.load(std::memory_order_relaxed)) {
+    if(collectionRequested.load(std::memory_order_relaxed)) {
+      pauseForCollection();
+    }
+    uint64_t started = startedSimulations.fetch_add(1, std::memory_order_relaxed);
+    if(limits.visits != 0 && started >= limits.visits) break;
+    while(!simulate(worker, game)) {
+      std::this_thread::yield();
+    }
+    count++;
+    if(arena->nodes[root].state.load(std::memory_order_acquire) == MCTSNodeState::TERMINAL) break;
+    if(limits.moveTime != 0 && (count & 15) == 0 && std::chrono::steady_clock::now() >= deadline) break;
+    if(limits.visits == 0 && limits.moveTime == 0) break;
+  }
+  stopFlag.store(true, std::memory_order_relaxed);
+  leaveCollection();
+}
+
+MCTSResult MCTS::search(Game& game, const MCTSLimits& limits) {
+  if(book != nullptr) {
+    std::optional<PlayerAction> bookAction = book->bestAction(game);
+    if(bookAction) {
+      MCTSResult result;
+      result.bestAction = bookAction.value();
+      result.fromBook = true;
+      return result;
+    }
+  }
+  auto startTime = std::chrono::steady_clock::now();
+  auto deadline = startTime + std::chrono::milliseconds(limits.moveTime);
+  long int hash = game.zobristHash();
+  if(root == MCTS_NULL_NODE || hash != rootHash || useTranspositions != (bool)table) {
+    arena->clear();
+    if(useTranspositions) {
+      clearTable();
+      root = findOrCreateNode(tableKey(hash));
+    } else {
+      table.reset();
+      root = arena->allocateNode();
+      arena->nodes[root].key = tableKey(hash);
+    }
+    rootHash = hash;
+  }
+  uint32_t reusedVisits = arena->nodes[root].visits;
+  stopFlag = false;
+  startedSimulations = 0;
+  collectionRequested = false;
+  activeWorkers = workers.size();
+  pausedWorkers = 0;
+  collections = 0;
+  prunedNodes = 0;
+  for(Worker& worker: workers) {
+    worker.collisions = 0;
+    worker.simulations = 0;
+  }
+
+  std::vector<Game> replicas;
+  replicas.reserve(workers.size() - 1);
+  for(size_t i = 1; i < workers.size(); i++) {
+    replicas.emplace_back(game);
+  }
+  std::vector<std::thread> threads;
+  for(size_t i = 1; i < workers.size(); i++) {
+    threads.emplace_back(&MCTS::run, this, std::ref(workers[i]), std::ref(replicas[i - 1]), std::cref(limits), deadline);
+  }
+  run(workers[0], game, limits, deadline);
+  for(std::thread& t: threads) {
+    t.join();
+  }
+
+  MCTSResult result;
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+  const MCTSNode& rootNode = arena->nodes[root];
+  for(const Worker& worker: workers) {
+    result.visits += worker.simulations;
+  }
+  result.reusedVisits = reusedVisits;
+  result.collections = collections;
+  result.prunedNodes = prunedNodes;
+  result.pruneRate = seconds > 0 ? prunedNodes / seconds : 0;
+  result.memoryUsage = arena->memoryUsage();
+  result.memoryReserved = memoryReserved();
+  result.visitsPerSecond = seconds > 0 ? result.visits / seconds : 0;
+  result.value = -rootNode.value();
+  for(const Worker& worker: workers) {
+    result.collisions += worker.collisions;
+  }
+  result.bestAction = PlayerAction(ACTION_SKIP, ACTION_SKIP, ActionType::SKIP);
+  if(rootNode.state.load() != MCTSNodeState::EXPANDED) return result;
+  uint32_t bestVisits = 0;
+  for(uint32_t i = rootNode.firstEdge; i < rootNode.firstEdge + rootNode.numEdges; i++) {
+    const MCTSEdge& edge = arena->edges[i];
+    uint32_t visits = edge.visits.load();
+    result.rootActions.push_back(unpackAction(edge.action));
+    result.rootVisits.push_back(visits);
+    if(i == rootNode.firstEdge || visits > bestVisits) {
+      bestVisits = visits;
+      result.bestAction = result.rootActions.back();
+    }
+  }
+  return result;
+}
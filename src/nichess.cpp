@@ -1,4 +1,5 @@
 #include "nichess/nichess.hpp"
+#include "nichess/boardstring.hpp"
 #include "nichess/util.hpp"
 #include "nichess/zobrist.hpp"
 
@@ -26,6 +27,29 @@ PlayerAction::PlayerAction() { }
 
 PlayerAction::PlayerAction(int srcIdx, int dstIdx, ActionType actionType): srcIdx(srcIdx), dstIdx(dstIdx), actionType(actionType) { }
 
+bool PlayerAction::operator==(const PlayerAction& other) const {
+  return srcIdx == other.srcIdx && dstIdx == other.dstIdx && actionType == other.actionType;
+}
+
+bool PlayerAction::operator!=(const PlayerAction& other) const {
+  return !(*this == other);
+}
+
+PackedAction nichess::packAction(const PlayerAction& action) {
+  if(action.actionType == ActionType::SKIP) {
+    return (PackedAction)((int)ActionType::SKIP << 12);
+  }
+  return (PackedAction)(action.srcIdx | (action.dstIdx << 6) | ((int)action.actionType << 12));
+}
+
+PlayerAction nichess::unpackAction(PackedAction packedAction) {
+  ActionType actionType = ActionType(packedAction >> 12);
+  if(actionType == ActionType::SKIP) {
+    return PlayerAction(ACTION_SKIP, ACTION_SKIP, ActionType::SKIP);
+  }
+  return PlayerAction(packedAction & 63, (packedAction >> 6) & 63, actionType);
+}
+
 Piece::Piece(): type(PieceType::NO_PIECE), healthPoints(0), squareIndex(0) { }
 
 Piece::Piece(PieceType type, int healthPoints, int squareIndex):
@@ -320,6 +344,7 @@ board[coordinatesToBoardIndex(5,0)] = new Piece(PieceType::P1_ASSASSIN, ASSASSIN
 
   playerToPieces[Player::PLAYER_2] = p2Pieces;
   playerToKing[Player::PLAYER_2] = p2Pieces[4];
+  resyncAll();
 
   long int zh = zobristHash();
   repetitions.insert({zh, 1});
@@ -369,10 +394,12 @@ Game::Game(const Game& other) {
   playerToPieces[Player::PLAYER_2] = p2Pieces;
   repetitions = other.repetitions;
   repetitionsDraw = other.repetitionsDraw;
+  resyncAll();
 }
 
 Game::Game(const std::string encodedBoard) {
   boardFromString(encodedBoard);
+  resyncAll();
   long int zh = zobristHash();
   repetitions.insert({zh, 1});
   repetitionsDraw = false;
@@ -396,6 +423,102 @@ Game::~Game() {
 }
 
 
+/*
+ * Brings syncedSquares[squareIndex] and everything that is updated incrementally up to date
+ * with board[squareIndex].
+ */
+void Game::syncSquare(int squareIndex) {
+  const Piece& before = syncedSquares[squareIndex];
+  const Piece* after = board[squareIndex];
+  if(before.type == after->type && before.healthPoints == after->healthPoints) return;
+  evalAccumulator.update(syncedSquares, squareIndex, *after);
+  for(size_t i = 0; i < squareObservers.size(); i++) {
+    squareObservers[i]->squareChanged(squareIndex, before, *after);
+  }
+  syncedSquares[squareIndex] = *after;
+}
+
+void Game::syncSquares(uint64_t squares) {
+  while(squares) {
+    syncSquare(__builtin_ctzll(squares));
+    squares &= squares - 1;
+  }
+}
+
+/*
+ * Recomputes incrementally updated state from scratch.
+ */
+void Game::resyncAll() {
+  evalAccumulator.clear();
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    syncedSquares[i] = Piece(PieceType::NO_PIECE, 0, i);
+  }
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    evalAccumulator.update(syncedSquares, i, *board[i]);
+    syncedSquares[i] = *board[i];
+  }
+  for(size_t i = 0; i < squareObservers.size(); i++) {
+    squareObservers[i]->refresh(*this);
+  }
+}
+
+/*
+ * Observer is refreshed immediately and then receives every square change.
+ */
+void Game::addSquareObserver(SquareObserver* observer) {
+  squareObservers.push_back(observer);
+  observer->refresh(*this);
+}
+
+void Game::removeSquareObserver(SquareObserver* observer) {
+  auto it = std::find(squareObservers.begin(), squareObservers.end(), observer);
+  if(it != squareObservers.end()) {
+    squareObservers.erase(it);
+  }
+}
+
+/*
+ * Squares whose piece or health points can be changed by the action.
+ * t1 is the action's UndoInfo.t1.
+ */
+static uint64_t actionChangedSquares(const PlayerAction& playerAction, int t1) {
+  if(playerAction.actionType == ActionType::SKIP) return 0;
+  int dstIdx = playerAction.dstIdx;
+  uint64_t squares = (1ULL << playerAction.srcIdx) | (1ULL << dstIdx);
+  const std::vector<int> *neighbors;
+  switch(playerAction.actionType) {
+    case ActionType::MOVE_CASTLE:
+      if(dstIdx == 6) {
+        squares |= (1ULL << 5) | (1ULL << 7);
+      } else if(dstIdx == 2) {
+        squares |= (1ULL << 3) | (1ULL << 0);
+      } else if(dstIdx == 62) {
+        squares |= (1ULL << 61) | (1ULL << 63);
+      } else {
+        squares |= (1ULL << 59) | (1ULL << 56);
+      }
+      break;
+    case ActionType::ABILITY_MAGE_DAMAGE:
+    case ActionType::ABILITY_WARRIOR_DAMAGE:
+    case ActionType::ABILITY_ASSASSIN_DAMAGE:
+      // leap
+      if(t1 != -1) squares |= 1ULL << t1;
+      break;
+    case ActionType::ABILITY_MAGE_THROW_ASSASSIN:
+    case ActionType::ABILITY_WARRIOR_THROW_WARRIOR:
+      // thrown piece and AOE damage
+      squares |= 1ULL << t1;
+      neighbors = &GameCache::squareToNeighboringSquares[dstIdx];
+      for(size_t i = 0; i < neighbors->size(); i++) {
+        squares |= 1ULL << (*neighbors)[i];
+      }
+      break;
+    default:
+      break;
+  }
+  return squares;
+}
+
 /*
  * Assumes the action is legal.
  */
@@ -684,6 +807,8 @@ UndoInfo Game::makeAction(PlayerAction playerAction) {
         break;
     }
   } 
+  undoInfo.changedSquares = actionChangedSquares(playerAction, undoInfo.t1);
+  syncSquares(undoInfo.changedSquares);
   this->moveNumber += 1;
   this->currentPlayer = ~currentPlayer;
 
@@ -923,6 +1048,7 @@ void Game::undoAction(UndoInfo undoInfo) {
     default:
       break;
   }
+  syncSquares(undoInfo.changedSquares);
   this->moveNumber -= 1;
   this->currentPlayer = ~currentPlayer;
 }
@@ -1804,6 +1930,17 @@ std::vector<PlayerAction> Game::legalActionsByPiece(Piece* piece) {
   }
 }
 
+std::vector<PlayerAction> Game::legalMovesByPiece(Piece* piece) {
+  return legalActionsByPiece(piece);
+}
+
+std::vector<PlayerAction> Game::legalMovesBySquare(int srcSquareIdx) {
+  if(isOffBoard(srcSquareIdx) || board[srcSquareIdx]->healthPoints <= 0) {
+    return std::vector<PlayerAction>();
+  }
+  return legalActionsByPiece(board[srcSquareIdx]);
+}
+
 std::vector<PlayerAction> Game::generateLegalActions() {
   std::vector<PlayerAction> retval;
   if(playerToKing[currentPlayer]->healthPoints <= 0) {
@@ -1861,9 +1998,244 @@ bool isActionValid(int srcIdx, int dstIdx) {
   return false;
 }
 
+/*
+ * Step between squares on the same row, column or diagonal, 0 if there is no such line.
+ */
+static int lineStep(int srcIdx, int dstIdx) {
+  int dx = dstIdx % NUM_COLUMNS - srcIdx % NUM_COLUMNS;
+  int dy = dstIdx / NUM_COLUMNS - srcIdx / NUM_COLUMNS;
+  if(dx != 0 && dy != 0 && std::abs(dx) != std::abs(dy)) return 0;
+  return ((dy > 0) - (dy < 0)) * NUM_COLUMNS + (dx > 0) - (dx < 0);
+}
+
+// First occupied square after from in steps of step, to if there is none before it.
+static int firstOccupied(Piece* const board[], int from, int to, int step) {
+  int s = from + step;
+  while(s != to && board[s]->type == PieceType::NO_PIECE) {
+    s += step;
+  }
+  return s;
+}
+
+/*
+ * Type of the action of a mage, warrior or assassin along the line from srcIdx to dstIdx. A throw
+ * needs an own piece of thrownType right next to the thrower and only empty squares behind it.
+ */
+static std::optional<ActionType> rayActionType(Piece* const board[], int srcIdx, int dstIdx, int step, ActionType damage,
+    PieceType thrownType, ActionType throwType) {
+  int blocker = firstOccupied(board, srcIdx, dstIdx, step);
+  if(blocker == dstIdx) {
+    return board[dstIdx]->type == PieceType::NO_PIECE ? ActionType::MOVE_REGULAR : damage;
+  }
+  if(thrownType == PieceType::NO_PIECE || blocker != srcIdx + step || board[blocker]->type != thrownType) {
+    return std::nullopt;
+  }
+  if(board[dstIdx]->type == PieceType::NO_PIECE || firstOccupied(board, blocker, dstIdx, step) != dstIdx) {
+    return std::nullopt;
+  }
+  return throwType;
+}
+
+static bool contains(const std::vector<int>& squares, int squareIndex) {
+  return std::find(squares.begin(), squares.end(), squareIndex) != squares.end();
+}
+
+std::optional<ActionType> Game::legalActionType(int srcIdx, int dstIdx) {
+  if(isOffBoard(srcIdx) || isOffBoard(dstIdx) || srcIdx == dstIdx) return std::nullopt;
+  if(playerToKing[currentPlayer]->healthPoints <= 0) return std::nullopt;
+  PieceType type = board[srcIdx]->type;
+  if(!pieceBelongsToPlayer(type, currentPlayer) || board[srcIdx]->healthPoints <= 0) return std::nullopt;
+  Piece* dstPiece = board[dstIdx];
+  bool empty = dstPiece->type == PieceType::NO_PIECE;
+  if(!empty && !pieceBelongsToPlayer(dstPiece->type, ~currentPlayer)) return std::nullopt;
+
+  int dx = std::abs(dstIdx % NUM_COLUMNS - srcIdx % NUM_COLUMNS);
+  int dy = std::abs(dstIdx / NUM_COLUMNS - srcIdx / NUM_COLUMNS);
+  int step = lineStep(srcIdx, dstIdx);
+  bool diagonal = dx == dy;
+  switch(type) {
+    case P1_KING:
+    case P2_KING:
+      if(dx <= 1 && dy <= 1) {
+        return empty ? ActionType::MOVE_REGULAR : ActionType::ABILITY_KING_DAMAGE;
+      }
+      if(empty && dy == 0 && dx == 2) {
+        int row = type == P1_KING ? 0 : NUM_SQUARES - NUM_COLUMNS;
+        PieceType warrior = type == P1_KING ? P1_WARRIOR : P2_WARRIOR;
+        if(srcIdx != row + 4) return std::nullopt;
+        if(dstIdx == row + 6 && board[row + 5]->type == NO_PIECE && board[row + 7]->type == warrior) {
+          return ActionType::MOVE_CASTLE;
+        }
+        if(dstIdx == row + 2 && board[row + 3]->type == NO_PIECE && board[row + 1]->type == NO_PIECE && board[row]->type == warrior) {
+          return ActionType::MOVE_CASTLE;
+        }
+      }
+      return std::nullopt;
+    case P1_KNIGHT:
+    case P2_KNIGHT:
+      if((dx == 1 && dy == 2) || (dx == 2 && dy == 1)) {
+        return empty ? ActionType::MOVE_REGULAR : ActionType::ABILITY_KNIGHT_DAMAGE;
+      }
+      return std::nullopt;
+    case P1_PAWN:
+      if(empty && contains(GameCache::squareToP1PawnMoveSquares[srcIdx], dstIdx)) {
+        if(dstIdx >= NUM_SQUARES - NUM_COLUMNS) return ActionType::MOVE_PROMOTE_P1_PAWN;
+        if(dstIdx - srcIdx == 2 * NUM_COLUMNS && board[srcIdx + NUM_COLUMNS]->type != NO_PIECE) return std::nullopt;
+        return ActionType::MOVE_REGULAR;
+      }
+      if(!empty && contains(GameCache::squareToP1PawnAbilitySquares[srcIdx], dstIdx)) {
+        if(dstIdx >= NUM_SQUARES - NUM_COLUMNS && PAWN_ABILITY_POINTS >= dstPiece->healthPoints) {
+          return ActionType::ABILITY_P1_PAWN_DAMAGE_AND_PROMOTION;
+        }
+        return ActionType::ABILITY_PAWN_DAMAGE;
+      }
+      return std::nullopt;
+    case P2_PAWN:
+      if(empty && contains(GameCache::squareToP2PawnMoveSquares[srcIdx], dstIdx)) {
+        if(dstIdx < NUM_COLUMNS) return ActionType::MOVE_PROMOTE_P2_PAWN;
+        if(srcIdx - dstIdx == 2 * NUM_COLUMNS && board[srcIdx - NUM_COLUMNS]->type != NO_PIECE) return std::nullopt;
+        return ActionType::MOVE_REGULAR;
+      }
+      if(!empty && contains(GameCache::squareToP2PawnAbilitySquares[srcIdx], dstIdx)) {
+        if(dstIdx < NUM_COLUMNS && PAWN_ABILITY_POINTS >= dstPiece->healthPoints) {
+          return ActionType::ABILITY_P2_PAWN_DAMAGE_AND_PROMOTION;
+        }
+        return ActionType::ABILITY_PAWN_DAMAGE;
+      }
+      return std::nullopt;
+    case P1_MAGE:
+    case P2_MAGE:
+      if(step == 0) return std::nullopt;
+      return rayActionType(board, srcIdx, dstIdx, step, ActionType::ABILITY_MAGE_DAMAGE,
+          diagonal ? (type == P1_MAGE ? P1_ASSASSIN : P2_ASSASSIN) : NO_PIECE, ActionType::ABILITY_MAGE_THROW_ASSASSIN);
+    case P1_WARRIOR:
+    case P2_WARRIOR:
+      if(step == 0 || diagonal) return std::nullopt;
+      return rayActionType(board, srcIdx, dstIdx, step, ActionType::ABILITY_WARRIOR_DAMAGE,
+          type == P1_WARRIOR ? P1_WARRIOR : P2_WARRIOR, ActionType::ABILITY_WARRIOR_THROW_WARRIOR);
+    case P1_ASSASSIN:
+    case P2_ASSASSIN:
+      if(!diagonal) {
+        if(dx + dy != 1) return std::nullopt;
+        return empty ? ActionType::MOVE_REGULAR : ActionType::ABILITY_ASSASSIN_DAMAGE;
+      }
+      return rayActionType(board, srcIdx, dstIdx, step, ActionType::ABILITY_ASSASSIN_DAMAGE, NO_PIECE, ActionType::SKIP);
+    default:
+      return std::nullopt;
+  }
+}
+
 bool Game::isActionLegal(int srcIdx, int dstIdx) {
-  // TODO
-  return false;
+  return legalActionType(srcIdx, dstIdx).has_value();
+}
+
+bool Game::isActionLegal(const PlayerAction& action) {
+  std::optional<ActionType> actionType = legalActionType(action.srcIdx, action.dstIdx);
+  return actionType && *actionType == action.actionType;
+}
+
+/*
+ * isActionLegal over a batch of games, e.g. the moves a game server received from its clients.
+ */
+void nichess::validateActions(Game* const games[], const PlayerAction actions[], size_t count, bool legal[]) {
+  for(size_t i = 0; i < count; i++) {
+    // Games are usually scattered over the heap, start loading the next boards early.
+    if(i + 2 < count) {
+      __builtin_prefetch(&games[i + 2]->board[actions[i + 2].srcIdx & (NUM_SQUARES - 1)]);
+    }
+    legal[i] = games[i]->isActionLegal(actions[i]);
+  }
+}
+
+/*
+ * The throw that lands on target: walking away from target, only empty squares up to a thrown
+ * piece of the attacker, with the thrower right behind it. Mages throw assassins diagonally and
+ * warriors throw warriors orthogonally.
+ */
+static int throwsAt(Piece* const board[], int target, PieceType thrower, PieceType thrown, const Direction directions[]) {
+  int count = 0;
+  for(int k = 0; k < 4; k++) {
+    const std::vector<int>& line = GameCache::squareToDirectionToLine[target][directions[k]];
+    for(size_t i = 0; i < line.size(); i++) {
+      PieceType type = board[line[i]]->type;
+      if(type == PieceType::NO_PIECE) continue;
+      if(type == thrown && i + 1 < line.size() && board[line[i + 1]]->type == thrower) count++;
+      break;
+    }
+  }
+  return count;
+}
+
+/*
+ * Reverse lookup from the king's square, every enemy piece type is only looked for on the squares
+ * it could hit the king from. Throws also hit the king when they land next to it.
+ */
+static int countKingThreats(Game& game, Player player, bool stopAtFirst) {
+  Piece* king = game.playerToKing[player];
+  if(king->healthPoints <= 0) return 0;
+  Piece* const* board = game.board;
+  int offset = player == PLAYER_1 ? P2_KING - P1_KING : 0;
+  PieceType enemyKing = (PieceType)(P1_KING + offset);
+  PieceType enemyMage = (PieceType)(P1_MAGE + offset);
+  PieceType enemyWarrior = (PieceType)(P1_WARRIOR + offset);
+  PieceType enemyAssassin = (PieceType)(P1_ASSASSIN + offset);
+  PieceType enemyKnight = (PieceType)(P1_KNIGHT + offset);
+  PieceType enemyPawn = (PieceType)(P1_PAWN + offset);
+  int kingSquare = king->squareIndex;
+  int count = 0;
+
+  for(int s: GameCache::squareToNeighboringSquares[kingSquare]) {
+    if(board[s]->type == enemyKing) count++;
+  }
+  for(int s: GameCache::squareToKnightActionSquares[kingSquare]) {
+    if(board[s]->type == enemyKnight) count++;
+  }
+  // A pawn hits the squares from which a pawn of the other player would hit it.
+  const std::vector<int>& pawnSquares = player == PLAYER_1 ? GameCache::squareToP1PawnAbilitySquares[kingSquare] : GameCache::squareToP2PawnAbilitySquares[kingSquare];
+  for(int s: pawnSquares) {
+    if(board[s]->type == enemyPawn) count++;
+  }
+  for(int s: GameCache::squareToNeighboringNonDiagonalSquares[kingSquare]) {
+    if(board[s]->type == enemyAssassin) count++;
+  }
+  if(stopAtFirst && count > 0) return count;
+
+  // Mages in all directions, assassins diagonally and warriors orthogonally, up to the first piece.
+  for(int d = 0; d < NUM_DIRECTIONS_WITHOUT_INVALID; d++) {
+    const std::vector<int>& line = GameCache::squareToDirectionToLine[kingSquare][d];
+    for(size_t i = 0; i < line.size(); i++) {
+      PieceType type = board[line[i]]->type;
+      if(type == PieceType::NO_PIECE) continue;
+      bool diagonal = d % 2 == 1;
+      if(type == enemyMage) {
+        count++;
+      } else if(diagonal && type == enemyAssassin) {
+        count++;
+      } else if(!diagonal && type == enemyWarrior) {
+        count++;
+      }
+      break;
+    }
+  }
+  if(stopAtFirst && count > 0) return count;
+
+  count += throwsAt(board, kingSquare, enemyMage, enemyAssassin, DIAGONAL_DIRECTIONS);
+  count += throwsAt(board, kingSquare, enemyWarrior, enemyWarrior, NON_DIAGONAL_DIRECTIONS);
+  for(int s: GameCache::squareToNeighboringSquares[kingSquare]) {
+    if(stopAtFirst && count > 0) return count;
+    if(!pieceBelongsToPlayer(board[s]->type, player)) continue;
+    count += throwsAt(board, s, enemyMage, enemyAssassin, DIAGONAL_DIRECTIONS);
+    count += throwsAt(board, s, enemyWarrior, enemyWarrior, NON_DIAGONAL_DIRECTIONS);
+  }
+  return count;
+}
+
+bool Game::isKingThreatened(Player player) {
+  return countKingThreats(*this, player, true) > 0;
+}
+
+int Game::kingThreatCount(Player player) {
+  return countKingThreats(*this, player, false);
 }
 
 Player Game::getCurrentPlayer() {
@@ -1908,131 +2280,100 @@ std::optional<Player> Game::winner() {
 }
 
 std::string Game::boardToString() {
-  std::stringstream retval;
-  retval << currentPlayer << "|";
-  Piece* currentPiece;
-  for(int i = 0; i < NUM_SQUARES; i++) {
-    currentPiece = board[i];
-    if(currentPiece->type == NO_PIECE) {
-      retval << "empty,";
-    } else {
-      switch(currentPiece->type) {
-        case P1_KING:
-          retval << "0-king-";
-          break;
-        case P1_MAGE:
-          retval << "0-mage-";
-          break;
-        case P1_PAWN:
-          retval << "0-pawn-";
-          break;
-        case P1_WARRIOR:
-          retval << "0-warrior-";
-          break;
-        case P1_ASSASSIN:
-          retval << "0-assassin-";
-          break;
-        case P1_KNIGHT:
-          retval << "0-knight-";
-          break;
-        case P2_KING:
-          retval << "1-king-";
-          break;
-        case P2_MAGE:
-          retval << "1-mage-";
-          break;
-        case P2_PAWN:
-          retval << "1-pawn-";
-          break;
-        case P2_WARRIOR:
-          retval << "1-warrior-";
-          break;
-        case P2_ASSASSIN:
-          retval << "1-assassin-";
-          break;
-        case P2_KNIGHT:
-          retval << "1-knight-";
-          break;
-      }        
-      retval << currentPiece->healthPoints << ",";
-    }
-  }
-  return retval.str();
+  char buffer[MAX_BOARD_STRING_SIZE];
+  std::to_chars_result result = writeBoard(buffer, buffer + MAX_BOARD_STRING_SIZE, *this);
+  return std::string(buffer, result.ptr);
 }
 
 void Game::boardFromString(std::string encodedBoard) {
-  currentPlayer = (Player)(std::stoi(encodedBoard.substr(0, encodedBoard.find("|"))));
+  Piece squares[NUM_SQUARES];
+  Player player;
+  std::from_chars_result result = parseBoard(encodedBoard.data(), encodedBoard.data() + encodedBoard.size(), squares, player);
+  if(result.ec != std::errc()) {
+    throw std::runtime_error("boardFromString: invalid board");
+  }
+  currentPlayer = player;
   moveNumber = 0;
   std::vector<Piece*> p1Pieces;
   std::vector<Piece*> p2Pieces;
-
-  std::string b1 = encodedBoard.substr(2);
-  std::string delimiter1 = ",";
-  std::string delimiter2 = "-";
-  std::string token1;
-  std::string s, tmp;
-  size_t pos = 0;
-  int boardIdx = 0;
-  while((pos = b1.find(delimiter1)) != std::string::npos) {
-    token1 = b1.substr(0, pos);
-    if(token1 == "empty") {
-      board[boardIdx] = new Piece(PieceType::NO_PIECE, 0, boardIdx);
+  for(int boardIdx = 0; boardIdx < NUM_SQUARES; boardIdx++) {
+    PieceType type = squares[boardIdx].type;
+    board[boardIdx] = new Piece(type, squares[boardIdx].healthPoints, boardIdx);
+    if(type == PieceType::NO_PIECE) continue;
+    if(type < PieceType::P2_KING) {
+      p1Pieces.push_back(board[boardIdx]);
     } else {
-      std::stringstream ss(token1);
-      std::vector<std::string> words;
-      while(std::getline(ss, tmp, '-')) {
-        words.push_back(tmp);
-      }
-      int healthPoints = std::stoi(words[2]);
-      s = words[0] + words[1];
-      if(s == "0king") {
-        board[boardIdx] = new Piece(PieceType::P1_KING, healthPoints, boardIdx);
-        p1Pieces.push_back(board[boardIdx]);
-        playerToKing[PLAYER_1] = board[boardIdx];
-      } else if(s == "0pawn") {
-        board[boardIdx] = new Piece(PieceType::P1_PAWN, healthPoints, boardIdx);
-        p1Pieces.push_back(board[boardIdx]);
-      } else if(s == "0mage") {
-        board[boardIdx] = new Piece(PieceType::P1_MAGE, healthPoints, boardIdx);
-        p1Pieces.push_back(board[boardIdx]);
-      } else if(s == "0assassin") {
-        board[boardIdx] = new Piece(PieceType::P1_ASSASSIN, healthPoints, boardIdx);
-        p1Pieces.push_back(board[boardIdx]);
-      } else if(s == "0knight") {
-        board[boardIdx] = new Piece(PieceType::P1_KNIGHT, healthPoints, boardIdx);
-        p1Pieces.push_back(board[boardIdx]);
-      } else if(s == "0warrior") {
-        board[boardIdx] = new Piece(PieceType::P1_WARRIOR, healthPoints, boardIdx);
-        p1Pieces.push_back(board[boardIdx]);
-      } else if(s == "1king") {
-        board[boardIdx] = new Piece(PieceType::P2_KING, healthPoints, boardIdx);
-        p2Pieces.push_back(board[boardIdx]);
-        playerToKing[PLAYER_2] = board[boardIdx];
-      } else if(s == "1pawn") {
-        board[boardIdx] = new Piece(PieceType::P2_PAWN, healthPoints, boardIdx);
-        p2Pieces.push_back(board[boardIdx]);
-      } else if(s == "1mage") {
-        board[boardIdx] = new Piece(PieceType::P2_MAGE, healthPoints, boardIdx);
-        p2Pieces.push_back(board[boardIdx]);
-      } else if(s == "1assassin") {
-        board[boardIdx] = new Piece(PieceType::P2_ASSASSIN, healthPoints, boardIdx);
-        p2Pieces.push_back(board[boardIdx]);
-      } else if(s == "1knight") {
-        board[boardIdx] = new Piece(PieceType::P2_KNIGHT, healthPoints, boardIdx);
-        p2Pieces.push_back(board[boardIdx]);
-      } else if(s == "1warrior") {
-        board[boardIdx] = new Piece(PieceType::P2_WARRIOR, healthPoints, boardIdx);
-        p2Pieces.push_back(board[boardIdx]);
-      }
+      p2Pieces.push_back(board[boardIdx]);
     }
-    b1.erase(0, pos + delimiter1.length());
-    boardIdx += 1;
+    if(type == PieceType::P1_KING) playerToKing[PLAYER_1] = board[boardIdx];
+    if(type == PieceType::P2_KING) playerToKing[PLAYER_2] = board[boardIdx];
   }
 
   playerToPieces[PLAYER_1] = p1Pieces;
   playerToPieces[PLAYER_2] = p2Pieces;
 }
 
+void Game::setPieces(const std::vector<Piece>& pieces, Player player) {
+  Piece squares[NUM_SQUARES];
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    squares[i] = Piece(PieceType::NO_PIECE, 0, i);
+  }
+  for(const Piece& p: pieces) {
+    if(p.type == PieceType::NO_PIECE || p.healthPoints <= 0 || p.squareIndex < 0 || p.squareIndex >= NUM_SQUARES) {
+      throw std::runtime_error("setPieces: invalid piece");
+    }
+    if(squares[p.squareIndex].type != PieceType::NO_PIECE) {
+      throw std::runtime_error("setPieces: two pieces on one square");
+    }
+    squares[p.squareIndex] = p;
+  }
+  setPosition(squares, player, 0);
+}
+
+void Game::setPosition(const Piece squares[], Player player, int startMoveNumber) {
+  int kings[NUM_PLAYERS] = {0, 0};
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    PieceType type = squares[i].type;
+    if(type < PieceType::P1_KING || type > PieceType::NO_PIECE || (type != PieceType::NO_PIECE && squares[i].healthPoints <= 0)) {
+      throw std::runtime_error("setPosition: invalid piece");
+    }
+    if(type == PieceType::P1_KING) kings[PLAYER_1]++;
+    if(type == PieceType::P2_KING) kings[PLAYER_2]++;
+  }
+  if(kings[PLAYER_1] != 1 || kings[PLAYER_2] != 1) {
+    throw std::runtime_error("setPosition: each player needs exactly one king");
+  }
+
+  // Dead pieces are no longer on the board and owned by playerToPieces.
+  for(int i = 0; i < NUM_PLAYERS; i++) {
+    for(Piece* p: playerToPieces[i]) {
+      if(p->healthPoints <= 0) delete p;
+    }
+    playerToPieces[i].clear();
+  }
+  uint64_t changed = 0;
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    Piece* boardPiece = board[i];
+    boardPiece->type = squares[i].type;
+    boardPiece->healthPoints = boardPiece->type == PieceType::NO_PIECE ? 0 : squares[i].healthPoints;
+    boardPiece->squareIndex = i;
+    if(boardPiece->type != syncedSquares[i].type || boardPiece->healthPoints != syncedSquares[i].healthPoints) changed |= 1ULL << i;
+    if(boardPiece->type == PieceType::NO_PIECE) continue;
+    Player owner = boardPiece->type < PieceType::P2_KING ? PLAYER_1 : PLAYER_2;
+    playerToPieces[owner].push_back(boardPiece);
+    if(boardPiece->type == PieceType::P1_KING || boardPiece->type == PieceType::P2_KING) {
+      playerToKing[owner] = boardPiece;
+    }
+  }
+  currentPlayer = player;
+  moveNumber = startMoveNumber;
+  // Cheaper than resyncAll when positions set one after another are alike.
+  syncSquares(changed);
+  repetitions.clear();
+  repetitions.insert({zobristHash(), 1});
+  repetitionsDraw = false;
+}
+
 std::vector<Piece*> Game::getAllPiecesByPlayer(Player player) {
   return playerToPieces[player];
 }
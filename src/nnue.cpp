@@ -0,0 +1,338 @@
+#include "nichess/nnue.hpp"
+
+#include <immintrin.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+using namespace nichess;
+
+const size_t NNUE_HEADER_SIZE = 64;
+
+class NNUEHeader {
+  public:
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numFeatures;
+    uint32_t hiddenSize;
+    int32_t outputBias;
+};
+
+/*
+ * Kernels. All of them work on NNUE_HIDDEN_SIZE values.
+ * Clipped accumulator values are at most NNUE_CLIP so the int32 dot product of both halves
+ * can't overflow.
+ */
+
+static void addScalar(int16_t* acc, const int16_t* column) {
+  for(int i = 0; i < NNUE_HIDDEN_SIZE; i++) {
+    acc[i] += column[i];
+  }
+}
+
+static void subScalar(int16_t* acc, const int16_t* column) {
+  for(int i = 0; i < NNUE_HIDDEN_SIZE; i++) {
+    acc[i] -= column[i];
+  }
+}
+
+static int32_t dotScalar(const int16_t* acc, const int16_t* weights) {
+  int32_t sum = 0;
+  for(int i = 0; i < NNUE_HIDDEN_SIZE; i++) {
+    int32_t v = acc[i] < 0 ? 0 : (acc[i] > NNUE_CLIP ? NNUE_CLIP : acc[i]);
+    sum += v * weights[i];
+  }
+  return sum;
+}
+
+__attribute__((target("avx2")))
+static void addAvx2(int16_t* acc, const int16_t* column) {
+  for(int i = 0; i < NNUE_HIDDEN_SIZE; i += 16) {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(acc + i));
+    __m256i c = _mm256_loadu_si256((const __m256i*)(column + i));
+    _mm256_storeu_si256((__m256i*)(acc + i), _mm256_add_epi16(a, c));
+  }
+}
+
+__attribute__((target("avx2")))
+static void subAvx2(int16_t* acc, const int16_t* column) {
+  for(int i = 0; i < NNUE_HIDDEN_SIZE; i += 16) {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(acc + i));
+    __m256i c = _mm256_loadu_si256((const __m256i*)(column + i));
+    _mm256_storeu_si256((__m256i*)(acc + i), _mm256_sub_epi16(a, c));
+  }
+}
+
+__attribute__((target("avx2")))
+static int32_t dotAvx2(const int16_t* acc, const int16_t* weights) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i clip = _mm256_set1_epi16(NNUE_CLIP);
+  __m256i sum = _mm256_setzero_si256();
+  for(int i = 0; i < NNUE_HIDDEN_SIZE; i += 16) {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(acc + i));
+    a = _mm256_min_epi16(_mm256_max_epi16(a, zero), clip);
+    __m256i w = _mm256_loadu_si256((const __m256i*)(weights + i));
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a, w));
+  }
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+  return _mm_cvtsi128_si32(s);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void addAvx512(int16_t* acc, const int16_t* column) {
+  for(int i = 0; i < NNUE_HIDDEN_SIZE; i += 32) {
+    __m512i a = _mm512_loadu_si512((const void*)(acc + i));
+    __m512i c = _mm512_loadu_si512((const void*)(column + i));
+    _mm512_storeu_si512((void*)(acc + i), _mm512_add_epi16(a, c));
+  }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void subAvx512(int16_t* acc, const int16_t* column) {
+  for(int i = 0; i < NNUE_HIDDEN_SIZE; i += 32) {
+    __m512i a = _mm512_loadu_si512((const void*)(acc + i));
+    __m512i c = _mm512_loadu_si512((const void*)(column + i));
+    _mm512_storeu_si512((void*)(acc + i), _mm512_sub_epi16(a, c));
+  }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static int32_t dotAvx512(const int16_t* acc, const int16_t* weights) {
+  const __m512i zero = _mm512_setzero_si512();
+  const __m512i clip = _mm512_set1_epi16(NNUE_CLIP);
+  __m512i sum = _mm512_setzero_si512();
+  for(int i = 0; i < NNUE_HIDDEN_SIZE; i += 32) {
+    __m512i a = _mm512_loadu_si512((const void*)(acc + i));
+    a = _mm512_min_epi16(_mm512_max_epi16(a, zero), clip);
+    __m512i w = _mm512_loadu_si512((const void*)(weights + i));
+    sum = _mm512_add_epi32(sum, _mm512_madd_epi16(a, w));
+  }
+  // Halved down to 128 bits like in dotAvx2. The zero masked extracts keep GCC from warning about
+  // the undefined vectors used by _mm512_reduce_add_epi32 and the unmasked extracts.
+  __m256i half = _mm256_add_epi32(_mm512_maskz_extracti64x4_epi64(0xFF, sum, 0), _mm512_maskz_extracti64x4_epi64(0xFF, sum, 1));
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(half), _mm256_extracti128_si256(half, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+  return _mm_cvtsi128_si32(s);
+}
+
+static void (*addColumn)(int16_t*, const int16_t*) = addScalar;
+static void (*subColumn)(int16_t*, const int16_t*) = subScalar;
+static int32_t (*dotClipped)(const int16_t*, const int16_t*) = dotScalar;
+static NNUEKernel currentKernel = NNUEKernel::SCALAR;
+
+bool nichess::isNNUEKernelSupported(NNUEKernel kernel) {
+  switch(kernel) {
+    case NNUEKernel::SCALAR:
+      return true;
+    case NNUEKernel::AVX2:
+      return __builtin_cpu_supports("avx2");
+    case NNUEKernel::AVX512:
+      return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+  }
+  return false;
+}
+
+bool nichess::setNNUEKernel(NNUEKernel kernel) {
+  if(!isNNUEKernelSupported(kernel)) return false;
+  switch(kernel) {
+    case NNUEKernel::SCALAR:
+      addColumn = addScalar;
+      subColumn = subScalar;
+      dotClipped = dotScalar;
+      break;
+    case NNUEKernel::AVX2:
+      addColumn = addAvx2;
+      subColumn = subAvx2;
+      dotClipped = dotAvx2;
+      break;
+    case NNUEKernel::AVX512:
+      addColumn = addAvx512;
+      subColumn = subAvx512;
+      dotClipped = dotAvx512;
+      break;
+  }
+  currentKernel = kernel;
+  return true;
+}
+
+NNUEKernel nichess::getNNUEKernel() {
+  return currentKernel;
+}
+
+static bool selectBestKernel() {
+  return setNNUEKernel(NNUEKernel::AVX512) || setNNUEKernel(NNUEKernel::AVX2) || setNNUEKernel(NNUEKernel::SCALAR);
+}
+
+static const bool kernelSelected = selectBestKernel();
+
+int nichess::nnueFeatureIndex(PieceType pt, int squareIndex, int healthPoints, Player perspective) {
+  if(perspective == PLAYER_2) {
+    // Same features for player 2 as for player 1 on the vertically mirrored board.
+    pt = pt < P2_KING ? PieceType(pt + P2_KING) : PieceType(pt - P2_KING);
+    squareIndex ^= 56;
+  }
+  int hpBucket = healthPoints / 10;
+  if(hpBucket >= NNUE_NUM_HP_BUCKETS) hpBucket = NNUE_NUM_HP_BUCKETS - 1;
+  return (pt * NUM_SQUARES + squareIndex) * NNUE_NUM_HP_BUCKETS + hpBucket;
+}
+
+NNUENetwork::NNUENetwork() { }
+
+NNUENetwork::NNUENetwork(const std::string& path) {
+  load(path);
+}
+
+NNUENetwork::~NNUENetwork() {
+  unload();
+}
+
+void NNUENetwork::unload() {
+  if(mapping != nullptr) {
+    munmap(mapping, mappingSize);
+  }
+  mapping = nullptr;
+  mappingSize = 0;
+  featureBias = nullptr;
+  featureWeights = nullptr;
+  outputWeights = nullptr;
+}
+
+bool NNUENetwork::isLoaded() const {
+  return mapping != nullptr;
+}
+
+void NNUENetwork::load(const std::string& path) {
+  unload();
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd < 0) {
+    throw std::runtime_error("Could not open network file " + path);
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error("Could not stat network file " + path);
+  }
+  size_t expectedSize = NNUE_HEADER_SIZE + sizeof(int16_t) * (NNUE_HIDDEN_SIZE + (size_t)NNUE_NUM_FEATURES * NNUE_HIDDEN_SIZE + 2 * NNUE_HIDDEN_SIZE);
+  if((size_t)st.st_size != expectedSize) {
+    close(fd);
+    throw std::runtime_error("Network file " + path + " has the wrong size");
+  }
+  void* m = mmap(nullptr, expectedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(m == MAP_FAILED) {
+    throw std::runtime_error("Could not map network file " + path);
+  }
+
+  NNUEHeader header;
+  std::memcpy(&header, m, sizeof(header));
+  if(header.magic != NNUE_MAGIC || header.version != NNUE_VERSION || header.numFeatures != (uint32_t)NNUE_NUM_FEATURES || header.hiddenSize != (uint32_t)NNUE_HIDDEN_SIZE) {
+    munmap(m, expectedSize);
+    throw std::runtime_error("Network file " + path + " has the wrong format");
+  }
+  mapping = m;
+  mappingSize = expectedSize;
+  const int16_t* data = (const int16_t*)((const char*)m + NNUE_HEADER_SIZE);
+  featureBias = data;
+  featureWeights = data + NNUE_HIDDEN_SIZE;
+  outputWeights = featureWeights + (size_t)NNUE_NUM_FEATURES * NNUE_HIDDEN_SIZE;
+  outputBias = header.outputBias;
+}
+
+void NNUENetwork::write(const std::string& path, const std::vector<int16_t>& featureBias, const std::vector<int16_t>& featureWeights, const std::vector<int16_t>& outputWeights, int32_t outputBias) {
+  if(featureBias.size() != (size_t)NNUE_HIDDEN_SIZE || featureWeights.size() != (size_t)NNUE_NUM_FEATURES * NNUE_HIDDEN_SIZE || outputWeights.size() != (size_t)2 * NNUE_HIDDEN_SIZE) {
+    throw std::runtime_error("Network weights have the wrong size");
+  }
+  std::ofstream out(path, std::ios::binary);
+  if(!out) {
+    throw std::runtime_error("Could not open " + path + " for writing");
+  }
+  char headerBytes[NNUE_HEADER_SIZE] = {0};
+  NNUEHeader header;
+  header.magic = NNUE_MAGIC;
+  header.version = NNUE_VERSION;
+  header.numFeatures = NNUE_NUM_FEATURES;
+  header.hiddenSize = NNUE_HIDDEN_SIZE;
+  header.outputBias = outputBias;
+  std::memcpy(headerBytes, &header, sizeof(header));
+  out.write(headerBytes, NNUE_HEADER_SIZE);
+  out.write((const char*)featureBias.data(), featureBias.size() * sizeof(int16_t));
+  out.write((const char*)featureWeights.data(), featureWeights.size() * sizeof(int16_t));
+  out.write((const char*)outputWeights.data(), outputWeights.size() * sizeof(int16_t));
+}
+
+NNUEAccumulator::NNUEAccumulator(const NNUENetwork& weights): network(weights) {
+  std::memset(values, 0, sizeof(values));
+}
+
+void NNUEAccumulator::addFeature(PieceType pt, int squareIndex, int healthPoints) {
+  for(int p = 0; p < NUM_PLAYERS; p++) {
+    int f = nnueFeatureIndex(pt, squareIndex, healthPoints, Player(p));
+    addColumn(values[p], network.featureWeights + (size_t)f * NNUE_HIDDEN_SIZE);
+  }
+}
+
+void NNUEAccumulator::removeFeature(PieceType pt, int squareIndex, int healthPoints) {
+  for(int p = 0; p < NUM_PLAYERS; p++) {
+    int f = nnueFeatureIndex(pt, squareIndex, healthPoints, Player(p));
+    subColumn(values[p], network.featureWeights + (size_t)f * NNUE_HIDDEN_SIZE);
+  }
+}
+
+void NNUEAccumulator::squareChanged(int squareIndex, const Piece& before, const Piece& after) {
+  if(before.type != NO_PIECE) {
+    removeFeature(before.type, squareIndex, before.healthPoints);
+  }
+  if(after.type != NO_PIECE) {
+    addFeature(after.type, squareIndex, after.healthPoints);
+  }
+}
+
+void NNUEAccumulator::refresh(const Game& game) {
+  for(int p = 0; p < NUM_PLAYERS; p++) {
+    std::memcpy(values[p], network.featureBias, sizeof(int16_t) * NNUE_HIDDEN_SIZE);
+  }
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    const Piece* piece = game.board[i];
+    if(piece->type != NO_PIECE) {
+      addFeature(piece->type, i, piece->healthPoints);
+    }
+  }
+}
+
+int NNUEAccumulator::output(Player sideToMove) const {
+  int32_t sum = dotClipped(values[sideToMove], network.outputWeights);
+  sum += dotClipped(values[~sideToMove], network.outputWeights + NNUE_HIDDEN_SIZE);
+  return (sum >> NNUE_OUTPUT_SHIFT) + network.outputBias;
+}
+
+NNUEEvaluator::NNUEEvaluator(const NNUENetwork& network): accumulator(network) { }
+
+void NNUEEvaluator::attach(Game& game) {
+  if(attachedGame == &game) return;
+  if(attachedGame != nullptr) {
+    attachedGame->removeSquareObserver(&accumulator);
+  }
+  attachedGame = &game;
+  game.addSquareObserver(&accumulator);
+}
+
+void NNUEEvaluator::detach(Game& game) {
+  if(attachedGame != &game) return;
+  game.removeSquareObserver(&accumulator);
+  attachedGame = nullptr;
+}
+
+int NNUEEvaluator::evaluate(Game& game) {
+  if(attachedGame != &game) {
+    accumulator.refresh(game);
+  }
+  return accumulator.output(game.currentPlayer);
+}
@@ -0,0 +1,102 @@
+#include "nichess/packedposition.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace nichess;
+
+static const size_t PACKED_HEADER_SIZE = 10;
+static const int MAX_PACKED_MOVE_NUMBER = 0x7FFF;
+
+size_t nichess::packPosition(const Game& game, uint8_t* out) {
+  if(game.moveNumber < 0 || game.moveNumber > MAX_PACKED_MOVE_NUMBER) {
+    throw std::runtime_error("packPosition: move number out of range");
+  }
+  // Branch free gathering, whether a square is occupied is hard to predict.
+  uint8_t types[NUM_SQUARES + 1];
+  uint8_t healthPoints[NUM_SQUARES];
+  uint64_t occupied = 0;
+  unsigned int outOfRange = 0;
+  int numPieces = 0;
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    const Piece& piece = game.syncedSquares[i];
+    uint64_t isOccupied = piece.type != PieceType::NO_PIECE;
+    types[numPieces] = (uint8_t)piece.type;
+    healthPoints[numPieces] = (uint8_t)piece.healthPoints;
+    outOfRange |= (unsigned int)piece.healthPoints & ~0xFFu;
+    occupied |= isOccupied << i;
+    numPieces += (int)isOccupied;
+  }
+  if(outOfRange) {
+    throw std::runtime_error("packPosition: health points out of range");
+  }
+  types[numPieces] = 0;
+
+  for(int i = 0; i < 8; i++) {
+    out[i] = (uint8_t)(occupied >> (8 * i));
+  }
+  uint16_t state = (uint16_t)((game.moveNumber << 1) | game.currentPlayer);
+  out[8] = (uint8_t)state;
+  out[9] = (uint8_t)(state >> 8);
+  uint8_t* packedTypes = out + PACKED_HEADER_SIZE;
+  int numTypeBytes = (numPieces + 1) / 2;
+  for(int i = 0; i < numTypeBytes; i++) {
+    packedTypes[i] = (uint8_t)(types[2 * i] | (types[2 * i + 1] << 4));
+  }
+  std::memcpy(packedTypes + numTypeBytes, healthPoints, numPieces);
+  return PACKED_HEADER_SIZE + numTypeBytes + numPieces;
+}
+
+size_t nichess::packedPositionSize(const uint8_t* in, size_t size) {
+  if(size < 8) return 0;
+  uint64_t occupied = 0;
+  for(int i = 0; i < 8; i++) {
+    occupied |= (uint64_t)in[i] << (8 * i);
+  }
+  int numPieces = __builtin_popcountll(occupied);
+  return PACKED_HEADER_SIZE + (numPieces + 1) / 2 + numPieces;
+}
+
+size_t nichess::unpackSquares(const uint8_t* in, size_t size, Piece squares[], Player& player, int& moveNumber) {
+  size_t packedSize = packedPositionSize(in, size);
+  if(packedSize == 0 || packedSize > size) {
+    throw std::runtime_error("unpackPosition: truncated position");
+  }
+  uint64_t occupied = 0;
+  for(int i = 0; i < 8; i++) {
+    occupied |= (uint64_t)in[i] << (8 * i);
+  }
+  uint16_t state = (uint16_t)(in[8] | (in[9] << 8));
+  int numPieces = __builtin_popcountll(occupied);
+  const uint8_t* types = in + PACKED_HEADER_SIZE;
+  const uint8_t* healthPoints = types + (numPieces + 1) / 2;
+
+  // Fields are set directly, Piece's constructors aren't inlined.
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    squares[i].type = PieceType::NO_PIECE;
+    squares[i].healthPoints = 0;
+    squares[i].squareIndex = i;
+  }
+  int n = 0;
+  for(uint64_t s = occupied; s; s &= s - 1, n++) {
+    int type = (types[n / 2] >> (4 * (n % 2))) & 0xF;
+    if(type >= PieceType::NO_PIECE) {
+      throw std::runtime_error("unpackPosition: invalid piece type");
+    }
+    Piece& square = squares[__builtin_ctzll(s)];
+    square.type = (PieceType)type;
+    square.healthPoints = healthPoints[n];
+  }
+  player = (Player)(state & 1);
+  moveNumber = state >> 1;
+  return packedSize;
+}
+
+size_t nichess::unpackPosition(const uint8_t* in, size_t size, Game& game) {
+  Piece squares[NUM_SQUARES];
+  Player player;
+  int moveNumber;
+  size_t packedSize = unpackSquares(in, size, squares, player, moveNumber);
+  game.setPosition(squares, player, moveNumber);
+  return packedSize;
+}
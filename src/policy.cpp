@@ -0,0 +1,98 @@
+#include "nichess/policy.hpp"
+
+#include <cstring>
+
+using namespace nichess;
+
+int nichess::policyIndex(const PlayerAction& action) {
+  return action.srcIdx * NUM_SQUARES + action.dstIdx;
+}
+
+std::optional<PlayerAction> nichess::policyAction(Game& game, int index) {
+  if(index < 0 || index >= POLICY_SIZE) return std::nullopt;
+  int srcIdx = index / NUM_SQUARES;
+  int dstIdx = index % NUM_SQUARES;
+  std::optional<ActionType> type = game.legalActionType(srcIdx, dstIdx);
+  if(!type) return std::nullopt;
+  return PlayerAction(srcIdx, dstIdx, *type);
+}
+
+size_t nichess::maxSparsePolicySize(size_t count) {
+  return 2 + 4 * count;
+}
+
+size_t nichess::encodeSparsePolicy(const PlayerAction actions[], const uint32_t visits[], size_t count, uint8_t* out) {
+  uint64_t total = 0;
+  for(size_t i = 0; i < count; i++) {
+    total += visits[i];
+  }
+  uint16_t length = 0;
+  if(total > 0) {
+    float scale = (float)POLICY_WEIGHT_SCALE / total;
+    uint8_t* p = out + 2;
+    for(size_t i = 0; i < count; i++) {
+      uint16_t entry[2];
+      entry[0] = (uint16_t)policyIndex(actions[i]);
+      entry[1] = (uint16_t)(visits[i] * scale + 0.5f);
+      std::memcpy(p, entry, sizeof(entry));
+      // Dropped entries are overwritten by the next one.
+      bool kept = entry[1] != 0;
+      p += kept * sizeof(entry);
+      length += kept;
+    }
+  }
+  std::memcpy(out, &length, sizeof(length));
+  return 2 + 4 * (size_t)length;
+}
+
+static inline uint16_t load16(const uint8_t* in) {
+  uint16_t value;
+  std::memcpy(&value, in, sizeof(value));
+  return value;
+}
+
+size_t nichess::sparsePolicyLength(const uint8_t* in) {
+  return load16(in);
+}
+
+size_t nichess::sparsePolicySize(const uint8_t* in, size_t size) {
+  if(size < 2) return 0;
+  size_t n = 2 + 4 * sparsePolicyLength(in);
+  return n <= size ? n : 0;
+}
+
+static uint32_t weightSum(const uint8_t* entries, size_t length) {
+  uint32_t sum = 0;
+  for(size_t i = 0; i < length; i++) {
+    sum += load16(entries + 4 * i + 2);
+  }
+  return sum;
+}
+
+size_t nichess::decodeSparsePolicy(const uint8_t* in, uint16_t indices[], float fractions[]) {
+  size_t length = sparsePolicyLength(in);
+  const uint8_t* entries = in + 2;
+  uint32_t sum = weightSum(entries, length);
+  float inverse = sum > 0 ? 1.0f / sum : 0;
+  for(size_t i = 0; i < length; i++) {
+    indices[i] = load16(entries + 4 * i);
+    fractions[i] = load16(entries + 4 * i + 2) * inverse;
+  }
+  return length;
+}
+
+void nichess::expandSparsePolicies(const uint8_t* const policies[], size_t count, float dense[]) {
+  std::memset(dense, 0, count * POLICY_SIZE * sizeof(float));
+  for(size_t row = 0; row < count; row++) {
+    size_t length = sparsePolicyLength(policies[row]);
+    const uint8_t* entries = policies[row] + 2;
+    uint32_t sum = weightSum(entries, length);
+    if(sum == 0) continue;
+    float inverse = 1.0f / sum;
+    float* out = dense + row * POLICY_SIZE;
+    for(size_t i = 0; i < length; i++) {
+      // Indices come from files, keep them inside the row.
+      out[load16(entries + 4 * i) % POLICY_SIZE] += load16(entries + 4 * i + 2) * inverse;
+    }
+  }
+}
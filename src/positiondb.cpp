@@ -0,0 +1,395 @@
+#include "nichess/positiondb.hpp"
+#include "nichess/packedposition.hpp"
+#include "nichess/selfplay.hpp"
+#include "nichess/symmetry.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+using namespace nichess;
+
+class PositionDatabaseHeader {
+  public:
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    uint64_t numEntries;
+    uint8_t reserved[40];
+};
+
+static_assert(sizeof(PositionDatabaseHeader) == POSITION_DB_HEADER_SIZE, "PositionDatabaseHeader has to match POSITION_DB_HEADER_SIZE");
+
+// Finalizer of splitmix64.
+static uint64_t mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xBF58'476D'1CE4'E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D0'49BB'1331'11EBULL;
+  x ^= x >> 31;
+  return x;
+}
+
+bool PositionKey::operator==(const PositionKey& other) const {
+  return key1 == other.key1 && key2 == other.key2;
+}
+
+PositionKey nichess::positionKey(const Game& game) {
+  return positionKey(game.syncedSquares, game.currentPlayer);
+}
+
+PositionKey nichess::positionKey(const Piece squares[], Player player) {
+  CanonicalKey canonical = canonicalKey(squares, player);
+  PositionKey key;
+  key.key1 = canonical.key;
+  // Read in the orientation of key1.
+  int flip = canonical.mirrored ? NUM_COLUMNS - 1 : 0;
+  uint64_t h = 0x9E37'79B9'7F4A'7C15ULL + player;
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    const Piece& p = squares[i ^ flip];
+    if(p.type == NO_PIECE) continue;
+    h = mix(h + ((uint64_t)i | (uint64_t)p.type << 6 | (uint64_t)p.healthPoints << 10));
+  }
+  key.key2 = h == 0 ? 1 : h;
+  return key;
+}
+
+uint64_t PositionEntry::games() const {
+  return (uint64_t)wins + draws + losses;
+}
+
+static bool isEmpty(const PositionEntry& entry) {
+  return entry.key.key2 == 0;
+}
+
+static bool keyLess(const PositionEntry& a, const PositionEntry& b) {
+  if(a.key.key2 != b.key.key2) return a.key.key2 < b.key.key2;
+  return a.key.key1 < b.key.key1;
+}
+
+static void addCounts(PositionEntry& to, const PositionEntry& from) {
+  to.wins += from.wins;
+  to.draws += from.draws;
+  to.losses += from.losses;
+}
+
+PositionDatabase::PositionDatabase() {}
+
+PositionDatabase::~PositionDatabase() {
+  close();
+}
+
+void PositionDatabase::map(const std::string& filePath, bool create, uint64_t capacity) {
+  int fd = ::open(filePath.c_str(), create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+  if(fd < 0) {
+    throw std::runtime_error("Could not open position database " + filePath);
+  }
+  size_t size;
+  if(create) {
+    size = POSITION_DB_HEADER_SIZE + capacity * sizeof(PositionEntry);
+    // The file stays sparse until slots are written.
+    if(ftruncate(fd, size) != 0) {
+      ::close(fd);
+      throw std::runtime_error("Could not create position database " + filePath);
+    }
+  } else {
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < (size_t)POSITION_DB_HEADER_SIZE) {
+      ::close(fd);
+      throw std::runtime_error("Position database " + filePath + " is too small");
+    }
+    size = st.st_size;
+  }
+  void* m = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if(m == MAP_FAILED) {
+    throw std::runtime_error("Could not map position database " + filePath);
+  }
+
+  PositionDatabaseHeader header;
+  if(create) {
+    std::memset(&header, 0, sizeof(header));
+    header.magic = POSITION_DB_MAGIC;
+    header.version = POSITION_DB_VERSION;
+    header.capacity = capacity;
+  } else {
+    std::memcpy(&header, m, sizeof(header));
+    uint64_t c = header.capacity;
+    if(header.magic != POSITION_DB_MAGIC || header.version != POSITION_DB_VERSION || c < 2 || (c & (c - 1)) != 0 ||
+        size != POSITION_DB_HEADER_SIZE + c * sizeof(PositionEntry) || header.numEntries > c) {
+      munmap(m, size);
+      throw std::runtime_error("Position database " + filePath + " has the wrong format");
+    }
+  }
+  close();
+  path = filePath;
+  mapping = m;
+  mappingSize = size;
+  slots = (PositionEntry*)((uint8_t*)m + POSITION_DB_HEADER_SIZE);
+  mask = header.capacity - 1;
+  shift = 64 - __builtin_ctzll(header.capacity);
+  numEntries = header.numEntries;
+  writeHeader();
+}
+
+void PositionDatabase::create(const std::string& filePath, uint64_t capacity) {
+  uint64_t c = 2;
+  while(c < capacity) {
+    c <<= 1;
+  }
+  map(filePath, true, c);
+}
+
+void PositionDatabase::open(const std::string& filePath) {
+  map(filePath, false, 0);
+}
+
+void PositionDatabase::writeHeader() {
+  PositionDatabaseHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = POSITION_DB_MAGIC;
+  header.version = POSITION_DB_VERSION;
+  header.capacity = mask + 1;
+  header.numEntries = numEntries;
+  std::memcpy(mapping, &header, sizeof(header));
+}
+
+void PositionDatabase::close() {
+  if(mapping != nullptr) {
+    writeHeader();
+    munmap(mapping, mappingSize);
+  }
+  mapping = nullptr;
+  mappingSize = 0;
+  slots = nullptr;
+  mask = 0;
+  shift = 64;
+  numEntries = 0;
+}
+
+void PositionDatabase::flush() {
+  if(mapping == nullptr) return;
+  writeHeader();
+  if(msync(mapping, mappingSize, MS_SYNC) != 0) {
+    throw std::runtime_error("Could not write position database " + path);
+  }
+}
+
+uint64_t PositionDatabase::size() const {
+  return numEntries;
+}
+
+uint64_t PositionDatabase::home(const PositionKey& key) const {
+  return key.key2 >> shift;
+}
+
+uint64_t PositionDatabase::capacity() const {
+  return mapping == nullptr ? 0 : mask + 1;
+}
+
+const PositionEntry* PositionDatabase::find(const PositionKey& key) const {
+  if(mapping == nullptr) return nullptr;
+  for(uint64_t s = home(key); !isEmpty(slots[s]); s = (s + 1) & mask) {
+    if(slots[s].key == key) return &slots[s];
+  }
+  return nullptr;
+}
+
+bool PositionDatabase::insert(const PositionEntry& entry, uint64_t first, uint64_t last, uint64_t& added) {
+  // Only the whole table wraps around.
+  bool wraps = first == 0 && last == mask + 1;
+  uint64_t s = home(entry.key);
+  while(true) {
+    PositionEntry& slot = slots[s];
+    if(isEmpty(slot)) {
+      slot = entry;
+      slot.reserved = 0;
+      added++;
+      return true;
+    }
+    if(slot.key == entry.key) {
+      addCounts(slot, entry);
+      return true;
+    }
+    if(++s == last) {
+      if(!wraps) return false;
+      s = 0;
+    }
+  }
+}
+
+uint64_t PositionDatabase::insertRange(const PositionEntry* begin, const PositionEntry* end, uint64_t first, uint64_t last,
+    std::vector<PositionEntry>& overflow) {
+  uint64_t added = 0;
+  for(const PositionEntry* e = begin; e != end; e++) {
+    if(!insert(*e, first, last, added)) {
+      overflow.push_back(*e);
+    }
+  }
+  return added;
+}
+
+void PositionDatabase::sortByHome(std::vector<PositionEntry>& entries) {
+  std::sort(entries.begin(), entries.end(), keyLess);
+  size_t n = 0;
+  for(size_t i = 0; i < entries.size(); i++) {
+    if(n > 0 && entries[n - 1].key == entries[i].key) {
+      addCounts(entries[n - 1], entries[i]);
+    } else {
+      entries[n++] = entries[i];
+    }
+  }
+  entries.resize(n);
+}
+
+void PositionDatabase::reserve(uint64_t count) {
+  if(mapping == nullptr) {
+    throw std::runtime_error("Position database isn't open");
+  }
+  uint64_t c = mask + 1;
+  while((double)(numEntries + count) > maxLoad * c) {
+    c <<= 1;
+  }
+  if(c == mask + 1) return;
+
+  // Rehashed into a new file which then replaces the old one. Slots are read in order of their
+  // home slots, so the new file is written front to back as well.
+  std::string grownPath = path + ".grow";
+  PositionDatabase grown;
+  grown.create(grownPath, c);
+  uint64_t added = 0;
+  for(uint64_t s = 0; s <= mask; s++) {
+    if(!isEmpty(slots[s])) {
+      grown.insert(slots[s], 0, c, added);
+    }
+  }
+  grown.numEntries = added;
+  grown.close();
+  std::string oldPath = path;
+  close();
+  if(std::rename(grownPath.c_str(), oldPath.c_str()) != 0) {
+    throw std::runtime_error("Could not replace position database " + oldPath);
+  }
+  open(oldPath);
+}
+
+void PositionDatabase::add(const PositionKey& key, int outcome) {
+  PositionEntry entry;
+  entry.key = key;
+  entry.wins = outcome > 0;
+  entry.draws = outcome == 0;
+  entry.losses = outcome < 0;
+  entry.reserved = 0;
+  reserve(1);
+  insert(entry, 0, mask + 1, numEntries);
+}
+
+void PositionDatabase::insertBatch(std::vector<PositionEntry>& entries) {
+  sortByHome(entries);
+  reserve(entries.size());
+  std::vector<PositionEntry> overflow;
+  numEntries += insertRange(entries.data(), entries.data() + entries.size(), 0, mask + 1, overflow);
+}
+
+void PositionDatabase::merge(const PositionDatabase& other) {
+  std::vector<PositionEntry> entries;
+  for(uint64_t s = 0; s < other.capacity(); s++) {
+    if(!isEmpty(other.slots[s])) {
+      entries.push_back(other.slots[s]);
+    }
+  }
+  insertBatch(entries);
+}
+
+// One entry per sample of the shard at path.
+static void readShard(const std::string& path, std::vector<PositionEntry>& entries) {
+  SelfPlayShardReader reader;
+  reader.load(path);
+  entries.reserve(reader.numSamples());
+  SelfPlaySample sample;
+  Piece squares[NUM_SQUARES];
+  Player player;
+  int moveNumber;
+  while(reader.next(sample)) {
+    unpackSquares(sample.position, MAX_PACKED_POSITION_SIZE, squares, player, moveNumber);
+    PositionEntry entry;
+    entry.key = positionKey(squares, player);
+    entry.wins = sample.outcome > 0;
+    entry.draws = sample.outcome == 0;
+    entry.losses = sample.outcome < 0;
+    entry.reserved = 0;
+    entries.push_back(entry);
+  }
+}
+
+void PositionDatabase::build(const std::vector<std::string>& shards, int numThreads) {
+  size_t threads = std::max(numThreads, 1);
+  // One shard per thread and round, inserted before the next round is read.
+  for(size_t next = 0; next < shards.size(); next += threads) {
+    size_t count = std::min(threads, shards.size() - next);
+    std::vector<std::vector<PositionEntry>> entries(count);
+    std::vector<std::exception_ptr> errors(count);
+    std::vector<std::thread> workers;
+    for(size_t t = 0; t < count; t++) {
+      workers.emplace_back([&, t]() {
+        try {
+          readShard(shards[next + t], entries[t]);
+          sortByHome(entries[t]);
+        } catch(...) {
+          errors[t] = std::current_exception();
+        }
+      });
+    }
+    for(std::thread& worker: workers) {
+      worker.join();
+    }
+    for(const std::exception_ptr& e: errors) {
+      if(e) std::rethrow_exception(e);
+    }
+
+    uint64_t total = 0;
+    for(const std::vector<PositionEntry>& e: entries) {
+      total += e.size();
+    }
+    reserve(total);
+
+    // Thread p owns slots [p * span, (p + 1) * span) and inserts the entries whose home slot is
+    // there. Entries that would probe into the next range are inserted afterwards.
+    uint64_t capacity = mask + 1;
+    size_t parts = std::min<uint64_t>(count, capacity);
+    uint64_t span = capacity / parts;
+    std::vector<std::vector<PositionEntry>> overflow(parts);
+    std::vector<uint64_t> added(parts, 0);
+    workers.clear();
+    for(size_t p = 0; p < parts; p++) {
+      workers.emplace_back([&, p]() {
+        uint64_t first = p * span;
+        uint64_t last = p + 1 == parts ? capacity : first + span;
+        auto before = [this](const PositionEntry& entry, uint64_t slot) { return home(entry.key) < slot; };
+        for(const std::vector<PositionEntry>& e: entries) {
+          const PositionEntry* begin = e.data() + (std::lower_bound(e.begin(), e.end(), first, before) - e.begin());
+          const PositionEntry* end = e.data() + (std::lower_bound(e.begin(), e.end(), last, before) - e.begin());
+          added[p] += insertRange(begin, end, first, last, overflow[p]);
+        }
+      });
+    }
+    for(std::thread& worker: workers) {
+      worker.join();
+    }
+    for(size_t p = 0; p < parts; p++) {
+      numEntries += added[p];
+      for(const PositionEntry& e: overflow[p]) {
+        insert(e, 0, capacity, numEntries);
+      }
+    }
+  }
+  writeHeader();
+}
@@ -0,0 +1,249 @@
+#include "nichess/search.hpp"
+#include "nichess/book.hpp"
+#include "nichess/exchange.hpp"
+#include "nichess/solver.hpp"
+#include "nichess/tablebase.hpp"
+#include "nichess/util.hpp"
+
+#include <algorithm>
+
+using namespace nichess;
+
+AlphaBetaSearch::AlphaBetaSearch(): AlphaBetaSearch(nullptr) { }
+
+AlphaBetaSearch::AlphaBetaSearch(Evaluator* leafEvaluator):
+  evaluator(leafEvaluator),
+  stopFlag(false),
+  pvTable(MAX_SEARCH_DEPTH, std::vector<PlayerAction>(MAX_SEARCH_DEPTH)),
+  pvLength(MAX_SEARCH_DEPTH, 0)
+{
+  if(this->evaluator == nullptr) {
+    this->evaluator = &defaultEvaluator;
+  }
+}
+
+void AlphaBetaSearch::stop() {
+  stopFlag.store(true, std::memory_order_relaxed);
+}
+
+bool AlphaBetaSearch::isStopped() const {
+  return stopFlag.load(std::memory_order_relaxed);
+}
+
+/*
+ * The node budget is checked on every node, the stop flag and the clock only every
+ * checkInterval nodes since reading the clock is comparatively expensive.
+ */
+bool AlphaBetaSearch::shouldAbort() {
+  if(nodeBudget != 0 && nodes >= nodeBudget) return true;
+  if(--checkCountdown > 0) return false;
+  checkCountdown = checkInterval;
+  if(stopFlag.load(std::memory_order_relaxed)) return true;
+  if(hasHardDeadline && std::chrono::steady_clock::now() >= hardDeadline) return true;
+  return false;
+}
+
+static bool isAbility(ActionType actionType) {
+  switch(actionType) {
+    case ActionType::MOVE_REGULAR:
+    case ActionType::MOVE_CASTLE:
+    case ActionType::MOVE_PROMOTE_P1_PAWN:
+    case ActionType::MOVE_PROMOTE_P2_PAWN:
+    case ActionType::SKIP:
+      return false;
+    default:
+      return true;
+  }
+}
+
+/*
+ * Previous principal variation first, then abilities that don't lose in the damage exchange, best
+ * first, then moves, then abilities that lose.
+ */
+void AlphaBetaSearch::orderActions(Game& game, std::vector<PlayerAction>& actions, int ply) {
+  std::vector<std::pair<int, PlayerAction>> scored;
+  scored.reserve(actions.size());
+  for(const PlayerAction& action: actions) {
+    int score = 0;
+    if(isAbility(action.actionType)) {
+      int exchange = damageExchange(game, action);
+      score = exchange >= 0 ? exchange + 1 : exchange;
+    }
+    scored.push_back({score, action});
+  }
+  std::stable_sort(scored.begin(), scored.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+  for(size_t i = 0; i < actions.size(); i++) {
+    actions[i] = scored[i].second;
+  }
+  if(ply < (int)previousPv.size()) {
+    auto it = std::find(actions.begin(), actions.end(), previousPv[ply]);
+    if(it != actions.end()) {
+      std::rotate(actions.begin(), it, it + 1);
+    }
+  }
+}
+
+int AlphaBetaSearch::negamax(Game& game, int depth, int ply, int alpha, int beta) {
+  pvLength[ply] = ply;
+  nodes++;
+  if(shouldAbort()) {
+    aborted = true;
+    return 0;
+  }
+  if(game.playerToKing[game.currentPlayer]->healthPoints <= 0) {
+    return -MATE_SCORE + ply;
+  }
+  if(game.isGameDraw()) {
+    return 0;
+  }
+  if(tablebase != nullptr && ply > 0) {
+    std::optional<TablebaseResult> result = tablebase->probe(game);
+    if(result && *result != TablebaseResult::INVALID) {
+      if(*result == TablebaseResult::WIN) return TABLEBASE_WIN_SCORE - ply;
+      if(*result == TablebaseResult::LOSS) return -TABLEBASE_WIN_SCORE + ply;
+      return 0;
+    }
+  }
+  if(depth <= 0 || ply >= MAX_SEARCH_DEPTH - 1) {
+    return evaluator->evaluate(game);
+  }
+
+  std::vector<PlayerAction> actions = game.generateLegalActions();
+  if(actions.empty()) {
+    return 0;
+  }
+  orderActions(game, actions, ply);
+
+  int bestScore = -INFINITE_SCORE;
+  for(size_t i = 0; i < actions.size(); i++) {
+    UndoInfo undoInfo = game.makeAction(actions[i]);
+    int score = -negamax(game, depth - 1, ply + 1, -beta, -alpha);
+    game.undoAction(undoInfo);
+    if(aborted) return 0;
+
+    if(score > bestScore) {
+      bestScore = score;
+      if(score > alpha) {
+        alpha = score;
+        pvTable[ply][ply] = actions[i];
+        for(int j = ply + 1; j < pvLength[ply + 1]; j++) {
+          pvTable[ply][j] = pvTable[ply + 1][j];
+        }
+        pvLength[ply] = pvLength[ply + 1];
+      }
+      if(score >= beta) break;
+    }
+  }
+  return bestScore;
+}
+
+SearchResult AlphaBetaSearch::search(Game& game, const SearchLimits& limits) {
+  // A stop that arrives after the previous search finished must not cut this one short.
+  stopFlag.store(false, std::memory_order_relaxed);
+  startTime = std::chrono::steady_clock::now();
+  int hardMs = limits.hardDeadline;
+  if(limits.moveTime > 0 && (hardMs == 0 || limits.moveTime < hardMs)) {
+    hardMs = limits.moveTime;
+  }
+  hasHardDeadline = hardMs > 0;
+  hardDeadline = startTime + std::chrono::milliseconds(hardMs);
+  nodeBudget = limits.nodes;
+  nodes = 0;
+  checkInterval = std::max(1, limits.checkInterval);
+  checkCountdown = checkInterval;
+  aborted = false;
+  previousPv.clear();
+
+  SearchResult result;
+  std::vector<PlayerAction> rootActions = game.generateLegalActions();
+  if(rootActions.empty()) {
+    result.bestAction = PlayerAction(ACTION_SKIP, ACTION_SKIP, ActionType::SKIP);
+    return result;
+  }
+  if(book != nullptr) {
+    std::optional<PlayerAction> bookAction = book->bestAction(game);
+    if(bookAction) {
+      result.bestAction = bookAction.value();
+      result.pv.push_back(bookAction.value());
+      result.fromBook = true;
+      return result;
+    }
+  }
+  if(solver != nullptr) {
+    // The solve ends by the soft deadline and may use half of the node budget, its nodes count
+    // towards the budget.
+    SolverLimits solverLimits;
+    solverLimits.nodes = nodeBudget == 0 ? 0 : std::max<uint64_t>(1, nodeBudget / 2);
+    if(hasHardDeadline) {
+      solverLimits.deadline = hardDeadline;
+    }
+    if(limits.softDeadline > 0) {
+      solverLimits.deadline = std::min(solverLimits.deadline, startTime + std::chrono::milliseconds(limits.softDeadline));
+    }
+    solverLimits.stopFlag = &stopFlag;
+    SolverOutcome outcome = solver->solve(game, solverLimits);
+    nodes += outcome.nodes;
+    if(outcome.result == SolverResult::WIN) {
+      result.bestAction = outcome.bestAction;
+      result.pv.push_back(outcome.bestAction);
+      result.score = MATE_SCORE - outcome.plies;
+      result.depth = outcome.plies;
+      result.nodes = nodes;
+      result.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+      return result;
+    }
+    if(isStopped() || (hasHardDeadline && std::chrono::steady_clock::now() >= hardDeadline)) {
+      result.bestAction = rootActions[0];
+      result.stopped = true;
+      result.nodes = nodes;
+      result.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+      return result;
+    }
+  }
+  result.bestAction = rootActions[0];
+  evaluator->attach(game);
+
+  int maxDepth = std::min(std::max(1, limits.depth), MAX_SEARCH_DEPTH - 1);
+  for(int depth = 1; depth <= maxDepth; depth++) {
+    int score = negamax(game, depth, 0, -INFINITE_SCORE, INFINITE_SCORE);
+    auto now = std::chrono::steady_clock::now();
+    int64_t elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(now - startTime).count();
+    if(aborted) {
+      // An interrupted iteration still improves on the previous one if its first (previous best)
+      // action was fully searched, which is the case whenever the root pv was written.
+      if(pvLength[0] > 0) {
+        result.bestAction = pvTable[0][0];
+        result.pv.assign(pvTable[0].begin(), pvTable[0].begin() + pvLength[0]);
+      }
+      result.stopped = true;
+      break;
+    }
+
+    result.depth = depth;
+    result.score = score;
+    result.pv.assign(pvTable[0].begin(), pvTable[0].begin() + pvLength[0]);
+    if(!result.pv.empty()) {
+      result.bestAction = result.pv[0];
+    }
+    previousPv = result.pv;
+
+    if(infoCallback) {
+      SearchInfo info;
+      info.depth = depth;
+      info.score = score;
+      info.nodes = nodes;
+      info.nps = elapsedUs > 0 ? nodes * 1000000 / elapsedUs : nodes;
+      info.elapsed = elapsedUs / 1000;
+      info.pv = result.pv;
+      infoCallback(info);
+    }
+
+    if(score >= MATE_BOUND || score <= -MATE_BOUND) break;
+    if(limits.softDeadline > 0 && elapsedUs >= (int64_t)limits.softDeadline * 1000) break;
+  }
+
+  evaluator->detach(game);
+  result.nodes = nodes;
+  result.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+  return result;
+}
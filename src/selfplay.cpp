@@ -0,0 +1,467 @@
+#include "nichess/selfplay.hpp"
+#include "nichess/book.hpp"
+#include "nichess/packedposition.hpp"
+#include "nichess/policy.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+using namespace nichess;
+
+class SelfPlayShardHeader {
+  public:
+    uint32_t magic;
+    uint32_t version;
+    uint64_t numSamples;
+    uint64_t numGames;
+    uint8_t reserved[8];
+};
+
+static_assert(sizeof(SelfPlayShardHeader) == SELF_PLAY_SHARD_HEADER_SIZE, "SelfPlayShardHeader has to match SELF_PLAY_SHARD_HEADER_SIZE");
+
+/*
+ * Appends a sample with outcome 0 to data and returns the offset of its outcome byte, which is
+ * filled in when the game is over.
+ */
+static size_t appendSample(std::vector<uint8_t>& data, const Game& game, const PlayerAction* actions, const uint32_t* visits, size_t count) {
+  count = std::min(count, MAX_SPARSE_POLICY_LENGTH);
+  size_t size = data.size();
+  data.resize(size + MAX_PACKED_POSITION_SIZE + 1 + maxSparsePolicySize(count));
+  uint8_t* out = data.data() + size;
+  size_t n = packPosition(game, out);
+  size_t outcomeOffset = size + n;
+  out[n++] = 0;
+  n += encodeSparsePolicy(actions, visits, count, out + n);
+  data.resize(size + n);
+  return outcomeOffset;
+}
+
+static PlayerAction randomAction(Game& game, std::mt19937_64& rng, bool& found) {
+  std::vector<PlayerAction> actions = game.generateLegalActions();
+  found = !actions.empty();
+  if(!found) return PlayerAction();
+  return actions[rng() % actions.size()];
+}
+
+SelfPlayConfig::SelfPlayConfig() {
+  searchLimits.depth = 4;
+  mctsLimits.visits = 200;
+}
+
+SelfPlay::SelfPlay(const SelfPlayConfig& selfPlayConfig):
+  config(selfPlayConfig),
+  stopFlag(false),
+  gamesStarted(0),
+  games(0),
+  droppedGames(0),
+  positions(0),
+  bytesWritten(0)
+{
+}
+
+SelfPlay::~SelfPlay() {
+  stop();
+}
+
+void SelfPlay::stop() {
+  stopFlag = true;
+}
+
+SelfPlayStats SelfPlay::run() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(running) {
+      throw std::runtime_error("Self-play is already running");
+    }
+    running = true;
+    workersDone = false;
+    error = nullptr;
+    startTime = std::chrono::steady_clock::now();
+  }
+  stopFlag = false;
+  gamesStarted = 0;
+  games = 0;
+  droppedGames = 0;
+  positions = 0;
+  bytesWritten = 0;
+
+  std::thread writer(&SelfPlay::writeBlocks, this);
+  std::vector<std::thread> workers;
+  for(int i = 0; i < std::max(config.numThreads, 1); i++) {
+    workers.emplace_back(&SelfPlay::playGames, this, i);
+  }
+  for(std::thread& worker: workers) {
+    worker.join();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    workersDone = true;
+  }
+  blockQueued.notify_one();
+  writer.join();
+
+  std::exception_ptr e;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+    endTime = std::chrono::steady_clock::now();
+    e = error;
+  }
+  if(e) {
+    std::rethrow_exception(e);
+  }
+  return stats();
+}
+
+SelfPlayStats SelfPlay::stats() const {
+  SelfPlayStats s;
+  s.games = games;
+  s.droppedGames = droppedGames;
+  s.positions = positions;
+  s.bytesWritten = bytesWritten;
+  std::lock_guard<std::mutex> lock(mutex);
+  s.shards = shardPaths.size();
+  auto end = running ? std::chrono::steady_clock::now() : endTime;
+  s.seconds = std::chrono::duration<double>(end - startTime).count();
+  if(s.seconds > 0) {
+    s.gamesPerHour = s.games * 3600.0 / s.seconds;
+    s.positionsPerSecond = s.positions / s.seconds;
+  }
+  return s;
+}
+
+std::vector<std::string> SelfPlay::shards() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return shardPaths;
+}
+
+void SelfPlay::fail(std::exception_ptr e) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!error) error = e;
+  }
+  stopFlag = true;
+}
+
+void SelfPlay::submit(Block* block) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    block->writing = true;
+    queue.push_back(block);
+  }
+  blockQueued.notify_one();
+}
+
+void SelfPlay::waitWritten(Block* block) {
+  std::unique_lock<std::mutex> lock(mutex);
+  blockWritten.wait(lock, [block]() { return !block->writing; });
+}
+
+void SelfPlay::playGames(int thread) {
+  Block blocks[2];
+  int current = 0;
+  try {
+    std::mt19937_64 rng(config.seed * 0x9E37'79B9'7F4A'7C15ULL + thread);
+    std::unique_ptr<LeafEvaluator> evaluator;
+    std::unique_ptr<MCTS> mcts;
+    std::unique_ptr<AlphaBetaSearch> alphaBeta;
+    if(config.engine == SelfPlayEngine::MCTS) {
+      if(config.evaluatorFactory) {
+        evaluator = config.evaluatorFactory(thread);
+      } else {
+        evaluator = std::make_unique<StaticLeafEvaluator>();
+      }
+      mcts = std::make_unique<MCTS>(evaluator.get(), config.mctsNodeCapacity, config.mctsEdgeCapacity);
+      mcts->book = config.book;
+    } else if(config.engine == SelfPlayEngine::ALPHA_BETA) {
+      alphaBeta = std::make_unique<AlphaBetaSearch>();
+      alphaBeta->book = config.book;
+    }
+
+    const Game start;
+    Game game;
+    std::vector<size_t> outcomeOffsets;
+    std::vector<Player> samplePlayers;
+    std::vector<PlayerAction> policyActions;
+    std::vector<uint32_t> policyVisits;
+    while(!stopFlag) {
+      if(config.numGames > 0 && gamesStarted.fetch_add(1) >= config.numGames) break;
+      Block& block = blocks[current];
+      size_t gameStart = block.data.size();
+      game.setPosition(start.syncedSquares, PLAYER_1, 0);
+      if(mcts) mcts->reset();
+      outcomeOffsets.clear();
+      samplePlayers.clear();
+
+      bool aborted = false;
+      bool unfinished = false;
+      for(int ply = 0; ply < config.maxPlies && !game.isGameOver() && !game.isGameDraw(); ply++) {
+        if(stopFlag) {
+          aborted = true;
+          break;
+        }
+        PlayerAction action;
+        bool found = true;
+        if(ply < config.randomPlies) {
+          std::optional<PlayerAction> bookAction;
+          if(config.book != nullptr) {
+            bookAction = config.book->sampleAction(game, rng());
+          }
+          action = bookAction ? *bookAction : randomAction(game, rng, found);
+          if(!found) {
+            unfinished = true;
+            break;
+          }
+        } else {
+          policyActions.clear();
+          policyVisits.clear();
+          if(config.engine == SelfPlayEngine::RANDOM) {
+            action = randomAction(game, rng, found);
+          } else if(config.engine == SelfPlayEngine::ALPHA_BETA) {
+            action = alphaBeta->search(game, config.searchLimits).bestAction;
+            found = game.isActionLegal(action);
+          } else {
+            MCTSResult result = mcts->search(game, config.mctsLimits);
+            action = result.bestAction;
+            found = game.isActionLegal(action);
+            uint64_t totalVisits = 0;
+            for(uint32_t v: result.rootVisits) {
+              totalVisits += v;
+            }
+            if(totalVisits > 0) {
+              policyActions = result.rootActions;
+              policyVisits = result.rootVisits;
+              if(ply < config.samplingPlies) {
+                uint64_t r = rng() % totalVisits;
+                size_t i = 0;
+                while(r >= policyVisits[i]) {
+                  r -= policyVisits[i++];
+                }
+                action = policyActions[i];
+              }
+            }
+          }
+          if(!found) {
+            unfinished = true;
+            break;
+          }
+          if(policyActions.empty()) {
+            policyActions.push_back(action);
+            policyVisits.push_back(1);
+          }
+          outcomeOffsets.push_back(appendSample(block.data, game, policyActions.data(), policyVisits.data(), policyActions.size()));
+          samplePlayers.push_back(game.currentPlayer);
+        }
+        game.makeAction(action);
+        if(mcts) mcts->advance(game, action);
+      }
+      if(aborted) {
+        block.data.resize(gameStart);
+        break;
+      }
+      if(unfinished) {
+        // Nothing to play before the game ended, its outcome isn't known.
+        block.data.resize(gameStart);
+        droppedGames++;
+        continue;
+      }
+
+      std::optional<Player> winner = game.isGameOver() ? game.winner() : std::nullopt;
+      for(size_t i = 0; i < outcomeOffsets.size(); i++) {
+        int8_t outcome = !winner ? 0 : *winner == samplePlayers[i] ? 1 : -1;
+        block.data[outcomeOffsets[i]] = (uint8_t)outcome;
+      }
+      block.samples += outcomeOffsets.size();
+      block.games++;
+      positions += outcomeOffsets.size();
+      games++;
+
+      if(block.data.size() >= config.blockSize) {
+        submit(&block);
+        current ^= 1;
+        waitWritten(&blocks[current]);
+        blocks[current].data.clear();
+        blocks[current].samples = 0;
+        blocks[current].games = 0;
+      }
+    }
+  } catch(...) {
+    fail(std::current_exception());
+  }
+  // Blocks live on this thread's stack, the writer has to be done with them before it returns.
+  if(!blocks[current].data.empty()) {
+    submit(&blocks[current]);
+  }
+  waitWritten(&blocks[0]);
+  waitWritten(&blocks[1]);
+}
+
+void SelfPlay::writeBlocks() {
+  bool failed = false;
+  std::unique_lock<std::mutex> lock(mutex);
+  while(true) {
+    blockQueued.wait(lock, [this]() { return !queue.empty() || workersDone; });
+    if(queue.empty()) break;
+    Block* block = queue.front();
+    queue.pop_front();
+    lock.unlock();
+    if(!failed) {
+      try {
+        if(shard.is_open() && shardBytes + block->data.size() > config.shardSize) {
+          closeShard();
+        }
+        if(!shard.is_open()) {
+          openShard();
+        }
+        shard.write((const char*)block->data.data(), block->data.size());
+        if(!shard) {
+          throw std::runtime_error("Could not write self-play shard " + shardPaths.back());
+        }
+        shardBytes += block->data.size();
+        shardSamples += block->samples;
+        shardGames += block->games;
+        bytesWritten += block->data.size();
+      } catch(...) {
+        failed = true;
+        fail(std::current_exception());
+      }
+    }
+    lock.lock();
+    block->writing = false;
+    blockWritten.notify_all();
+  }
+  lock.unlock();
+  if(!failed && shard.is_open()) {
+    try {
+      closeShard();
+    } catch(...) {
+      fail(std::current_exception());
+    }
+  }
+}
+
+void SelfPlay::openShard() {
+  std::string path;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), "-%05zu.shard", shardPaths.size());
+    path = config.shardPrefix + suffix;
+    shardPaths.push_back(path);
+  }
+  shard.open(path, std::ios::binary | std::ios::trunc);
+  if(!shard) {
+    throw std::runtime_error("Could not open self-play shard " + path + " for writing");
+  }
+  // The header is written again by closeShard.
+  SelfPlayShardHeader header;
+  std::memset(&header, 0, sizeof(header));
+  shard.write((const char*)&header, sizeof(header));
+  shardBytes = sizeof(header);
+  shardSamples = 0;
+  shardGames = 0;
+  bytesWritten += sizeof(header);
+}
+
+void SelfPlay::closeShard() {
+  SelfPlayShardHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = SELF_PLAY_SHARD_MAGIC;
+  header.version = SELF_PLAY_SHARD_VERSION;
+  header.numSamples = shardSamples;
+  header.numGames = shardGames;
+  shard.seekp(0);
+  shard.write((const char*)&header, sizeof(header));
+  shard.close();
+  if(!shard) {
+    throw std::runtime_error("Could not write self-play shard " + shardPaths.back());
+  }
+}
+
+SelfPlayShardReader::SelfPlayShardReader() {}
+
+SelfPlayShardReader::~SelfPlayShardReader() {
+  unload();
+}
+
+void SelfPlayShardReader::unload() {
+  if(mapping != nullptr) {
+    munmap(mapping, mappingSize);
+  }
+  mapping = nullptr;
+  mappingSize = 0;
+  cursor = nullptr;
+  samples = 0;
+  games = 0;
+}
+
+void SelfPlayShardReader::load(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd < 0) {
+    throw std::runtime_error("Could not open self-play shard " + path);
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size < (size_t)SELF_PLAY_SHARD_HEADER_SIZE) {
+    close(fd);
+    throw std::runtime_error("Self-play shard " + path + " is too small");
+  }
+  size_t size = st.st_size;
+  void* m = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(m == MAP_FAILED) {
+    throw std::runtime_error("Could not map self-play shard " + path);
+  }
+  madvise(m, size, MADV_SEQUENTIAL);
+
+  SelfPlayShardHeader header;
+  std::memcpy(&header, m, sizeof(header));
+  if(header.magic != SELF_PLAY_SHARD_MAGIC || header.version != SELF_PLAY_SHARD_VERSION) {
+    munmap(m, size);
+    throw std::runtime_error("Self-play shard " + path + " has the wrong format");
+  }
+  unload();
+  mapping = m;
+  mappingSize = size;
+  samples = header.numSamples;
+  games = header.numGames;
+  rewind();
+}
+
+uint64_t SelfPlayShardReader::numSamples() const {
+  return samples;
+}
+
+uint64_t SelfPlayShardReader::numGames() const {
+  return games;
+}
+
+void SelfPlayShardReader::rewind() {
+  cursor = mapping == nullptr ? nullptr : (const uint8_t*)mapping + SELF_PLAY_SHARD_HEADER_SIZE;
+}
+
+bool SelfPlayShardReader::next(SelfPlaySample& sample) {
+  const uint8_t* last = (const uint8_t*)mapping + mappingSize;
+  if(cursor == nullptr || cursor == last) return false;
+  const uint8_t* p = cursor;
+  size_t positionSize = packedPositionSize(p, last - p);
+  size_t policySize;
+  if(positionSize == 0 || positionSize >= (size_t)(last - p) ||
+      (policySize = sparsePolicySize(p + positionSize + 1, last - p - positionSize - 1)) == 0) {
+    throw std::runtime_error("Self-play sample is corrupt");
+  }
+  sample.position = p;
+  sample.outcome = (int8_t)p[positionSize];
+  sample.policy = p + positionSize + 1;
+  cursor = sample.policy + policySize;
+  return true;
+}
@@ -0,0 +1,243 @@
+#include "nichess/solver.hpp"
+#include "nichess/symmetry.hpp"
+
+#include <algorithm>
+
+using namespace nichess;
+
+const uint32_t PN_INFINITY = 1u << 30;
+// Distinguishes the defender's turns from the attacker's in the table.
+const uint64_t AND_NODE_KEY = 0x9E37'79B9'7F4A'7C15ull;
+// Node expansions between two checks of the clock and the stop flag.
+const int SOLVER_CHECK_INTERVAL = 16;
+
+SolverTable::SolverTable(size_t sizeMb) {
+  size_t numEntries = 1;
+  while(numEntries * 2 * sizeof(SolverTableEntry) <= sizeMb * 1024 * 1024) {
+    numEntries *= 2;
+  }
+  entries.resize(numEntries);
+  mask = numEntries - 1;
+  clear();
+}
+
+SolverTable::SolverTableEntry& SolverTable::entry(uint64_t key) {
+  return entries[key & mask];
+}
+
+SolverResult SolverTable::probe(uint64_t key, int plies) const {
+  const SolverTableEntry& e = entries[key & mask];
+  if(e.key != key) return SolverResult::UNKNOWN;
+  if(e.winPlies >= 0 && e.winPlies <= plies) return SolverResult::WIN;
+  if(e.noWinPlies >= plies) return SolverResult::NO_WIN;
+  return SolverResult::UNKNOWN;
+}
+
+void SolverTable::storeWin(uint64_t key, int plies) {
+  SolverTableEntry& e = entry(key);
+  if(e.key != key) {
+    e.key = key;
+    e.winPlies = -1;
+    e.noWinPlies = -1;
+  }
+  if(e.winPlies < 0 || plies < e.winPlies) {
+    e.winPlies = plies;
+  }
+}
+
+void SolverTable::storeNoWin(uint64_t key, int plies) {
+  SolverTableEntry& e = entry(key);
+  if(e.key != key) {
+    e.key = key;
+    e.winPlies = -1;
+    e.noWinPlies = -1;
+  }
+  e.noWinPlies = std::max<int>(e.noWinPlies, plies);
+}
+
+void SolverTable::clear() {
+  for(SolverTableEntry& e: entries) {
+    e.key = 0;
+    e.winPlies = -1;
+    e.noWinPlies = -1;
+  }
+}
+
+KingKillSolver::KingKillSolver(SolverTable* sharedTable): table(sharedTable) {
+  if(table == nullptr) {
+    ownTable = std::make_unique<SolverTable>();
+    table = ownTable.get();
+  }
+}
+
+static uint64_t solverKey(Game& game, bool orNode) {
+  // Mirror images have the same proofs.
+  uint64_t key = canonicalKey(game).key;
+  return orNode ? key : key ^ AND_NODE_KEY;
+}
+
+bool KingKillSolver::shouldAbort() {
+  if(--checkCountdown > 0) return false;
+  checkCountdown = SOLVER_CHECK_INTERVAL;
+  if(limits.stopFlag != nullptr && limits.stopFlag->load(std::memory_order_relaxed)) return true;
+  return std::chrono::steady_clock::now() >= limits.deadline;
+}
+
+SolverOutcome KingKillSolver::solve(Game& game, const SolverLimits& solveLimits) {
+  SolverOutcome outcome;
+  attacker = game.currentPlayer;
+  limits = solveLimits;
+  // The first check is right away, a solve may start after its deadline.
+  checkCountdown = 1;
+  uint64_t budget = limits.nodes == 0 ? nodeBudget : std::min(nodeBudget, limits.nodes);
+  if(game.playerToKing[PLAYER_1]->healthPoints <= 0 || game.playerToKing[PLAYER_2]->healthPoints <= 0) {
+    outcome.result = SolverResult::NO_WIN;
+    return outcome;
+  }
+  int limit = std::min(maxPlies, 127);
+  outcome.result = SolverResult::NO_WIN;
+  for(int plies = 1; plies <= limit; plies += 2) {
+    // Expansions can overshoot the budget by a few children.
+    if(outcome.nodes >= budget) {
+      outcome.result = SolverResult::UNKNOWN;
+      break;
+    }
+    SolverResult result = prove(game, plies, budget - outcome.nodes);
+    outcome.nodes += tree.size();
+    if(result == SolverResult::WIN) {
+      outcome.result = result;
+      outcome.plies = plies;
+      for(uint32_t i = 0; i < tree[0].numChildren; i++) {
+        const PNNode& child = tree[tree[0].firstChild + i];
+        if(child.proof == 0) {
+          outcome.bestAction = unpackAction(child.action);
+          break;
+        }
+      }
+      break;
+    }
+    if(result == SolverResult::UNKNOWN) {
+      outcome.result = result;
+      break;
+    }
+  }
+  tree.clear();
+  return outcome;
+}
+
+SolverResult KingKillSolver::prove(Game& game, int plies, uint64_t budget) {
+  tree.clear();
+  // A root known to be won is still searched, the tree is needed for the winning action.
+  if(table->probe(solverKey(game, true), plies) == SolverResult::NO_WIN) {
+    return SolverResult::NO_WIN;
+  }
+  PNNode root;
+  root.proof = 1;
+  root.disproof = 1;
+  root.parent = 0;
+  root.firstChild = 0;
+  root.numChildren = 0;
+  root.plies = plies;
+  root.expanded = false;
+  root.action = 0;
+  tree.push_back(root);
+
+  while(tree[0].proof != 0 && tree[0].disproof != 0) {
+    if(tree.size() >= budget || shouldAbort()) return SolverResult::UNKNOWN;
+
+    // Most proving node: the child that is cheapest to prove on the attacker's turns and the one
+    // that is cheapest to disprove on the defender's.
+    uint32_t nodeIdx = 0;
+    bool orNode = true;
+    while(tree[nodeIdx].expanded) {
+      const PNNode& node = tree[nodeIdx];
+      uint32_t best = node.firstChild;
+      for(uint32_t i = node.firstChild + 1; i < node.firstChild + node.numChildren; i++) {
+        if(orNode ? tree[i].proof < tree[best].proof : tree[i].disproof < tree[best].disproof) {
+          best = i;
+        }
+      }
+      undoStack.push_back(game.makeAction(unpackAction(tree[best].action)));
+      nodeIdx = best;
+      orNode = !orNode;
+    }
+
+    expand(nodeIdx, game, orNode);
+    while(true) {
+      update(nodeIdx, game, orNode);
+      if(nodeIdx == 0) break;
+      game.undoAction(undoStack.back());
+      undoStack.pop_back();
+      nodeIdx = tree[nodeIdx].parent;
+      orNode = !orNode;
+    }
+  }
+  return tree[0].proof == 0 ? SolverResult::WIN : SolverResult::NO_WIN;
+}
+
+void KingKillSolver::expand(uint32_t nodeIdx, Game& game, bool orNode) {
+  std::vector<PlayerAction> actions = game.generateLegalActions();
+  uint32_t firstChild = tree.size();
+  int childPlies = tree[nodeIdx].plies - 1;
+  Player defender = attacker == PLAYER_1 ? PLAYER_2 : PLAYER_1;
+  for(const PlayerAction& action: actions) {
+    PNNode child;
+    child.parent = nodeIdx;
+    child.firstChild = 0;
+    child.numChildren = 0;
+    child.plies = childPlies;
+    child.expanded = false;
+    child.action = packAction(action);
+    child.proof = 1;
+    child.disproof = 1;
+
+    UndoInfo undoInfo = game.makeAction(action);
+    SolverResult known = SolverResult::UNKNOWN;
+    if(game.playerToKing[defender]->healthPoints <= 0) {
+      known = SolverResult::WIN;
+    } else if(game.playerToKing[attacker]->healthPoints <= 0 || childPlies == 0) {
+      known = SolverResult::NO_WIN;
+    } else {
+      known = table->probe(solverKey(game, !orNode), childPlies);
+    }
+    game.undoAction(undoInfo);
+
+    if(known == SolverResult::WIN) {
+      child.proof = 0;
+      child.disproof = PN_INFINITY;
+    } else if(known == SolverResult::NO_WIN) {
+      child.proof = PN_INFINITY;
+      child.disproof = 0;
+    }
+    tree.push_back(child);
+  }
+  PNNode& node = tree[nodeIdx];
+  node.expanded = true;
+  node.firstChild = firstChild;
+  node.numChildren = actions.size();
+  if(actions.empty()) {
+    node.proof = PN_INFINITY;
+    node.disproof = 0;
+  }
+}
+
+void KingKillSolver::update(uint32_t nodeIdx, Game& game, bool orNode) {
+  PNNode& node = tree[nodeIdx];
+  if(node.numChildren > 0) {
+    uint32_t minValue = PN_INFINITY;
+    uint32_t sum = 0;
+    for(uint32_t i = node.firstChild; i < node.firstChild + node.numChildren; i++) {
+      uint32_t minSide = orNode ? tree[i].proof : tree[i].disproof;
+      uint32_t sumSide = orNode ? tree[i].disproof : tree[i].proof;
+      minValue = std::min(minValue, minSide);
+      sum = std::min(PN_INFINITY, sum + sumSide);
+    }
+    node.proof = orNode ? minValue : sum;
+    node.disproof = orNode ? sum : minValue;
+  }
+  if(node.proof == 0) {
+    table->storeWin(solverKey(game, orNode), node.plies);
+  } else if(node.disproof == 0) {
+    table->storeNoWin(solverKey(game, orNode), node.plies);
+  }
+}
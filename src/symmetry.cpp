@@ -0,0 +1,133 @@
+#include "nichess/symmetry.hpp"
+#include "nichess/policy.hpp"
+#include "nichess/zobrist.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace nichess;
+
+int nichess::mirrorSquare(int squareIndex) {
+  return squareIndex ^ (NUM_COLUMNS - 1);
+}
+
+PlayerAction nichess::mirrorAction(const PlayerAction& action) {
+  if(action.actionType == ActionType::MOVE_CASTLE) {
+    throw std::runtime_error("mirrorAction: castles have no mirror image");
+  }
+  if(action.actionType == ActionType::SKIP) return action;
+  return PlayerAction(mirrorSquare(action.srcIdx), mirrorSquare(action.dstIdx), action.actionType);
+}
+
+int nichess::mirrorPolicyIndex(int index) {
+  return mirrorSquare(index / NUM_SQUARES) * NUM_SQUARES + mirrorSquare(index % NUM_SQUARES);
+}
+
+void nichess::mirrorSquares(const Piece squares[], Piece mirrored[]) {
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    int m = mirrorSquare(i);
+    mirrored[m].type = squares[i].type;
+    mirrored[m].healthPoints = squares[i].healthPoints;
+    mirrored[m].squareIndex = m;
+  }
+}
+
+void nichess::mirrorGame(Game& game) {
+  Piece mirrored[NUM_SQUARES];
+  mirrorSquares(game.syncedSquares, mirrored);
+  game.setPosition(mirrored, game.currentPlayer, game.moveNumber);
+}
+
+/*
+ * Whether the king of the first row starting at row can castle, in the mirror image if mirrored.
+ * Columns are counted from the mirrored side then.
+ */
+static bool canCastle(const Piece squares[], int row, PieceType king, PieceType warrior, bool mirrored) {
+  auto at = [&](int column) -> PieceType {
+    return squares[row + (mirrored ? NUM_COLUMNS - 1 - column : column)].type;
+  };
+  if(at(4) != king) return false;
+  if(at(5) == NO_PIECE && at(6) == NO_PIECE && at(7) == warrior) return true;
+  return at(3) == NO_PIECE && at(2) == NO_PIECE && at(1) == NO_PIECE && at(0) == warrior;
+}
+
+bool nichess::mirrorPreservesActions(const Game& game) {
+  const Piece* squares = game.syncedSquares;
+  int p2Row = NUM_SQUARES - NUM_COLUMNS;
+  for(bool mirrored: {false, true}) {
+    if(canCastle(squares, 0, P1_KING, P1_WARRIOR, mirrored) || canCastle(squares, p2Row, P2_KING, P2_WARRIOR, mirrored)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool squaresMirrorIsExact(const Piece squares[]) {
+  bool castlers[NUM_PLAYERS] = {false, false};
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    switch(squares[i].type) {
+      case P1_WARRIOR:
+      case P1_PAWN:
+        castlers[PLAYER_1] = true;
+        break;
+      case P2_WARRIOR:
+      case P2_PAWN:
+        castlers[PLAYER_2] = true;
+        break;
+      default:
+        break;
+    }
+  }
+  return !castlers[PLAYER_1] && !castlers[PLAYER_2];
+}
+
+bool nichess::mirrorIsExact(const Game& game) {
+  return squaresMirrorIsExact(game.syncedSquares);
+}
+
+// Game::zobristHash computed from the squares, of the mirror image if mirrored.
+static uint64_t squaresHash(const Piece squares[], Player player, bool mirrored) {
+  long int hash = 0;
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    const Piece& p = squares[i];
+    if(p.type == NO_PIECE) continue;
+    hash ^= Zobrist::pieceTypeToSquareToHPToKey[p.type][mirrored ? mirrorSquare(i) : i][p.healthPoints / 10];
+  }
+  if(player == PLAYER_2) {
+    hash ^= Zobrist::p2Key;
+  }
+  return (uint64_t)hash;
+}
+
+uint64_t nichess::mirroredZobristHash(const Game& game) {
+  return squaresHash(game.syncedSquares, game.currentPlayer, true);
+}
+
+CanonicalKey nichess::canonicalKey(const Game& game) {
+  return canonicalKey(game.syncedSquares, game.currentPlayer);
+}
+
+CanonicalKey nichess::canonicalKey(const Piece squares[], Player player) {
+  CanonicalKey canonical;
+  canonical.key = squaresHash(squares, player, false);
+  canonical.mirrored = false;
+  if(squaresMirrorIsExact(squares)) {
+    uint64_t mirroredKey = squaresHash(squares, player, true);
+    if(mirroredKey < canonical.key) {
+      canonical.key = mirroredKey;
+      canonical.mirrored = true;
+    }
+  }
+  return canonical;
+}
+
+void nichess::mirrorSparsePolicy(const uint8_t* in, uint8_t* out) {
+  size_t length = sparsePolicyLength(in);
+  std::memmove(out, in, maxSparsePolicySize(length));
+  for(size_t i = 0; i < length; i++) {
+    uint16_t index;
+    std::memcpy(&index, out + 2 + 4 * i, sizeof(index));
+    index = (uint16_t)mirrorPolicyIndex(index % POLICY_SIZE);
+    std::memcpy(out + 2 + 4 * i, &index, sizeof(index));
+  }
+}
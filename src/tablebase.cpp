@@ -0,0 +1,477 @@
+#include "nichess/tablebase.hpp"
+#include "nichess/evaluation.hpp"
+#include "nichess/util.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+using namespace nichess;
+
+class TablebaseHeader {
+  public:
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numPieces;
+    uint32_t reserved;
+    uint64_t numPositions;
+    uint8_t pieces[TABLEBASE_MAX_PIECES];
+};
+
+static inline Player owner(PieceType pt) {
+  return pt < P2_KING ? PLAYER_1 : PLAYER_2;
+}
+
+TablebaseLayout::TablebaseLayout(const std::vector<PieceType>& material): pieces(material), size(NUM_PLAYERS) {
+  for(PieceType pt: pieces) {
+    int levels = STARTING_HEALTH_POINTS[pt] / 10;
+    hpLevels.push_back(levels);
+    if(size > (UINT64_MAX >> 16) / (NUM_SQUARES * levels)) {
+      throw std::runtime_error("Tablebase " + tablebaseName(material) + " is too large");
+    }
+    size *= NUM_SQUARES * levels;
+  }
+}
+
+uint64_t TablebaseLayout::index(Player player, const int squares[], const int healthPoints[]) const {
+  uint64_t retval = player;
+  for(size_t i = 0; i < pieces.size(); i++) {
+    retval = (retval * NUM_SQUARES + squares[i]) * hpLevels[i] + healthPoints[i] / 10 - 1;
+  }
+  return retval;
+}
+
+void TablebaseLayout::decode(uint64_t index, Player& player, int squares[], int healthPoints[]) const {
+  for(size_t i = pieces.size(); i-- > 0;) {
+    healthPoints[i] = (index % hpLevels[i] + 1) * 10;
+    index /= hpLevels[i];
+    squares[i] = index % NUM_SQUARES;
+    index /= NUM_SQUARES;
+  }
+  player = (Player)index;
+}
+
+std::vector<PieceType> nichess::tablebaseMaterial(std::vector<PieceType> pieces) {
+  std::sort(pieces.begin(), pieces.end());
+  int kings[NUM_PLAYERS] = {0, 0};
+  for(PieceType pt: pieces) {
+    if(pt == NO_PIECE) throw std::runtime_error("Tablebase material can't contain empty squares");
+    if(pt == P1_KING || pt == P2_KING) kings[owner(pt)]++;
+  }
+  if(kings[PLAYER_1] != 1 || kings[PLAYER_2] != 1) {
+    throw std::runtime_error("Tablebase material needs exactly one king per player");
+  }
+  if(pieces.size() > (size_t)TABLEBASE_MAX_PIECES) {
+    throw std::runtime_error("Tablebase material has too many pieces");
+  }
+  return pieces;
+}
+
+uint64_t nichess::tablebaseMaterialKey(const std::vector<PieceType>& material) {
+  uint64_t key = 0;
+  for(PieceType pt: material) {
+    key += 1ULL << (4 * pt);
+  }
+  return key;
+}
+
+std::string nichess::tablebaseName(const std::vector<PieceType>& material) {
+  static const char LETTERS[] = "KMWANPkmwanp";
+  std::string name;
+  for(PieceType pt: material) {
+    name += LETTERS[pt];
+  }
+  return name;
+}
+
+/*
+ * Live pieces of the game sorted by type and square. Returns -1 if there are more than
+ * TABLEBASE_MAX_PIECES.
+ */
+static int livePieces(Game& game, PieceType types[], int squares[], int healthPoints[]) {
+  int n = 0;
+  for(int p = 0; p < NUM_PLAYERS; p++) {
+    for(Piece* piece: game.playerToPieces[p]) {
+      if(piece->healthPoints <= 0) continue;
+      if(n == TABLEBASE_MAX_PIECES) return -1;
+      int i = n++;
+      // Insertion sort, there are only a few pieces.
+      while(i > 0 && (types[i - 1] > piece->type || (types[i - 1] == piece->type && squares[i - 1] > piece->squareIndex))) {
+        types[i] = types[i - 1];
+        squares[i] = squares[i - 1];
+        healthPoints[i] = healthPoints[i - 1];
+        i--;
+      }
+      types[i] = piece->type;
+      squares[i] = piece->squareIndex;
+      healthPoints[i] = piece->healthPoints;
+    }
+  }
+  return n;
+}
+
+static uint64_t materialKey(const PieceType types[], int n) {
+  uint64_t key = 0;
+  for(int i = 0; i < n; i++) {
+    key += 1ULL << (4 * types[i]);
+  }
+  return key;
+}
+
+static inline TablebaseResult packedValue(const uint8_t* data, uint64_t index) {
+  return (TablebaseResult)((data[index >> 2] >> ((index & 3) * 2)) & 3);
+}
+
+/*
+ * Calls work(begin, end, thread) for chunks of [0, n) on numThreads threads.
+ */
+static void parallelFor(int numThreads, uint64_t n, const std::function<void(uint64_t, uint64_t, int)>& work) {
+  const uint64_t chunk = 4096;
+  std::atomic<uint64_t> next(0);
+  auto run = [&](int thread) {
+    while(true) {
+      uint64_t begin = next.fetch_add(chunk, std::memory_order_relaxed);
+      if(begin >= n) break;
+      work(begin, std::min(begin + chunk, n), thread);
+    }
+  };
+  std::vector<std::thread> threads;
+  for(int t = 1; t < numThreads; t++) {
+    threads.emplace_back(run, t);
+  }
+  run(0);
+  for(std::thread& t: threads) {
+    t.join();
+  }
+}
+
+// Post-order, every ending comes after the endings it can turn into.
+static void collectEndings(const std::vector<PieceType>& material, std::set<uint64_t>& seen, std::vector<std::vector<PieceType>>& endings) {
+  uint64_t key = tablebaseMaterialKey(material);
+  if(seen.count(key)) return;
+  seen.insert(key);
+  for(size_t i = 0; i < material.size(); i++) {
+    PieceType pt = material[i];
+    if(pt == P1_KING || pt == P2_KING) continue;
+    std::vector<PieceType> smaller = material;
+    smaller.erase(smaller.begin() + i);
+    collectEndings(smaller, seen, endings);
+    if(pt == P1_PAWN || pt == P2_PAWN) {
+      std::vector<PieceType> promoted = material;
+      promoted[i] = pt == P1_PAWN ? P1_WARRIOR : P2_WARRIOR;
+      std::sort(promoted.begin(), promoted.end());
+      collectEndings(promoted, seen, endings);
+    }
+  }
+  endings.push_back(material);
+}
+
+TablebaseGenerator::TablebaseGenerator(const std::string& outputDirectory, int threads): directory(outputDirectory), numThreads(threads) {
+  if(numThreads <= 0) {
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+}
+
+std::vector<TablebaseStats> TablebaseGenerator::generate(const std::vector<PieceType>& material) {
+  std::set<uint64_t> seen;
+  std::vector<std::vector<PieceType>> endings;
+  collectEndings(tablebaseMaterial(material), seen, endings);
+  std::vector<TablebaseStats> retval;
+  for(const std::vector<PieceType>& ending: endings) {
+    if(tables.count(tablebaseMaterialKey(ending))) continue;
+    retval.push_back(generateTable(ending));
+  }
+  return retval;
+}
+
+TablebaseStats TablebaseGenerator::generateTable(const std::vector<PieceType>& material) {
+  auto startTime = std::chrono::steady_clock::now();
+  TablebaseLayout layout(material);
+  if(layout.size > UINT32_MAX) {
+    throw std::runtime_error("Tablebase " + tablebaseName(material) + " has too many positions");
+  }
+  uint64_t key = tablebaseMaterialKey(material);
+  uint64_t n = layout.size;
+  int numPieces = material.size();
+  std::unique_ptr<std::atomic<uint8_t>[]> values(new std::atomic<uint8_t>[n]);
+  // Successors in this table whose value is not known yet, +1 if an action reaches a draw elsewhere.
+  std::unique_ptr<std::atomic<uint16_t>[]> remaining(new std::atomic<uint16_t>[n]);
+  // (successor, position) pairs within this table.
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> threadEdges(numThreads);
+
+  std::vector<Game> games(numThreads);
+  parallelFor(numThreads, n, [&](uint64_t begin, uint64_t end, int thread) {
+    Game& game = games[thread];
+    std::vector<std::pair<uint32_t, uint32_t>>& edges = threadEdges[thread];
+    std::vector<Piece> pieces(numPieces);
+    Player player;
+    int squares[TABLEBASE_MAX_PIECES];
+    int healthPoints[TABLEBASE_MAX_PIECES];
+    PieceType childTypes[TABLEBASE_MAX_PIECES];
+    int childSquares[TABLEBASE_MAX_PIECES];
+    int childHealthPoints[TABLEBASE_MAX_PIECES];
+    for(uint64_t idx = begin; idx < end; idx++) {
+      remaining[idx].store(0, std::memory_order_relaxed);
+      layout.decode(idx, player, squares, healthPoints);
+      uint64_t occupied = 0;
+      bool valid = true;
+      for(int i = 0; i < numPieces; i++) {
+        if(occupied & (1ULL << squares[i])) valid = false;
+        occupied |= 1ULL << squares[i];
+        pieces[i] = Piece(material[i], healthPoints[i], squares[i]);
+      }
+      if(!valid) {
+        values[idx].store((uint8_t)TablebaseResult::INVALID, std::memory_order_relaxed);
+        continue;
+      }
+      game.setPieces(pieces, player);
+      std::vector<PlayerAction> actions = game.generateLegalActions();
+      TablebaseResult value = TablebaseResult::DRAW;
+      size_t numEdges = edges.size();
+      int count = 0;
+      bool reachesDraw = actions.empty();
+      for(const PlayerAction& action: actions) {
+        UndoInfo undoInfo = game.makeAction(action);
+        if(game.playerToKing[~player]->healthPoints <= 0) {
+          value = TablebaseResult::WIN;
+        } else if(game.playerToKing[player]->healthPoints > 0) {
+          int childPieces = livePieces(game, childTypes, childSquares, childHealthPoints);
+          uint64_t childKey = materialKey(childTypes, childPieces);
+          if(childKey == key) {
+            edges.emplace_back(layout.index(game.currentPlayer, childSquares, childHealthPoints), idx);
+            count++;
+          } else {
+            auto it = tables.find(childKey);
+            if(it == tables.end()) {
+              throw std::runtime_error("Tablebase generation reached an ending that was not generated");
+            }
+            TablebaseResult childValue = (TablebaseResult)it->second.values[it->second.layout.index(game.currentPlayer, childSquares, childHealthPoints)];
+            if(childValue == TablebaseResult::LOSS) {
+              value = TablebaseResult::WIN;
+            } else if(childValue != TablebaseResult::WIN) {
+              reachesDraw = true;
+            }
+          }
+        }
+        game.undoAction(undoInfo);
+        if(value == TablebaseResult::WIN) break;
+      }
+      if(value == TablebaseResult::WIN) {
+        // Won positions don't need their successors.
+        edges.resize(numEdges);
+      } else if(count == 0 && !reachesDraw) {
+        value = TablebaseResult::LOSS;
+      } else {
+        remaining[idx].store(count + (reachesDraw ? 1 : 0), std::memory_order_relaxed);
+      }
+      values[idx].store((uint8_t)value, std::memory_order_relaxed);
+    }
+  });
+
+  // Predecessor lists.
+  std::vector<uint32_t> predecessorStart(n + 1, 0);
+  for(const std::vector<std::pair<uint32_t, uint32_t>>& edges: threadEdges) {
+    for(const std::pair<uint32_t, uint32_t>& edge: edges) {
+      predecessorStart[edge.first + 1]++;
+    }
+  }
+  for(uint64_t i = 0; i < n; i++) {
+    predecessorStart[i + 1] += predecessorStart[i];
+  }
+  std::vector<uint32_t> predecessors(predecessorStart[n]);
+  {
+    std::vector<uint32_t> cursor(predecessorStart.begin(), predecessorStart.end() - 1);
+    for(std::vector<std::pair<uint32_t, uint32_t>>& edges: threadEdges) {
+      for(const std::pair<uint32_t, uint32_t>& edge: edges) {
+        predecessors[cursor[edge.first]++] = edge.second;
+      }
+      std::vector<std::pair<uint32_t, uint32_t>>().swap(edges);
+    }
+  }
+
+  std::vector<uint32_t> frontier;
+  for(uint64_t i = 0; i < n; i++) {
+    uint8_t v = values[i].load(std::memory_order_relaxed);
+    if(v == (uint8_t)TablebaseResult::WIN || v == (uint8_t)TablebaseResult::LOSS) frontier.push_back(i);
+  }
+  std::vector<std::vector<uint32_t>> threadFrontier(numThreads);
+  while(!frontier.empty()) {
+    parallelFor(numThreads, frontier.size(), [&](uint64_t begin, uint64_t end, int thread) {
+      std::vector<uint32_t>& next = threadFrontier[thread];
+      for(uint64_t k = begin; k < end; k++) {
+        uint32_t position = frontier[k];
+        bool lost = values[position].load(std::memory_order_relaxed) == (uint8_t)TablebaseResult::LOSS;
+        for(uint32_t j = predecessorStart[position]; j < predecessorStart[position + 1]; j++) {
+          uint32_t predecessor = predecessors[j];
+          uint8_t expected = (uint8_t)TablebaseResult::DRAW;
+          if(values[predecessor].load(std::memory_order_relaxed) != expected) continue;
+          if(lost) {
+            if(values[predecessor].compare_exchange_strong(expected, (uint8_t)TablebaseResult::WIN)) {
+              next.push_back(predecessor);
+            }
+          } else if(remaining[predecessor].fetch_sub(1) == 1) {
+            if(values[predecessor].compare_exchange_strong(expected, (uint8_t)TablebaseResult::LOSS)) {
+              next.push_back(predecessor);
+            }
+          }
+        }
+      }
+    });
+    frontier.clear();
+    for(std::vector<uint32_t>& next: threadFrontier) {
+      frontier.insert(frontier.end(), next.begin(), next.end());
+      next.clear();
+    }
+  }
+
+  GeneratedTable& table = tables.emplace(key, GeneratedTable{layout, std::vector<uint8_t>(n)}).first->second;
+  TablebaseStats stats;
+  stats.name = tablebaseName(material);
+  stats.positions = n;
+  std::vector<uint8_t> packed((n + 3) / 4, 0);
+  for(uint64_t i = 0; i < n; i++) {
+    uint8_t v = values[i].load(std::memory_order_relaxed);
+    table.values[i] = v;
+    packed[i >> 2] |= v << ((i & 3) * 2);
+    switch((TablebaseResult)v) {
+      case TablebaseResult::WIN: stats.wins++; break;
+      case TablebaseResult::LOSS: stats.losses++; break;
+      case TablebaseResult::DRAW: stats.draws++; break;
+      case TablebaseResult::INVALID: stats.invalid++; break;
+    }
+  }
+
+  std::string path = directory + "/" + stats.name + ".ntb";
+  std::ofstream out(path, std::ios::binary);
+  if(!out) {
+    throw std::runtime_error("Could not open " + path + " for writing");
+  }
+  char headerBytes[TABLEBASE_HEADER_SIZE] = {0};
+  TablebaseHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = TABLEBASE_MAGIC;
+  header.version = TABLEBASE_VERSION;
+  header.numPieces = numPieces;
+  header.numPositions = n;
+  for(int i = 0; i < numPieces; i++) {
+    header.pieces[i] = material[i];
+  }
+  std::memcpy(headerBytes, &header, sizeof(header));
+  out.write(headerBytes, TABLEBASE_HEADER_SIZE);
+  out.write((const char*)packed.data(), packed.size());
+  if(!out) {
+    throw std::runtime_error("Could not write " + path);
+  }
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+  return stats;
+}
+
+Tablebase::Tablebase() { }
+
+Tablebase::~Tablebase() {
+  for(auto& entry: tables) {
+    munmap(entry.second.mapping, entry.second.mappingSize);
+  }
+}
+
+void Tablebase::load(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd < 0) {
+    throw std::runtime_error("Could not open tablebase file " + path);
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size < (size_t)TABLEBASE_HEADER_SIZE) {
+    close(fd);
+    throw std::runtime_error("Tablebase file " + path + " is too small");
+  }
+  size_t size = st.st_size;
+  void* m = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(m == MAP_FAILED) {
+    throw std::runtime_error("Could not map tablebase file " + path);
+  }
+
+  TablebaseHeader header;
+  std::memcpy(&header, m, sizeof(header));
+  std::vector<PieceType> material;
+  for(uint32_t i = 0; i < header.numPieces && i < (uint32_t)TABLEBASE_MAX_PIECES; i++) {
+    material.push_back((PieceType)header.pieces[i]);
+  }
+  bool valid = header.magic == TABLEBASE_MAGIC && header.version == TABLEBASE_VERSION && header.numPieces <= (uint32_t)TABLEBASE_MAX_PIECES;
+  if(valid) {
+    try {
+      TablebaseLayout layout(tablebaseMaterial(material));
+      valid = layout.size == header.numPositions && size == TABLEBASE_HEADER_SIZE + (layout.size + 3) / 4;
+    } catch(const std::runtime_error& e) {
+      valid = false;
+    }
+  }
+  if(!valid) {
+    munmap(m, size);
+    throw std::runtime_error("Tablebase file " + path + " has the wrong format");
+  }
+
+  uint64_t key = tablebaseMaterialKey(material);
+  auto it = tables.find(key);
+  if(it != tables.end()) {
+    munmap(it->second.mapping, it->second.mappingSize);
+    tables.erase(it);
+  }
+  tables.emplace(key, MappedTable{TablebaseLayout(material), m, size, (const uint8_t*)m + TABLEBASE_HEADER_SIZE});
+  largestTable = std::max(largestTable, (int)material.size());
+}
+
+int Tablebase::loadDirectory(const std::string& directory) {
+  DIR* dir = opendir(directory.c_str());
+  if(dir == nullptr) {
+    throw std::runtime_error("Could not open tablebase directory " + directory);
+  }
+  std::vector<std::string> paths;
+  struct dirent* entry;
+  while((entry = readdir(dir)) != nullptr) {
+    std::string name = entry->d_name;
+    if(name.size() > 4 && name.compare(name.size() - 4, 4, ".ntb") == 0) {
+      paths.push_back(directory + "/" + name);
+    }
+  }
+  closedir(dir);
+  for(const std::string& path: paths) {
+    load(path);
+  }
+  return paths.size();
+}
+
+std::optional<TablebaseResult> Tablebase::probe(Game& game) const {
+  PieceType types[TABLEBASE_MAX_PIECES];
+  int squares[TABLEBASE_MAX_PIECES];
+  int healthPoints[TABLEBASE_MAX_PIECES];
+  int n = livePieces(game, types, squares, healthPoints);
+  if(n < 0 || n > largestTable) return std::nullopt;
+  auto it = tables.find(materialKey(types, n));
+  if(it == tables.end()) return std::nullopt;
+  const MappedTable& table = it->second;
+  for(int i = 0; i < n; i++) {
+    if(healthPoints[i] % 10 != 0 || healthPoints[i] / 10 > table.layout.hpLevels[i]) return std::nullopt;
+  }
+  return packedValue(table.data, table.layout.index(game.currentPlayer, squares, healthPoints));
+}
+
+size_t Tablebase::numTables() const {
+  return tables.size();
+}
+
+int Tablebase::maxPieces() const {
+  return largestTable;
+}
@@ -0,0 +1,105 @@
+#include "nichess/nichess.hpp"
+#include "nichess/actioncache.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace nichess;
+
+static bool cacheMatches(Game& g, ActionCache& cache) {
+  for(int s = 0; s < NUM_SQUARES; s++) {
+    if(cache.actionsAt(s) != g.legalMovesBySquare(s)) {
+      std::cout << "square " << s << " differs on\n" << g.dump() << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+// Cached lists match fresh ones through random games, including undone actions.
+int actionCacheTest1() {
+  std::mt19937 rng(1);
+  uint64_t generated = 0;
+  uint64_t actions = 0;
+  for(int game = 0; game < 100; game++) {
+    Game g = Game();
+    ActionCache cache(g);
+    for(int ply = 0; ply < 200 && !g.isGameOver(); ply++) {
+      if(!cacheMatches(g, cache)) return -1;
+      std::vector<PlayerAction> legalActions = g.generateLegalActions();
+      if(legalActions.empty()) break;
+      // Look at an action that is taken back.
+      UndoInfo undoInfo = g.makeAction(legalActions[rng() % legalActions.size()]);
+      if(!cacheMatches(g, cache)) return -1;
+      g.undoAction(undoInfo);
+
+      uint64_t misses = cache.misses;
+      if(!cacheMatches(g, cache)) return -1;
+      generated += cache.misses - misses;
+      actions++;
+      g.makeAction(legalActions[rng() % legalActions.size()]);
+    }
+    g.reset();
+    if(cache.cachedSquares() != 0 || !cacheMatches(g, cache)) return -1;
+  }
+  std::cout << (double)generated / actions << " lists generated per action\n";
+  return 0;
+}
+
+// Hovering over every square after each action, cached and fresh.
+int actionCacheTest2() {
+  std::mt19937 rng(2);
+  Game g = Game();
+  ActionCache cache(g);
+  std::vector<PlayerAction> played;
+  for(int ply = 0; ply < 150 && !g.isGameOver(); ply++) {
+    std::vector<PlayerAction> legalActions = g.generateLegalActions();
+    if(legalActions.empty()) break;
+    played.push_back(legalActions[rng() % legalActions.size()]);
+    g.makeAction(played.back());
+  }
+  size_t total = 0;
+  auto measure = [&](bool cached) {
+    Game replay = Game();
+    ActionCache replayCache(replay);
+    auto start = std::chrono::high_resolution_clock::now();
+    for(const PlayerAction& action: played) {
+      replay.makeAction(action);
+      for(int hover = 0; hover < 10; hover++) {
+        for(int s = 0; s < NUM_SQUARES; s++) {
+          total += cached ? replayCache.actionsAt(s).size() : replay.legalMovesBySquare(s).size();
+        }
+      }
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+  };
+  std::cout << "fresh lists took: " << measure(false) << " microseconds\n";
+  std::cout << "cached lists took: " << measure(true) << " microseconds\n";
+  return total > 0 ? 0 : -1;
+}
+
+int actioncachetest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return actionCacheTest1();
+  case 2:
+    return actionCacheTest2();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
@@ -0,0 +1,145 @@
+#include "nichess/nichess.hpp"
+#include "nichess/attackmap.hpp"
+#include "nichess/util.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace nichess;
+
+static bool isDirectDamage(ActionType type) {
+  switch(type) {
+    case ActionType::ABILITY_KING_DAMAGE:
+    case ActionType::ABILITY_MAGE_DAMAGE:
+    case ActionType::ABILITY_P1_PAWN_DAMAGE_AND_PROMOTION:
+    case ActionType::ABILITY_P2_PAWN_DAMAGE_AND_PROMOTION:
+    case ActionType::ABILITY_WARRIOR_DAMAGE:
+    case ActionType::ABILITY_ASSASSIN_DAMAGE:
+    case ActionType::ABILITY_KNIGHT_DAMAGE:
+    case ActionType::ABILITY_PAWN_DAMAGE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static bool sameAttacks(const AttackMap& a, const AttackMap& b) {
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    if(a.attackers(PLAYER_1, i) != b.attackers(PLAYER_1, i) || a.attackers(PLAYER_2, i) != b.attackers(PLAYER_2, i)) return false;
+    if(a.attacksFrom(i) != b.attacksFrom(i)) return false;
+  }
+  return true;
+}
+
+// Enemy pieces are attacked exactly by the pieces with a single target ability on them.
+static bool matchesAbilities(Game& g, const AttackMap& map) {
+  uint64_t expected[NUM_PLAYERS][NUM_SQUARES] = {};
+  for(Player player: {PLAYER_1, PLAYER_2}) {
+    for(Piece* piece: g.playerToPieces[player]) {
+      if(piece->healthPoints <= 0) continue;
+      for(const PlayerAction& action: g.legalActionsByPiece(piece)) {
+        if(isDirectDamage(action.actionType)) {
+          expected[player][action.dstIdx] |= 1ULL << action.srcIdx;
+        }
+      }
+    }
+  }
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    PieceType type = g.board[i]->type;
+    if(type == PieceType::NO_PIECE) continue;
+    Player enemy = pieceBelongsToPlayer(type, PLAYER_1) ? PLAYER_2 : PLAYER_1;
+    if(map.attackers(enemy, i) != expected[enemy][i]) return false;
+  }
+  return true;
+}
+
+// Incremental updates agree with a refresh and with the actions, through makeAction and undoAction.
+int attackMapTest1() {
+  std::mt19937 rng(1);
+  int positions = 0;
+  for(int game = 0; game < 40; game++) {
+    Game g = Game();
+    AttackMap map;
+    g.addSquareObserver(&map);
+    std::vector<UndoInfo> undoStack;
+    while(!g.isGameOver()) {
+      AttackMap fresh;
+      fresh.refresh(g);
+      if(!sameAttacks(map, fresh) || !matchesAbilities(g, map)) {
+        std::cout << "attack map differs on\n" << g.dump() << "\n";
+        return -1;
+      }
+      positions++;
+      std::vector<PlayerAction> actions = g.generateLegalActions();
+      if(actions.empty()) break;
+      undoStack.push_back(g.makeAction(actions[rng() % actions.size()]));
+    }
+    while(!undoStack.empty()) {
+      g.undoAction(undoStack.back());
+      undoStack.pop_back();
+    }
+    AttackMap fresh;
+    fresh.refresh(Game());
+    if(!sameAttacks(map, fresh)) return -1;
+    g.removeSquareObserver(&map);
+  }
+  std::cout << positions << " positions\n";
+  return 0;
+}
+
+// Benchmark, cost of keeping the map up to date.
+int attackMapTest2() {
+  std::mt19937 rng(2);
+  std::vector<PlayerAction> line;
+  Game g = Game();
+  for(int ply = 0; ply < 60 && !g.isGameOver(); ply++) {
+    std::vector<PlayerAction> actions = g.generateLegalActions();
+    line.push_back(actions[rng() % actions.size()]);
+    g.makeAction(line.back());
+  }
+  AttackMap map;
+  for(bool attached: {false, true}) {
+    Game game = Game();
+    if(attached) game.addSquareObserver(&map);
+    std::vector<UndoInfo> undoStack;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < 2000; i++) {
+      for(const PlayerAction& action: line) {
+        undoStack.push_back(game.makeAction(action));
+      }
+      while(!undoStack.empty()) {
+        game.undoAction(undoStack.back());
+        undoStack.pop_back();
+      }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << (attached ? "with" : "without") << " attack map: " << elapsed * 1000 / (2000 * 2 * line.size()) << " ns per makeAction/undoAction\n";
+    if(attached) game.removeSquareObserver(&map);
+  }
+  return 0;
+}
+
+int attackmaptest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return attackMapTest1();
+  case 2:
+    return attackMapTest2();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
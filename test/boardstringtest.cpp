@@ -0,0 +1,150 @@
+#include "nichess/nichess.hpp"
+#include "nichess/boardstring.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+using namespace nichess;
+
+// The format as it was written with a stringstream.
+static std::string referenceBoardString(Game& g) {
+  const char* names[] = {"0-king-", "0-mage-", "0-warrior-", "0-assassin-", "0-knight-", "0-pawn-",
+    "1-king-", "1-mage-", "1-warrior-", "1-assassin-", "1-knight-", "1-pawn-"};
+  std::stringstream retval;
+  retval << g.currentPlayer << "|";
+  for(int i = 0; i < NUM_SQUARES; i++) {
+    if(g.board[i]->type == NO_PIECE) {
+      retval << "empty,";
+    } else {
+      retval << names[g.board[i]->type] << g.board[i]->healthPoints << ",";
+    }
+  }
+  return retval.str();
+}
+
+static std::vector<std::string> randomBoardStrings(std::mt19937& rng, int numGames) {
+  std::vector<std::string> boards;
+  for(int game = 0; game < numGames; game++) {
+    Game g = Game();
+    for(int ply = 0; ply < 300 && !g.isGameOver(); ply++) {
+      std::vector<PlayerAction> legalActions = g.generateLegalActions();
+      if(legalActions.empty()) break;
+      g.makeAction(legalActions[rng() % legalActions.size()]);
+      boards.push_back(referenceBoardString(g));
+    }
+  }
+  return boards;
+}
+
+// Same text as before in both directions.
+int boardStringTest1() {
+  std::mt19937 rng(1);
+  std::vector<std::string> boards = randomBoardStrings(rng, 30);
+  char buffer[MAX_BOARD_STRING_SIZE];
+  Piece squares[NUM_SQUARES];
+  Player player;
+  for(const std::string& board: boards) {
+    std::from_chars_result parsed = parseBoard(board.data(), board.data() + board.size(), squares, player);
+    if(parsed.ec != std::errc() || parsed.ptr != board.data() + board.size()) return -1;
+    std::to_chars_result written = writeBoard(buffer, buffer + sizeof(buffer), squares, player);
+    if(written.ec != std::errc() || std::string(buffer, written.ptr) != board) return -1;
+    Game g = Game(board);
+    if(g.boardToString() != board || referenceBoardString(g) != board) return -1;
+  }
+  std::cout << boards.size() << " boards\n";
+  return 0;
+}
+
+// Errors, short buffers and boards one after another.
+int boardStringTest2() {
+  Game g = Game();
+  std::string start = g.boardToString();
+  Piece squares[NUM_SQUARES];
+  Player player;
+  std::string truncated = start.substr(0, start.size() - 1);
+  const char* invalid[] = {"", "2|", "0", "0|empty", "0|0-queen-10,", "0|0-king-,", "0|2-king-10,", truncated.c_str()};
+  for(const char* text: invalid) {
+    if(parseBoard(text, text + std::strlen(text), squares, player).ec != std::errc::invalid_argument) return -1;
+  }
+  try {
+    Game bad = Game("0|0-queen-10,");
+    return -1;
+  } catch(const std::runtime_error& e) {
+  }
+
+  char buffer[MAX_BOARD_STRING_SIZE];
+  for(size_t size: {(size_t)0, (size_t)1, (size_t)2, start.size() - 1}) {
+    if(writeBoard(buffer, buffer + size, g).ec != std::errc::value_too_large) return -1;
+  }
+  std::to_chars_result written = writeBoard(buffer, buffer + start.size(), g);
+  if(written.ec != std::errc() || written.ptr != buffer + start.size()) return -1;
+
+  std::string twoBoards = start + "\n" + start;
+  std::from_chars_result first = parseBoard(twoBoards.data(), twoBoards.data() + twoBoards.size(), squares, player);
+  if(first.ec != std::errc() || *first.ptr != '\n') return -1;
+  std::from_chars_result second = parseBoard(first.ptr + 1, twoBoards.data() + twoBoards.size(), squares, player);
+  if(second.ec != std::errc() || second.ptr != twoBoards.data() + twoBoards.size()) return -1;
+  return 0;
+}
+
+// Benchmark, against going through a Game.
+int boardStringTest3() {
+  std::mt19937 rng(3);
+  std::vector<std::string> boards = randomBoardStrings(rng, 5);
+  const int rounds = 20;
+  Piece squares[NUM_SQUARES];
+  Player player;
+  char buffer[MAX_BOARD_STRING_SIZE];
+  size_t checksum = 0;
+
+  auto start = std::chrono::high_resolution_clock::now();
+  for(int round = 0; round < rounds; round++) {
+    for(const std::string& board: boards) {
+      parseBoard(board.data(), board.data() + board.size(), squares, player);
+      checksum += writeBoard(buffer, buffer + sizeof(buffer), squares, player).ptr - buffer;
+    }
+  }
+  auto stop = std::chrono::high_resolution_clock::now();
+  double fastNs = std::chrono::duration<double, std::nano>(stop - start).count() / (rounds * boards.size());
+
+  start = std::chrono::high_resolution_clock::now();
+  for(const std::string& board: boards) {
+    Game g = Game(board);
+    checksum += referenceBoardString(g).size();
+  }
+  stop = std::chrono::high_resolution_clock::now();
+  double gameNs = std::chrono::duration<double, std::nano>(stop - start).count() / boards.size();
+
+  std::cout << "parse and write: " << fastNs << " ns, Game and stringstream: " << gameNs << " ns per board (" << checksum << ")\n";
+  return 0;
+}
+
+int boardstringtest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return boardStringTest1();
+  case 2:
+    return boardStringTest2();
+  case 3:
+    return boardStringTest3();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
@@ -0,0 +1,198 @@
+#include "nichess/nichess.hpp"
+#include "nichess/book.hpp"
+#include "nichess/mcts.hpp"
+#include "nichess/search.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+using namespace nichess;
+
+static const std::string BOOK_TEST_FILE = (std::filesystem::temp_directory_path() / "booktest.nbk").string();
+
+// Random games whose first plies are picked from the first few actions, so that openings repeat.
+static void addRandomGames(OpeningBookBuilder& builder, int numGames, unsigned int seed) {
+  std::mt19937 rng(seed);
+  for(int i = 0; i < numGames; i++) {
+    Game g = Game();
+    std::vector<PlayerAction> actions;
+    while(!g.isGameOver() && actions.size() < 200) {
+      std::vector<PlayerAction> legalActions = g.generateLegalActions();
+      if(legalActions.empty()) break;
+      size_t choices = actions.size() < 4 ? std::min<size_t>(3, legalActions.size()) : legalActions.size();
+      PlayerAction action = legalActions[rng() % choices];
+      g.makeAction(action);
+      actions.push_back(action);
+    }
+    builder.addGame(actions, g.winner());
+  }
+}
+
+// Build, load and probe.
+int bookTest1() {
+  OpeningBookBuilder builder;
+  builder.maxPly = 8;
+  addRandomGames(builder, 300, 1);
+  size_t written = builder.write(BOOK_TEST_FILE);
+  OpeningBook book;
+  book.load(BOOK_TEST_FILE);
+  std::cout << "games: " << builder.numGames() << " entries: " << written << "\n";
+  if(book.size() != written) return -1;
+
+  // Every game starts with a book action from the start position.
+  Game g = Game();
+  const BookEntry* first;
+  const BookEntry* last;
+  book.find((uint64_t)g.zobristHash(), first, last);
+  uint64_t totalWeight = 0;
+  for(const BookEntry* e = first; e != last; e++) {
+    totalWeight += e->weight;
+    if(e != first && e->weight > (e - 1)->weight) return -1;
+    if(e->score < -1000 || e->score > 1000) return -1;
+  }
+  if(last - first != 3 || totalWeight != 300) return -1;
+  std::optional<PlayerAction> best = book.bestAction(g);
+  if(!best || packAction(best.value()) != first->action) return -1;
+
+  // Sampling follows the weights.
+  std::mt19937_64 rng(2);
+  std::vector<int> counts(last - first, 0);
+  for(int i = 0; i < 3000; i++) {
+    std::optional<PlayerAction> sampled = book.sampleAction(g, rng());
+    if(!sampled) return -1;
+    for(const BookEntry* e = first; e != last; e++) {
+      if(e->action == packAction(sampled.value())) counts[e - first]++;
+    }
+  }
+  for(const BookEntry* e = first; e != last; e++) {
+    double expected = 3000.0 * e->weight / totalWeight;
+    if(std::abs(counts[e - first] - expected) > 0.2 * expected + 30) return -1;
+  }
+
+  // The interpolation search finds every entry of a key, for keys in and out of the book.
+  std::ifstream in(BOOK_TEST_FILE, std::ios::binary);
+  in.seekg(BOOK_HEADER_SIZE);
+  std::vector<BookEntry> entries(written);
+  in.read((char*)entries.data(), written * sizeof(BookEntry));
+  in.close();
+  std::remove(BOOK_TEST_FILE.c_str());
+  std::vector<uint64_t> keys;
+  for(const BookEntry& e: entries) {
+    keys.push_back(e.key);
+    keys.push_back(e.key + 1);
+    keys.push_back(e.key - 1);
+  }
+  keys.push_back(0);
+  keys.push_back(UINT64_MAX);
+  for(uint64_t key: keys) {
+    long expected = std::count_if(entries.begin(), entries.end(), [key](const BookEntry& e) {
+      return e.key == key;
+    });
+    book.find(key, first, last);
+    if(last - first != expected) return -1;
+    for(const BookEntry* e = first; e != last; e++) {
+      if(e->key != key) return -1;
+    }
+  }
+
+  // Positions past maxPly aren't in the book.
+  for(int ply = 0; ply < 12; ply++) {
+    std::vector<PlayerAction> legalActions = g.generateLegalActions();
+    g.makeAction(legalActions.back());
+  }
+  if(book.bestAction(g)) return -1;
+  return 0;
+}
+
+// Book hooks of both searches.
+int bookTest2() {
+  OpeningBookBuilder builder;
+  builder.maxPly = 4;
+  addRandomGames(builder, 50, 3);
+  builder.write(BOOK_TEST_FILE);
+  OpeningBook book;
+  book.load(BOOK_TEST_FILE);
+  std::remove(BOOK_TEST_FILE.c_str());
+
+  Game g = Game();
+  std::optional<PlayerAction> best = book.bestAction(g);
+  if(!best) return -1;
+
+  AlphaBetaSearch search;
+  search.book = &book;
+  SearchLimits limits;
+  limits.depth = 3;
+  SearchResult result = search.search(g, limits);
+  if(!result.fromBook || result.nodes != 0 || result.bestAction != best.value()) return -1;
+
+  StaticLeafEvaluator evaluator;
+  MCTS mcts(&evaluator, 1 << 14, 1 << 18);
+  mcts.book = &book;
+  MCTSLimits mctsLimits;
+  mctsLimits.visits = 200;
+  MCTSResult mctsResult = mcts.search(g, mctsLimits);
+  if(!mctsResult.fromBook || mctsResult.visits != 0 || mctsResult.bestAction != best.value()) return -1;
+
+  // Out of the book both search as usual.
+  for(int ply = 0; ply < 6; ply++) {
+    std::vector<PlayerAction> legalActions = g.generateLegalActions();
+    g.makeAction(legalActions.back());
+  }
+  result = search.search(g, limits);
+  mctsResult = mcts.search(g, mctsLimits);
+  if(result.fromBook || result.nodes == 0 || mctsResult.fromBook || mctsResult.visits != 200) return -1;
+  return 0;
+}
+
+int bookTest3() {
+  OpeningBook book;
+  try {
+    book.load("nonexistent.nbk");
+    return -1;
+  } catch(const std::runtime_error& e) {
+    std::cout << e.what() << "\n";
+  }
+  std::ofstream out(BOOK_TEST_FILE, std::ios::binary | std::ios::trunc);
+  std::vector<char> garbage(BOOK_HEADER_SIZE + 16, 'x');
+  out.write(garbage.data(), garbage.size());
+  out.close();
+  bool rejected = false;
+  try {
+    book.load(BOOK_TEST_FILE);
+  } catch(const std::runtime_error& e) {
+    std::cout << e.what() << "\n";
+    rejected = true;
+  }
+  std::remove(BOOK_TEST_FILE.c_str());
+  return rejected && book.size() == 0 ? 0 : -1;
+}
+
+int booktest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return bookTest1();
+  case 2:
+    return bookTest2();
+  case 3:
+    return bookTest3();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
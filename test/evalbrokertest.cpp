@@ -0,0 +1,132 @@
+#include "nichess/nichess.hpp"
+#include "nichess/evalbroker.hpp"
+#include "nichess/evaluation.hpp"
+#include "nichess/mcts.hpp"
+#include "testboards.hpp"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+using namespace nichess;
+
+// CPU stand-in for a network: tanh of the static evaluation, uniform priors.
+static void cpuBatchEvaluation(std::vector<BrokerRequest*>& batch) {
+  for(BrokerRequest* request: batch) {
+    size_t n = request->actions->size();
+    request->priors->assign(n, n == 0 ? 0 : 1.0f / n);
+    request->value = std::tanh(evaluate(*request->game) / 400.0f);
+  }
+}
+
+// Every thread gets the value of its own position back.
+int evalbrokerTest1() {
+  EvaluationBroker broker(cpuBatchEvaluation, 4, std::chrono::microseconds(500));
+  const int numThreads = 8;
+  const int perThread = 50;
+  std::vector<int> mismatches(numThreads, 0);
+  std::vector<std::thread> threads;
+  for(int t = 0; t < numThreads; t++) {
+    threads.emplace_back([&, t]() {
+      std::mt19937 rng(t);
+      Game g = Game();
+      for(int i = 0; i < perThread && !g.isGameOver(); i++) {
+        std::vector<PlayerAction> actions = g.generateLegalActions();
+        std::vector<float> priors;
+        float value = broker.evaluate(g, actions, priors);
+        if(value != std::tanh(evaluate(g) / 400.0f) || priors.size() != actions.size()) mismatches[t]++;
+        g.makeAction(actions[rng() % actions.size()]);
+      }
+    });
+  }
+  for(std::thread& t: threads) {
+    t.join();
+  }
+  std::cout << "requests: " << broker.numRequests() << " batches: " << broker.numBatches() << " average batch size: " << broker.averageBatchSize() << "\n";
+  for(int m: mismatches) {
+    if(m != 0) return -1;
+  }
+  return broker.numBatches() < broker.numRequests() ? 0 : -1;
+}
+
+// A lone request is flushed by the timeout.
+int evalbrokerTest2() {
+  EvaluationBroker broker(cpuBatchEvaluation, 64, std::chrono::microseconds(2000));
+  Game g = Game();
+  std::vector<PlayerAction> actions = g.generateLegalActions();
+  std::vector<float> priors;
+  auto start = std::chrono::steady_clock::now();
+  broker.evaluate(g, actions, priors);
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+  std::cout << "elapsed: " << elapsed.count() << " microseconds\n";
+  if(elapsed.count() >= 2000 && elapsed.count() < 100000 && broker.numBatches() == 1) {
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+// Several MCTS threads sharing a broker.
+int evalbrokerTest3() {
+  Game g = Game(kingKillBoard());
+  EvaluationBroker broker(cpuBatchEvaluation, 4, std::chrono::microseconds(200));
+  std::vector<BrokerEvaluator> evaluators(4, BrokerEvaluator(&broker));
+  std::vector<LeafEvaluator*> evaluatorPtrs;
+  for(BrokerEvaluator& e: evaluators) {
+    evaluatorPtrs.push_back(&e);
+  }
+  MCTS mcts(evaluatorPtrs, 1 << 16, 1 << 20);
+  MCTSLimits limits;
+  limits.visits = 1000;
+  MCTSResult result = mcts.search(g, limits);
+  std::cout << "visits: " << result.visits << " batches: " << broker.numBatches() << " average batch size: " << broker.averageBatchSize() << "\n";
+  if(result.bestAction == PlayerAction(4, 13, ActionType::ABILITY_KING_DAMAGE)) {
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+// Errors in the callback reach the waiting thread.
+int evalbrokerTest4() {
+  EvaluationBroker broker([](std::vector<BrokerRequest*>& batch) { throw std::runtime_error("inference failed"); }, 1);
+  Game g = Game();
+  std::vector<PlayerAction> actions = g.generateLegalActions();
+  std::vector<float> priors;
+  try {
+    broker.evaluate(g, actions, priors);
+  } catch(const std::runtime_error& e) {
+    return 0;
+  }
+  return -1;
+}
+
+int evalbrokertest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return evalbrokerTest1();
+  case 2:
+    return evalbrokerTest2();
+  case 3:
+    return evalbrokerTest3();
+  case 4:
+    return evalbrokerTest4();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
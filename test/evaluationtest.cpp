@@ -0,0 +1,94 @@
+#include "nichess/nichess.hpp"
+#include "nichess/evaluation.hpp"
+#include "nichess/util.hpp"
+
+#include <iostream>
+#include <random>
+
+using namespace nichess;
+
+// Starting position is symmetric.
+int evaluationTest1() {
+  Game g = Game();
+  int score = evaluate(g);
+  std::cout << "score: " << score << "\n";
+  if(score == 0) {
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+// Incrementally updated accumulator has to match the one computed from scratch (by the copy
+// constructor) after every makeAction and undoAction.
+int evaluationTest2() {
+  std::mt19937 rng(12345);
+  for(int game = 0; game < 50; game++) {
+    Game g = Game();
+    std::vector<UndoInfo> undoStack;
+    while(!g.isGameOver()) {
+      std::vector<PlayerAction> legalActions = g.generateLegalActions();
+      if(legalActions.empty()) break;
+      PlayerAction pa = legalActions[rng() % legalActions.size()];
+      undoStack.push_back(g.makeAction(pa));
+      Game fresh = Game(g);
+      if(!(fresh.evalAccumulator == g.evalAccumulator)) {
+        std::cout << "mismatch after makeAction, game " << game << " move " << g.moveNumber << "\n";
+        return -1;
+      }
+    }
+    while(!undoStack.empty()) {
+      g.undoAction(undoStack.back());
+      undoStack.pop_back();
+      Game fresh = Game(g);
+      if(!(fresh.evalAccumulator == g.evalAccumulator)) {
+        std::cout << "mismatch after undoAction, game " << game << " move " << g.moveNumber << "\n";
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+// Damaged pieces are worth less.
+int evaluationTest3() {
+  Game g = Game();
+  g.makeAction(PlayerAction(12, 28, ActionType::MOVE_REGULAR));
+  g.makeAction(PlayerAction(51, 35, ActionType::MOVE_REGULAR));
+  int materialBefore = g.evalAccumulator.material[PLAYER_2];
+  g.makeAction(PlayerAction(28, 35, ActionType::ABILITY_PAWN_DAMAGE));
+  int materialAfter = g.evalAccumulator.material[PLAYER_2];
+  std::cout << "p2 material: " << materialBefore << " -> " << materialAfter << "\n";
+  // player 2 to move, it lost a pawn
+  if(materialAfter < materialBefore && evaluate(g) < 0) {
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+int evaluationtest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return evaluationTest1();
+  case 2:
+    return evaluationTest2();
+  case 3:
+    return evaluationTest3();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
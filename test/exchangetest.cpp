@@ -0,0 +1,219 @@
+#include "nichess/nichess.hpp"
+#include "nichess/evaluation.hpp"
+#include "nichess/exchange.hpp"
+#include "nichess/util.hpp"
+#include "testboards.hpp"
+
+#include <chrono>
+#include <climits>
+#include <iostream>
+#include <random>
+
+using namespace nichess;
+
+static bool isSingleTargetAbility(ActionType type) {
+  switch(type) {
+    case ActionType::ABILITY_KING_DAMAGE:
+    case ActionType::ABILITY_MAGE_DAMAGE:
+    case ActionType::ABILITY_P1_PAWN_DAMAGE_AND_PROMOTION:
+    case ActionType::ABILITY_P2_PAWN_DAMAGE_AND_PROMOTION:
+    case ActionType::ABILITY_WARRIOR_DAMAGE:
+    case ActionType::ABILITY_ASSASSIN_DAMAGE:
+    case ActionType::ABILITY_KNIGHT_DAMAGE:
+    case ActionType::ABILITY_PAWN_DAMAGE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static int pieceExchangeValue(const Piece& p) {
+  if(p.type == P1_KING || p.type == P2_KING) return EXCHANGE_KING_VALUE;
+  return PIECE_VALUE[p.type] * p.healthPoints / STARTING_HEALTH_POINTS[p.type];
+}
+
+// The same exchange played out with makeAction.
+static int playedExchange(Game& g, int target, Player side) {
+  Piece* victim = g.board[target];
+  int victimValue = pieceExchangeValue(*victim);
+  bool victimIsKing = victim->type == P1_KING || victim->type == P2_KING;
+  int bestHit = 0;
+  PlayerAction killer;
+  int killerValue = INT_MAX;
+  std::vector<Piece*> pieces = g.playerToPieces[side];
+  for(Piece* piece: pieces) {
+    if(piece->healthPoints <= 0) continue;
+    for(const PlayerAction& action: g.legalActionsByPiece(piece)) {
+      if(action.dstIdx != target || !isSingleTargetAbility(action.actionType)) continue;
+      UndoInfo undoInfo = g.makeAction(action);
+      bool killed = victim->healthPoints <= 0;
+      int damage = pieceExchangeValue(*victim);
+      g.undoAction(undoInfo);
+      if(!killed) {
+        bestHit = std::max(bestHit, victimValue - damage);
+      } else if(pieceExchangeValue(*piece) < killerValue) {
+        killer = action;
+        killerValue = pieceExchangeValue(*piece);
+      }
+    }
+  }
+  if(killerValue == INT_MAX) return bestHit;
+  if(victimIsKing) return victimValue;
+  int attackerValue = pieceExchangeValue(*g.board[killer.srcIdx]);
+  UndoInfo undoInfo = g.makeAction(killer);
+  // A pawn reaching the last row is promoted.
+  int gain = victimValue + pieceExchangeValue(*g.board[target]) - attackerValue - playedExchange(g, target, ~side);
+  g.undoAction(undoInfo);
+  return std::max(bestHit, gain);
+}
+
+int exchangeTest1() {
+  // Undefended mage.
+  Game g1 = Game(boardString(PLAYER_1, {{0, "0-king-10"}, {63, "1-king-10"}, {24, "0-warrior-60"}, {28, "1-mage-10"}}));
+  if(damageExchange(g1, PlayerAction(24, 28, ActionType::ABILITY_WARRIOR_DAMAGE)) != PIECE_VALUE[P2_MAGE]) return -1;
+
+  // Mage takes a pawn defended by a knight.
+  Game g2 = Game(boardString(PLAYER_1, {{0, "0-king-10"}, {63, "1-king-10"}, {24, "0-mage-10"}, {28, "1-pawn-30"}, {45, "1-knight-60"}}));
+  int value = damageExchange(g2, PlayerAction(24, 28, ActionType::ABILITY_MAGE_DAMAGE));
+  if(value != PIECE_VALUE[P2_PAWN] - PIECE_VALUE[P1_MAGE] || squareExchange(g2, 28) != 0) return -1;
+
+  // The warrior behind the assassin joins once it has left its square.
+  Game g3 = Game(boardString(PLAYER_1, {{0, "0-king-10"}, {63, "1-king-10"}, {25, "0-warrior-60"}, {27, "0-assassin-10"}, {28, "1-pawn-30"},
+    {45, "1-knight-60"}}));
+  value = damageExchange(g3, PlayerAction(27, 28, ActionType::ABILITY_ASSASSIN_DAMAGE));
+  if(value != PIECE_VALUE[P2_PAWN] - (PIECE_VALUE[P1_ASSASSIN] - PIECE_VALUE[P2_KNIGHT] / 2)) return -1;
+
+  // Half a warrior isn't worth a knight.
+  Game g4 = Game(boardString(PLAYER_1, {{0, "0-king-10"}, {63, "1-king-10"}, {11, "0-knight-60"}, {28, "1-warrior-30"}, {35, "1-pawn-30"}}));
+  value = damageExchange(g4, PlayerAction(11, 28, ActionType::ABILITY_KNIGHT_DAMAGE));
+  if(value != PIECE_VALUE[P2_WARRIOR] / 2 - PIECE_VALUE[P1_KNIGHT]) return -1;
+  return 0;
+}
+
+// Random boards with one king per player and no pawns on the first and last rows.
+static std::string randomExchangeBoard(std::mt19937& rng) {
+  const char* types[] = {"mage", "warrior", "assassin", "knight", "pawn"};
+  std::vector<std::pair<int, std::string>> pieces;
+  std::vector<bool> used(NUM_SQUARES, false);
+  for(int player = 0; player < 2; player++) {
+    int square;
+    do {
+      square = rng() % NUM_SQUARES;
+    } while(used[square]);
+    used[square] = true;
+    pieces.push_back({square, std::to_string(player) + "-king-10"});
+  }
+  int numPieces = 6 + rng() % 20;
+  for(int i = 0; i < numPieces; i++) {
+    int square = rng() % NUM_SQUARES;
+    int type = rng() % 5;
+    if(used[square] || (type == 4 && (square < 8 || square >= 56))) continue;
+    used[square] = true;
+    int maxHealthPoints = STARTING_HEALTH_POINTS[type + 1] / 10;
+    int healthPoints = 10 * (1 + rng() % maxHealthPoints);
+    pieces.push_back({square, std::to_string(rng() % 2) + "-" + types[type] + "-" + std::to_string(healthPoints)});
+  }
+  return boardString(PLAYER_1, pieces);
+}
+
+// Agrees with the exchange played out with makeAction.
+int exchangeTest2() {
+  std::mt19937 rng(2);
+  int abilities = 0;
+  int losing = 0;
+  for(int i = 0; i < 2000; i++) {
+    Game g = Game(randomExchangeBoard(rng));
+    for(Player player: {PLAYER_1, PLAYER_2}) {
+      std::vector<Piece*> pieces = g.playerToPieces[player];
+      for(Piece* piece: pieces) {
+        for(const PlayerAction& action: g.legalActionsByPiece(piece)) {
+          if(!isSingleTargetAbility(action.actionType)) continue;
+          Piece victim = *g.board[action.dstIdx];
+          int attackerValue = pieceExchangeValue(*piece);
+          UndoInfo undoInfo = g.makeAction(action);
+          int expected;
+          if(victim.type == P1_KING || victim.type == P2_KING) {
+            expected = EXCHANGE_KING_VALUE;
+          } else if(g.board[action.dstIdx] != piece) {
+            expected = pieceExchangeValue(victim) - pieceExchangeValue(*g.board[action.dstIdx]);
+          } else {
+            expected = pieceExchangeValue(victim) + pieceExchangeValue(*piece) - attackerValue - playedExchange(g, action.dstIdx, ~player);
+          }
+          g.undoAction(undoInfo);
+          int value = damageExchange(g, action);
+          if(value != expected) {
+            std::cout << "action " << action.srcIdx << "-" << action.dstIdx << " expected " << expected << ", got " << value << " on\n" << g.dump() << "\n";
+            return -1;
+          }
+          abilities++;
+          if(value < 0) losing++;
+        }
+      }
+      for(int s = 0; s < NUM_SQUARES; s++) {
+        if(!pieceBelongsToPlayer(g.board[s]->type, ~player)) continue;
+        if(squareExchange(g, s) != playedExchange(g, s, player)) {
+          std::cout << "square " << s << " expected " << playedExchange(g, s, player) << ", got " << squareExchange(g, s) << " on\n" << g.dump() << "\n";
+          return -1;
+        }
+      }
+    }
+  }
+  std::cout << abilities << " abilities, " << losing << " losing\n";
+  return 0;
+}
+
+// Benchmark, exchanges per second.
+int exchangeTest3() {
+  std::mt19937 rng(3);
+  std::vector<Game> games;
+  std::vector<std::vector<PlayerAction>> abilities;
+  for(int i = 0; i < 200; i++) {
+    games.emplace_back(randomExchangeBoard(rng));
+  }
+  for(Game& g: games) {
+    abilities.emplace_back();
+    for(const PlayerAction& action: g.generateLegalActions()) {
+      if(isSingleTargetAbility(action.actionType)) abilities.back().push_back(action);
+    }
+  }
+  auto start = std::chrono::steady_clock::now();
+  uint64_t calls = 0;
+  int64_t sum = 0;
+  for(int round = 0; round < 200; round++) {
+    for(size_t i = 0; i < games.size(); i++) {
+      for(const PlayerAction& action: abilities[i]) {
+        sum += damageExchange(games[i], action);
+        calls++;
+      }
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << (uint64_t)(calls / seconds) << " exchanges per second (" << sum << ")\n";
+  return calls > 0 ? 0 : -1;
+}
+
+int exchangetest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return exchangeTest1();
+  case 2:
+    return exchangeTest2();
+  case 3:
+    return exchangeTest3();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
@@ -0,0 +1,222 @@
+#include "nichess/nichess.hpp"
+#include "nichess/gamerecord.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+using namespace nichess;
+
+class RecordTestGame {
+  public:
+    std::string start;
+    std::vector<PlayerAction> actions;
+    std::optional<Player> winner;
+    std::string end;
+};
+
+static std::string positionString(Game& g) {
+  return g.boardToString() + " " + std::to_string(g.moveNumber);
+}
+
+// Writes random games, every third one starts after some random actions.
+static std::vector<RecordTestGame> writeRandomGames(const std::string& path, std::mt19937& rng, int numGames,
+    int checkpointInterval = DEFAULT_CHECKPOINT_INTERVAL) {
+  std::vector<RecordTestGame> games;
+  GameRecordWriter writer(path);
+  writer.checkpointInterval = checkpointInterval;
+  for(int i = 0; i < numGames; i++) {
+    Game g = Game();
+    for(int ply = 0; i % 3 == 0 && ply < 10 && !g.isGameOver(); ply++) {
+      std::vector<PlayerAction> legalActions = g.generateLegalActions();
+      g.makeAction(legalActions[rng() % legalActions.size()]);
+    }
+    // Start positions need both kings.
+    if(g.isGameOver()) {
+      i--;
+      continue;
+    }
+    Game start = Game(g);
+    RecordTestGame record;
+    record.start = positionString(g);
+    for(int ply = 0; ply < 400 && !g.isGameOver(); ply++) {
+      std::vector<PlayerAction> legalActions = g.generateLegalActions();
+      if(legalActions.empty()) break;
+      record.actions.push_back(legalActions[rng() % legalActions.size()]);
+      g.makeAction(record.actions.back());
+    }
+    record.winner = g.winner();
+    record.end = positionString(g);
+    writer.addGame(start, record.actions, record.winner);
+    games.push_back(record);
+  }
+  writer.finish();
+  return games;
+}
+
+// Written games are read back and replayed to the same end.
+int gameRecordTest1() {
+  std::mt19937 rng(1);
+  std::string path = "gamerecordtest1.ngr";
+  std::vector<RecordTestGame> games = writeRandomGames(path, rng, 60);
+
+  GameRecordReader reader;
+  reader.load(path);
+  if(reader.numGames() != games.size()) return -1;
+  Game g = Game();
+  int result = 0;
+  for(size_t i = 0; i < games.size(); i++) {
+    RecordedGame recorded = reader.game(i);
+    if(recorded.numActions != games[i].actions.size() || recorded.winner != games[i].winner) result = -1;
+    size_t ply = 0;
+    recorded.replay(g, [&](const Game& position, const PlayerAction* next) {
+      if(ply == 0 && positionString(g) != games[i].start) result = -1;
+      if(next != nullptr && *next != games[i].actions[ply]) result = -1;
+      ply++;
+    });
+    if(ply != games[i].actions.size() + 1 || positionString(g) != games[i].end) result = -1;
+  }
+  std::remove(path.c_str());
+  return result;
+}
+
+static bool loadThrows(const std::string& path) {
+  GameRecordReader reader;
+  try {
+    reader.load(path);
+  } catch(const std::runtime_error& e) {
+    return true;
+  }
+  return false;
+}
+
+// Broken files are rejected, a writer that goes out of scope still finishes its file.
+int gameRecordTest2() {
+  std::string path = "gamerecordtest2.ngr";
+  {
+    GameRecordWriter writer(path);
+    writer.addGame(Game(), {}, std::nullopt);
+  }
+  GameRecordReader reader;
+  reader.load(path);
+  if(reader.numGames() != 1 || reader.game(0).numActions != 0 || reader.game(0).winner) return -1;
+
+  std::ofstream truncated(path, std::ios::binary | std::ios::trunc);
+  truncated << "NGR1";
+  truncated.close();
+  bool result = loadThrows(path) && loadThrows("doesnotexist.ngr");
+  std::remove(path.c_str());
+  return result ? 0 : -1;
+}
+
+// Benchmark, positions replayed per second.
+int gameRecordTest3() {
+  std::mt19937 rng(3);
+  std::string path = "gamerecordtest3.ngr";
+  writeRandomGames(path, rng, 300);
+
+  GameRecordReader reader;
+  reader.load(path);
+  Game g = Game();
+  size_t positions = 0;
+  auto start = std::chrono::high_resolution_clock::now();
+  for(size_t i = 0; i < reader.numGames(); i++) {
+    reader.game(i).replay(g, [&](const Game& position, const PlayerAction* next) {
+      positions++;
+    });
+  }
+  auto stop = std::chrono::high_resolution_clock::now();
+  double seconds = std::chrono::duration<double>(stop - start).count();
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  std::cout << reader.numGames() << " games, " << positions << " positions in " << file.tellg() << " bytes, " <<
+    (uint64_t)(positions / seconds) << " positions per second\n";
+  std::remove(path.c_str());
+  return positions > 0 ? 0 : -1;
+}
+
+// Positions from checkpoints are the same as replayed from the start.
+int gameRecordTest4() {
+  std::mt19937 rng(4);
+  std::string path = "gamerecordtest4.ngr";
+  for(int interval: {0, 5, DEFAULT_CHECKPOINT_INTERVAL}) {
+    std::vector<RecordTestGame> games = writeRandomGames(path, rng, 30, interval);
+    GameRecordReader reader;
+    reader.load(path);
+    Game replayed = Game();
+    Game g = Game();
+    for(size_t i = 0; i < reader.numGames(); i++) {
+      RecordedGame recorded = reader.game(i);
+      if(interval > 0 && recorded.numCheckpoints + 1 < recorded.numActions / interval) return -1;
+      recorded.startPosition(replayed);
+      for(size_t ply = 0; ply <= recorded.numActions; ply++) {
+        recorded.positionAt(ply, g);
+        if(positionString(g) != positionString(replayed)) {
+          std::cout << "interval " << interval << ", game " << i << ", ply " << ply << " differs\n";
+          return -1;
+        }
+        if(ply < recorded.numActions) replayed.makeAction(recorded.action(ply));
+      }
+    }
+  }
+
+  // Random access against replaying from the start.
+  writeRandomGames(path, rng, 200);
+  GameRecordReader reader;
+  reader.load(path);
+  std::vector<std::pair<size_t, size_t>> samples;
+  for(int i = 0; i < 2000; i++) {
+    size_t gameIndex = rng() % reader.numGames();
+    samples.push_back({gameIndex, rng() % (reader.game(gameIndex).numActions + 1)});
+  }
+  Game g = Game();
+  auto start = std::chrono::high_resolution_clock::now();
+  for(const auto& sample: samples) {
+    reader.game(sample.first).positionAt(sample.second, g);
+  }
+  auto stop = std::chrono::high_resolution_clock::now();
+  double checkpointUs = std::chrono::duration<double, std::micro>(stop - start).count() / samples.size();
+  start = std::chrono::high_resolution_clock::now();
+  for(const auto& sample: samples) {
+    RecordedGame recorded = reader.game(sample.first);
+    recorded.startPosition(g);
+    for(size_t ply = 0; ply < sample.second; ply++) {
+      g.makeAction(recorded.action(ply));
+    }
+  }
+  stop = std::chrono::high_resolution_clock::now();
+  double replayUs = std::chrono::duration<double, std::micro>(stop - start).count() / samples.size();
+  std::cout << "position from checkpoint: " << checkpointUs << " us, from start: " << replayUs << " us\n";
+  std::remove(path.c_str());
+  return 0;
+}
+
+int gamerecordtest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return gameRecordTest1();
+  case 2:
+    return gameRecordTest2();
+  case 3:
+    return gameRecordTest3();
+  case 4:
+    return gameRecordTest4();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
@@ -2,6 +2,8 @@
 #include "nichess/util.hpp"
 #include <iostream>
 #include <chrono>
+#include <random>
+#include <algorithm>
 
 using namespace nichess;
 
@@ -34,6 +36,95 @@ int legalActionsTest2() {
   }
 }
 
+// Every source and destination pair against the generated actions, over random games.
+int legalActionsTest3() {
+  std::mt19937 rng(3);
+  int numLegal = 0;
+  int numThrows = 0;
+  int numCastles = 0;
+  for(int game = 0; game < 300; game++) {
+    Game g = Game();
+    for(int ply = 0; ply < 200 && !g.isGameOver(); ply++) {
+      std::vector<PlayerAction> legalActions = g.generateLegalActions();
+      std::vector<int> expected(NUM_SQUARES * NUM_SQUARES, -1);
+      for(const PlayerAction& action: legalActions) {
+        expected[action.srcIdx * NUM_SQUARES + action.dstIdx] = (int)action.actionType;
+        if(action.actionType == ActionType::ABILITY_MAGE_THROW_ASSASSIN || action.actionType == ActionType::ABILITY_WARRIOR_THROW_WARRIOR) numThrows++;
+        if(action.actionType == ActionType::MOVE_CASTLE) numCastles++;
+      }
+      for(int src = 0; src < NUM_SQUARES; src++) {
+        for(int dst = 0; dst < NUM_SQUARES; dst++) {
+          std::optional<ActionType> actionType = g.legalActionType(src, dst);
+          int found = actionType ? (int)*actionType : -1;
+          if(found != expected[src * NUM_SQUARES + dst] || g.isActionLegal(src, dst) != (found >= 0)) {
+            std::cout << src << " -> " << dst << " expected " << expected[src * NUM_SQUARES + dst] << ", got " << found << "\n" << g.dump() << "\n";
+            return -1;
+          }
+          if(found >= 0) numLegal++;
+        }
+      }
+      for(const PlayerAction& action: legalActions) {
+        PlayerAction wrongType = PlayerAction(action.srcIdx, action.dstIdx, ActionType::SKIP);
+        if(!g.isActionLegal(action) || g.isActionLegal(wrongType)) return -1;
+      }
+      if(legalActions.empty()) break;
+      g.makeAction(legalActions[rng() % legalActions.size()]);
+    }
+  }
+  std::cout << numLegal << " legal actions, " << numThrows << " throws, " << numCastles << " castles\n";
+  if(numThrows == 0 || numCastles == 0) return -1;
+  return 0;
+}
+
+// Batch validation, compared with scanning the generated actions.
+int legalActionsTest4() {
+  std::mt19937 rng(4);
+  std::vector<Game*> positions;
+  for(int game = 0; game < 50; game++) {
+    Game g = Game();
+    for(int ply = 0; ply < 60 && !g.isGameOver(); ply++) {
+      std::vector<PlayerAction> legalActions = g.generateLegalActions();
+      if(legalActions.empty()) break;
+      g.makeAction(legalActions[rng() % legalActions.size()]);
+      positions.push_back(new Game(g));
+    }
+  }
+  std::vector<Game*> games;
+  std::vector<PlayerAction> actions;
+  for(int i = 0; i < 200000; i++) {
+    Game* g = positions[rng() % positions.size()];
+    std::vector<PlayerAction> legalActions = g->generateLegalActions();
+    PlayerAction action = legalActions[rng() % legalActions.size()];
+    if(rng() % 2) action.dstIdx = rng() % NUM_SQUARES;
+    games.push_back(g);
+    actions.push_back(action);
+  }
+
+  bool* legal = new bool[actions.size()];
+  auto start = std::chrono::high_resolution_clock::now();
+  validateActions(games.data(), actions.data(), actions.size(), legal);
+  auto stop = std::chrono::high_resolution_clock::now();
+  int result = 0;
+  int numLegal = 0;
+  auto scanStart = std::chrono::high_resolution_clock::now();
+  for(size_t i = 0; i < actions.size(); i++) {
+    std::vector<PlayerAction> legalActions = games[i]->generateLegalActions();
+    bool found = std::find(legalActions.begin(), legalActions.end(), actions[i]) != legalActions.end();
+    if(found != legal[i]) result = -1;
+    if(found) numLegal++;
+  }
+  auto scanStop = std::chrono::high_resolution_clock::now();
+  std::cout << actions.size() << " actions, " << numLegal << " legal\n";
+  std::cout << "validateActions took: " << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() << " microseconds\n";
+  std::cout << "scanning generated actions took: " << std::chrono::duration_cast<std::chrono::microseconds>(scanStop - scanStart).count() << " microseconds\n";
+
+  delete[] legal;
+  for(Game* g: positions) {
+    delete g;
+  }
+  return result;
+}
+
 int legalactionstest(int argc, char* argv[]) {
   int defaultchoice = 1;
   int choice = defaultchoice;
@@ -50,6 +141,10 @@ int legalactionstest(int argc, char* argv[]) {
     return legalActionsTest1();
   case 2:
     return legalActionsTest2();
+  case 3:
+    return legalActionsTest3();
+  case 4:
+    return legalActionsTest4();
   default:
     printf("\nInvalid test number.\n");
     return -1;
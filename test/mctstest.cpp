@@ -0,0 +1,326 @@
+#include "nichess/nichess.hpp"
+#include "nichess/mcts.hpp"
+#include "nichess/util.hpp"
+#include "testboards.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <thread>
+
+using namespace nichess;
+
+int mctsTest1() {
+  Game g = Game(kingKillBoard());
+  RandomPlayoutEvaluator evaluator;
+  MCTS mcts(&evaluator, 1 << 16, 1 << 20);
+  MCTSLimits limits;
+  limits.visits = 2000;
+  MCTSResult result = mcts.search(g, limits);
+  std::cout << "visits: " << result.visits << " value: " << result.value << "\n";
+  if(result.bestAction != PlayerAction(4, 13, ActionType::ABILITY_KING_DAMAGE) || result.value <= 0.9) return -1;
+
+  // Room for the root only, every child is evaluated by the full arena fallback. The king kill
+  // has to count as a win there, not as a draw.
+  StaticLeafEvaluator staticEvaluator;
+  MCTS full(&staticEvaluator, 1, 1 << 10);
+  result = full.search(g, limits);
+  std::vector<float> priors;
+  double expected = staticEvaluator.evaluate(g, g.generateLegalActions(), priors);
+  for(size_t i = 0; i < result.rootActions.size(); i++) {
+    UndoInfo undoInfo = g.makeAction(result.rootActions[i]);
+    double value = g.isGameOver() ? 1 : -staticEvaluator.evaluate(g, g.generateLegalActions(), priors);
+    g.undoAction(undoInfo);
+    expected += result.rootVisits[i] * value;
+  }
+  expected /= result.visits;
+  std::cout << "full arena value: " << result.value << " expected: " << expected << "\n";
+  return std::abs(result.value - expected) < 1e-3 ? 0 : -1;
+}
+
+// Search must leave the game untouched and keep working when the arena runs out.
+int mctsTest2() {
+  Game g = Game();
+  std::string before = g.boardToString();
+  StaticLeafEvaluator evaluator;
+  MCTS mcts(&evaluator, 500, 20000);
+  MCTSLimits limits;
+  limits.visits = 3000;
+  MCTSResult result = mcts.search(g, limits);
+  const MCTSArena& arena = mcts.getArena();
+  std::cout << "nodes: " << arena.numNodes << " edges: " << arena.numEdges << " memory: " << arena.memoryUsage() << " bytes\n";
+  uint64_t visitSum = 0;
+  for(uint32_t v: result.rootVisits) {
+    visitSum += v;
+  }
+  if(result.visits == 3000 && visitSum == 2999 && arena.numNodes <= 500 && arena.numEdges <= 20000 && g.boardToString() == before) {
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+int mctsTest3() {
+  std::mt19937 rng(3);
+  for(int game = 0; game < 20; game++) {
+    Game g = Game();
+    while(!g.isGameOver()) {
+      std::vector<PlayerAction> actions = g.generateLegalActions();
+      for(const PlayerAction& pa: actions) {
+        if(unpackAction(packAction(pa)) != pa) {
+          std::cout << "pack round trip failed for " << pa.srcIdx << "-" << pa.dstIdx << "\n";
+          return -1;
+        }
+      }
+      g.makeAction(actions[rng() % actions.size()]);
+    }
+  }
+  return 0;
+}
+
+// Benchmark, prints visits per second for both leaf evaluators.
+int mctsTest4() {
+  Game g = Game();
+  MCTSLimits limits;
+  limits.moveTime = 500;
+
+  RandomPlayoutEvaluator playoutEvaluator(50);
+  MCTS playoutSearch(&playoutEvaluator);
+  MCTSResult result = playoutSearch.search(g, limits);
+  std::cout << "random playout: " << result.visits << " visits, " << (int)result.visitsPerSecond << " visits/s, memory: " << playoutSearch.getArena().memoryUsage() << " bytes\n";
+
+  StaticLeafEvaluator staticEvaluator;
+  MCTS staticSearch(&staticEvaluator);
+  result = staticSearch.search(g, limits);
+  std::cout << "static: " << result.visits << " visits, " << (int)result.visitsPerSecond << " visits/s, memory: " << staticSearch.getArena().memoryUsage() << " bytes\n";
+  if(result.visits > 0 && g.boardToString() == Game().boardToString()) {
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+// Several threads on one tree.
+int mctsTest5() {
+  Game g = Game(kingKillBoard());
+  std::vector<RandomPlayoutEvaluator> evaluators;
+  for(int i = 0; i < 4; i++) {
+    evaluators.emplace_back(100, i);
+  }
+  std::vector<LeafEvaluator*> evaluatorPtrs;
+  for(RandomPlayoutEvaluator& e: evaluators) {
+    evaluatorPtrs.push_back(&e);
+  }
+  MCTS mcts(evaluatorPtrs, 1 << 16, 1 << 20);
+  MCTSLimits limits;
+  limits.visits = 2000;
+  MCTSResult result = mcts.search(g, limits);
+  std::cout << "visits: " << result.visits << " collisions: " << result.collisions << " value: " << result.value << "\n";
+  if(result.bestAction != PlayerAction(4, 13, ActionType::ABILITY_KING_DAMAGE) || result.value < 0.9) return -1;
+
+  Game start = Game();
+  limits.visits = 4000;
+  result = mcts.search(start, limits);
+  uint64_t visitSum = 0;
+  for(uint32_t v: result.rootVisits) {
+    visitSum += v;
+  }
+  std::cout << "visits: " << result.visits << " collisions: " << result.collisions << "\n";
+  if(result.visits == 4000 && visitSum == 3999 && start.boardToString() == Game().boardToString()) {
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+// Benchmark, prints visits per second and the speedup over one thread for 1 to 32 threads. Threads
+// beyond the number of cores only show the cost of contention.
+int mctsTest6() {
+  Game g = Game();
+  MCTSLimits limits;
+  limits.moveTime = 300;
+  double singleThread = 0;
+  std::cout << std::thread::hardware_concurrency() << " hardware threads\n";
+  for(int numThreads = 1; numThreads <= 32; numThreads *= 2) {
+    std::vector<StaticLeafEvaluator> evaluators(numThreads);
+    std::vector<LeafEvaluator*> evaluatorPtrs;
+    for(StaticLeafEvaluator& e: evaluators) {
+      evaluatorPtrs.push_back(&e);
+    }
+    MCTS mcts(evaluatorPtrs);
+    MCTSResult result = mcts.search(g, limits);
+    if(result.visits == 0) return -1;
+    if(numThreads == 1) {
+      singleThread = result.visitsPerSecond;
+    }
+    std::cout << numThreads << " threads: " << (int)result.visitsPerSecond << " visits/s, speedup: "
+      << result.visitsPerSecond / singleThread << ", collisions: " << result.collisions << "\n";
+  }
+  return 0;
+}
+
+// Every expanded node has one visit more than its children together, the visit that expanded it.
+static bool visitsConsistent(const MCTSArena& arena, uint32_t nodeIdx) {
+  const MCTSNode& node = arena.nodes[nodeIdx];
+  if(node.state != MCTSNodeState::EXPANDED) return true;
+  uint64_t childVisits = 0;
+  for(uint32_t i = node.firstEdge; i < node.firstEdge + node.numEdges; i++) {
+    uint32_t child = arena.edges[i].child;
+    if(child == MCTS_NULL_NODE) continue;
+    childVisits += arena.nodes[child].visits;
+    if(!visitsConsistent(arena, child)) return false;
+  }
+  return childVisits + 1 == node.visits;
+}
+
+// Tree reuse across both players' actions.
+int mctsTest7() {
+  Game g = Game();
+  StaticLeafEvaluator evaluator;
+  MCTS mcts(&evaluator, 1 << 18, 1 << 23);
+  MCTSLimits limits;
+  limits.visits = 5000;
+  uint64_t reusedTotal = 0;
+  for(int ply = 0; ply < 8; ply++) {
+    MCTSResult result = mcts.search(g, limits);
+    if(result.visits != 5000 || !visitsConsistent(mcts.getArena(), mcts.getRoot())) return -1;
+    if(ply > 0 && result.reusedVisits == 0) return -1;
+    reusedTotal += result.reusedVisits;
+    std::cout << "ply " << ply << ": reused " << result.reusedVisits << " visits, nodes: " << mcts.getArena().numNodes << "\n";
+    g.makeAction(result.bestAction);
+    mcts.advance(g, result.bestAction);
+  }
+  std::cout << "average reused visits per move: " << reusedTotal / 7 << "\n";
+
+  // A position the tree doesn't know starts over.
+  Game other = Game();
+  MCTSResult result = mcts.search(other, limits);
+  if(result.reusedVisits != 0) return -1;
+  return 0;
+}
+
+// Fixed node budget with recycling, on one and on several threads.
+int mctsTest8() {
+  for(int numThreads = 1; numThreads <= 4; numThreads *= 4) {
+    Game g = Game();
+    std::vector<StaticLeafEvaluator> evaluators(numThreads);
+    std::vector<LeafEvaluator*> evaluatorPtrs;
+    for(StaticLeafEvaluator& e: evaluators) {
+      evaluatorPtrs.push_back(&e);
+    }
+    MCTS mcts(evaluatorPtrs, 2000, 100000);
+    mcts.recycleNodes = true;
+    MCTSLimits limits;
+    limits.visits = 20000;
+    MCTSResult result = mcts.search(g, limits);
+    std::cout << numThreads << " threads: " << result.collections << " collections, " << result.prunedNodes << " pruned nodes, "
+      << (int)result.pruneRate << " pruned nodes/s, memory used: " << result.memoryUsage << " reserved: " << result.memoryReserved << " bytes\n";
+    std::vector<PlayerAction> legalActions = g.generateLegalActions();
+    bool legal = std::find(legalActions.begin(), legalActions.end(), result.bestAction) != legalActions.end();
+    if(result.visits != 20000 || result.collections == 0 || mcts.getArena().numNodes > 2000 || !legal || g.boardToString() != Game().boardToString()) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// Every expanded node of the graph has one visit more than its edges together.
+static bool edgeVisitsConsistent(const MCTSArena& arena, uint32_t rootIdx) {
+  std::vector<bool> seen(arena.numNodes, false);
+  std::vector<uint32_t> stack{rootIdx};
+  seen[rootIdx] = true;
+  while(!stack.empty()) {
+    const MCTSNode& node = arena.nodes[stack.back()];
+    stack.pop_back();
+    if(node.state != MCTSNodeState::EXPANDED) continue;
+    uint64_t edgeVisits = 0;
+    for(uint32_t i = node.firstEdge; i < node.firstEdge + node.numEdges; i++) {
+      edgeVisits += arena.edges[i].visits;
+      uint32_t child = arena.edges[i].child;
+      if(child != MCTS_NULL_NODE && !seen[child]) {
+        seen[child] = true;
+        stack.push_back(child);
+      }
+    }
+    if(edgeVisits + 1 != node.visits) return false;
+  }
+  return true;
+}
+
+// Transpositions share nodes.
+int mctsTest9() {
+  Game g = Game();
+  MCTSLimits limits;
+  limits.visits = 20000;
+  uint32_t treeNodes = 0;
+  for(int numThreads = 1; numThreads <= 4; numThreads *= 4) {
+    for(bool useTranspositions: {false, true}) {
+      std::vector<StaticLeafEvaluator> evaluators(numThreads);
+      std::vector<LeafEvaluator*> evaluatorPtrs;
+      for(StaticLeafEvaluator& e: evaluators) {
+        evaluatorPtrs.push_back(&e);
+      }
+      MCTS mcts(evaluatorPtrs, 1 << 18, 1 << 23);
+      mcts.useTranspositions = useTranspositions;
+      MCTSResult result = mcts.search(g, limits);
+      uint32_t nodes = mcts.getArena().numNodes;
+      std::cout << numThreads << " threads, " << (useTranspositions ? "graph" : "tree") << ": " << nodes << " nodes, "
+        << (int)result.visitsPerSecond << " visits/s\n";
+      if(result.visits != 20000 || !edgeVisitsConsistent(mcts.getArena(), mcts.getRoot()) || g.boardToString() != Game().boardToString()) {
+        return -1;
+      }
+      if(!useTranspositions) {
+        treeNodes = nodes;
+      } else if(nodes >= treeNodes) {
+        return -1;
+      }
+
+      // Reuse keeps the table in sync with the arena.
+      Game next = Game();
+      next.makeAction(result.bestAction);
+      mcts.advance(next, result.bestAction);
+      result = mcts.search(next, limits);
+      if(result.reusedVisits == 0 || !edgeVisitsConsistent(mcts.getArena(), mcts.getRoot())) return -1;
+    }
+  }
+  return 0;
+}
+
+int mctstest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return mctsTest1();
+  case 2:
+    return mctsTest2();
+  case 3:
+    return mctsTest3();
+  case 4:
+    return mctsTest4();
+  case 5:
+    return mctsTest5();
+  case 6:
+    return mctsTest6();
+  case 7:
+    return mctsTest7();
+  case 8:
+    return mctsTest8();
+  case 9:
+    return mctsTest9();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
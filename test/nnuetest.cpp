@@ -0,0 +1,159 @@
+#include "nichess/nichess.hpp"
+#include "nichess/nnue.hpp"
+#include "nichess/search.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+using namespace nichess;
+
+static void writeRandomNetwork(const std::string& path) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> small(-20, 20);
+  std::vector<int16_t> featureBias(NNUE_HIDDEN_SIZE);
+  std::vector<int16_t> featureWeights((size_t)NNUE_NUM_FEATURES * NNUE_HIDDEN_SIZE);
+  std::vector<int16_t> outputWeights(2 * NNUE_HIDDEN_SIZE);
+  for(auto& w: featureBias) w = small(rng);
+  for(auto& w: featureWeights) w = small(rng);
+  for(auto& w: outputWeights) w = small(rng) * 10;
+  NNUENetwork::write(path, featureBias, featureWeights, outputWeights, 3);
+}
+
+// The file is removed once it's mapped.
+static void loadRandomNetwork(NNUENetwork& network) {
+  std::string path = (std::filesystem::temp_directory_path() / "nnuetest.bin").string();
+  writeRandomNetwork(path);
+  network.load(path);
+  std::remove(path.c_str());
+}
+
+bool sameValues(const NNUEAccumulator& a, const NNUEAccumulator& b) {
+  return std::memcmp(a.values, b.values, sizeof(a.values)) == 0;
+}
+
+// Incremental updates match a refresh after every makeAction and undoAction.
+int nnueTest1() {
+  NNUENetwork network;
+  loadRandomNetwork(network);
+  std::mt19937 rng(7);
+  for(int game = 0; game < 20; game++) {
+    Game g = Game();
+    NNUEAccumulator incremental(network);
+    NNUEAccumulator fresh(network);
+    g.addSquareObserver(&incremental);
+    std::vector<UndoInfo> undoStack;
+    while(!g.isGameOver()) {
+      std::vector<PlayerAction> legalActions = g.generateLegalActions();
+      if(legalActions.empty()) break;
+      undoStack.push_back(g.makeAction(legalActions[rng() % legalActions.size()]));
+      fresh.refresh(g);
+      if(!sameValues(incremental, fresh)) {
+        std::cout << "mismatch after makeAction, game " << game << " move " << g.moveNumber << "\n";
+        return -1;
+      }
+    }
+    while(!undoStack.empty()) {
+      g.undoAction(undoStack.back());
+      undoStack.pop_back();
+      fresh.refresh(g);
+      if(!sameValues(incremental, fresh)) {
+        std::cout << "mismatch after undoAction, game " << game << " move " << g.moveNumber << "\n";
+        return -1;
+      }
+    }
+    g.removeSquareObserver(&incremental);
+  }
+  return 0;
+}
+
+// All supported kernels compute the same output.
+int nnueTest2() {
+  NNUENetwork network;
+  loadRandomNetwork(network);
+  NNUEKernel original = getNNUEKernel();
+  Game g = Game();
+  g.makeAction(PlayerAction(12, 28, ActionType::MOVE_REGULAR));
+  g.makeAction(PlayerAction(51, 35, ActionType::MOVE_REGULAR));
+  g.makeAction(PlayerAction(28, 35, ActionType::ABILITY_PAWN_DAMAGE));
+
+  NNUEKernel kernels[] = {NNUEKernel::SCALAR, NNUEKernel::AVX2, NNUEKernel::AVX512};
+  int expected = 0;
+  bool ok = true;
+  for(int i = 0; i < 3; i++) {
+    if(!setNNUEKernel(kernels[i])) {
+      std::cout << "kernel " << i << " not supported\n";
+      continue;
+    }
+    NNUEAccumulator acc(network);
+    acc.refresh(g);
+    int out = acc.output(g.currentPlayer);
+    std::cout << "kernel " << i << " output " << out << "\n";
+    if(i == 0) {
+      expected = out;
+    } else if(out != expected) {
+      ok = false;
+    }
+  }
+  setNNUEKernel(original);
+  return ok ? 0 : -1;
+}
+
+// Used as the evaluator of the alpha-beta search.
+int nnueTest3() {
+  NNUENetwork network;
+  loadRandomNetwork(network);
+  NNUEEvaluator evaluator(network);
+  AlphaBetaSearch search(&evaluator);
+  Game g = Game();
+  std::string before = g.boardToString();
+  SearchLimits limits;
+  limits.depth = 3;
+  SearchResult result = search.search(g, limits);
+  std::cout << "score: " << result.score << " nodes: " << result.nodes << "\n";
+  if(result.depth == 3 && g.boardToString() == before && g.squareObservers.empty()) {
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+int nnueTest4() {
+  try {
+    NNUENetwork network("does_not_exist.bin");
+  } catch(const std::runtime_error& e) {
+    return 0;
+  }
+  return -1;
+}
+
+int nnuetest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return nnueTest1();
+  case 2:
+    return nnueTest2();
+  case 3:
+    return nnueTest3();
+  case 4:
+    return nnueTest4();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
@@ -1,6 +1,10 @@
 #include "nichess/nichess.hpp"
 #include "nichess/util.hpp"
 
+#include <chrono>
+#include <iostream>
+#include <random>
+
 using namespace nichess;
 
 int copyTest1() {
@@ -133,6 +137,96 @@ int zobristTest7() {
   }
 }
 
+// Counts the other player's actions that damage player's king by playing them.
+static int bruteForceKingThreats(Game& g, Player player) {
+  int count = 0;
+  Piece* king = g.playerToKing[player];
+  int healthPoints = king->healthPoints;
+  std::vector<Piece*> attackers = g.playerToPieces[~player];
+  for(Piece* piece: attackers) {
+    if(piece->healthPoints <= 0) continue;
+    for(const PlayerAction& action: g.legalActionsByPiece(piece)) {
+      UndoInfo undoInfo = g.makeAction(action);
+      if(king->healthPoints < healthPoints) count++;
+      g.undoAction(undoInfo);
+    }
+  }
+  return count;
+}
+
+// Random pieces with one king per player and no pawns on the first and last rows.
+static std::string randomThreatBoard(std::mt19937& rng) {
+  const char* types[] = {"mage", "warrior", "assassin", "knight", "pawn"};
+  const int healthPoints[] = {MAGE_STARTING_HEALTH_POINTS, WARRIOR_STARTING_HEALTH_POINTS, ASSASSIN_STARTING_HEALTH_POINTS,
+    KNIGHT_STARTING_HEALTH_POINTS, PAWN_STARTING_HEALTH_POINTS};
+  std::vector<std::string> squares(NUM_SQUARES, "empty");
+  int p1King = rng() % NUM_SQUARES;
+  int p2King;
+  do {
+    p2King = rng() % NUM_SQUARES;
+  } while(p2King == p1King);
+  squares[p1King] = "0-king-10";
+  squares[p2King] = "1-king-10";
+  int numPieces = 4 + rng() % 20;
+  for(int i = 0; i < numPieces; i++) {
+    int square = rng() % NUM_SQUARES;
+    int type = rng() % 5;
+    if(squares[square] != "empty" || (type == 4 && (square < 8 || square >= 56))) continue;
+    squares[square] = std::to_string(rng() % 2) + "-" + types[type] + "-" + std::to_string(healthPoints[type]);
+  }
+  std::string retval = "0|";
+  for(const std::string& square: squares) {
+    retval += square + ",";
+  }
+  return retval;
+}
+
+// Threats by reverse lookup match the actions that damage the king.
+int kingThreatTest8() {
+  std::mt19937 rng(8);
+  std::vector<Game> positions;
+  for(int i = 0; i < 3000; i++) {
+    positions.emplace_back(randomThreatBoard(rng));
+  }
+  for(int game = 0; game < 50; game++) {
+    Game g = Game();
+    while(!g.isGameOver()) {
+      positions.emplace_back(g);
+      std::vector<PlayerAction> actions = g.generateLegalActions();
+      if(actions.empty()) break;
+      g.makeAction(actions[rng() % actions.size()]);
+    }
+  }
+  int threatened = 0;
+  for(Game& g: positions) {
+    for(Player player: {PLAYER_1, PLAYER_2}) {
+      int expected = bruteForceKingThreats(g, player);
+      if(g.kingThreatCount(player) != expected || g.isKingThreatened(player) != (expected > 0)) {
+        std::cout << "player " << player << " expected " << expected << " threats, got " << g.kingThreatCount(player) << " on\n" << g.dump() << "\n";
+        return -1;
+      }
+      if(expected > 0) threatened++;
+    }
+  }
+  std::cout << threatened << " threatened kings in " << 2 * positions.size() << "\n";
+
+  auto start = std::chrono::steady_clock::now();
+  int sum = 0;
+  for(Game& g: positions) {
+    sum += g.isKingThreatened(g.currentPlayer);
+  }
+  auto middle = std::chrono::steady_clock::now();
+  for(Game& g: positions) {
+    g.currentPlayer = ~g.currentPlayer;
+    sum += g.generateLegalActions().size();
+    g.currentPlayer = ~g.currentPlayer;
+  }
+  auto end = std::chrono::steady_clock::now();
+  std::cout << "isKingThreatened: " << std::chrono::duration_cast<std::chrono::microseconds>(middle - start).count() << " us, generateLegalActions: "
+    << std::chrono::duration_cast<std::chrono::microseconds>(end - middle).count() << " us (" << sum << ")\n";
+  return threatened > 0 ? 0 : -1;
+}
+
 int othertest(int argc, char* argv[]) {
   int defaultchoice = 1;
   int choice = defaultchoice;
@@ -159,6 +253,8 @@ int othertest(int argc, char* argv[]) {
     return zobristDrawTest6();
   case 7:
     return zobristTest7();
+  case 8:
+    return kingThreatTest8();
   default:
     printf("\nInvalid test number.\n");
     return -1;
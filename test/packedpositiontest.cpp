@@ -0,0 +1,181 @@
+#include "nichess/nichess.hpp"
+#include "nichess/packedposition.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+using namespace nichess;
+
+static std::vector<PackedAction> sortedActions(Game& g) {
+  std::vector<PackedAction> actions;
+  for(const PlayerAction& action: g.generateLegalActions()) {
+    actions.push_back(packAction(action));
+  }
+  std::sort(actions.begin(), actions.end());
+  return actions;
+}
+
+static std::vector<Game*> randomPositions(std::mt19937& rng, int numGames) {
+  std::vector<Game*> positions;
+  for(int game = 0; game < numGames; game++) {
+    Game g = Game();
+    for(int ply = 0; ply < 300 && !g.isGameOver(); ply++) {
+      std::vector<PlayerAction> legalActions = g.generateLegalActions();
+      if(legalActions.empty()) break;
+      g.makeAction(legalActions[rng() % legalActions.size()]);
+      // Positions without a king can't be set up.
+      if(g.isGameOver()) break;
+      positions.push_back(new Game(g));
+    }
+  }
+  return positions;
+}
+
+// Round trip through random games.
+int packedPositionTest1() {
+  Game start = Game();
+  uint8_t buffer[MAX_PACKED_POSITION_SIZE];
+  if(packPosition(start, buffer) != 58) return -1;
+
+  std::mt19937 rng(1);
+  std::vector<Game*> positions = randomPositions(rng, 50);
+  Game unpacked = Game();
+  size_t totalSize = 0;
+  int result = 0;
+  for(Game* g: positions) {
+    size_t size = packPosition(*g, buffer);
+    totalSize += size;
+    if(packedPositionSize(buffer, size) != size || unpackPosition(buffer, size, unpacked) != size) result = -1;
+    uint8_t repacked[MAX_PACKED_POSITION_SIZE];
+    if(packPosition(unpacked, repacked) != size || !std::equal(buffer, buffer + size, repacked)) result = -1;
+    if(unpacked.boardToString() != g->boardToString() || unpacked.moveNumber != g->moveNumber ||
+        unpacked.currentPlayer != g->currentPlayer || unpacked.zobristHash() != g->zobristHash() ||
+        !(unpacked.evalAccumulator == g->evalAccumulator) || sortedActions(unpacked) != sortedActions(*g)) {
+      std::cout << "round trip differs for\n" << g->dump() << "\n";
+      result = -1;
+    }
+    if(result != 0) break;
+  }
+  std::cout << positions.size() << " positions, " << (double)totalSize / positions.size() << " bytes on average\n";
+  for(Game* g: positions) {
+    delete g;
+  }
+  return result;
+}
+
+static bool unpackThrows(const uint8_t* in, size_t size) {
+  Game g = Game();
+  try {
+    unpackPosition(in, size, g);
+  } catch(const std::runtime_error& e) {
+    return g.boardToString() == Game().boardToString();
+  }
+  return false;
+}
+
+// Malformed input is rejected and leaves the game as it was.
+int packedPositionTest2() {
+  Game g = Game();
+  uint8_t buffer[MAX_PACKED_POSITION_SIZE];
+  size_t size = packPosition(g, buffer);
+  if(!unpackThrows(buffer, size - 1) || !unpackThrows(buffer, 5)) return -1;
+
+  uint8_t invalidType[MAX_PACKED_POSITION_SIZE];
+  std::copy(buffer, buffer + size, invalidType);
+  invalidType[10] = 0xFF;
+  if(!unpackThrows(invalidType, size)) return -1;
+
+  // Two P1 kings.
+  uint8_t twoKings[MAX_PACKED_POSITION_SIZE];
+  std::copy(buffer, buffer + size, twoKings);
+  for(int n = 0; n < 32; n++) {
+    if(((twoKings[10 + n / 2] >> (4 * (n % 2))) & 0xF) == P2_KING) {
+      twoKings[10 + n / 2] ^= (P2_KING ^ P1_KING) << (4 * (n % 2));
+    }
+  }
+  if(!unpackThrows(twoKings, size)) return -1;
+  return 0;
+}
+
+// Benchmark.
+int packedPositionTest3() {
+  std::mt19937 rng(3);
+  // One game's positions in order, the way they are stored.
+  std::vector<Game*> positions = randomPositions(rng, 1);
+  std::vector<uint8_t> packed(positions.size() * MAX_PACKED_POSITION_SIZE);
+  std::vector<size_t> offsets;
+  const int rounds = 1000;
+
+  auto start = std::chrono::high_resolution_clock::now();
+  for(int round = 0; round < rounds; round++) {
+    offsets.clear();
+    size_t offset = 0;
+    for(Game* g: positions) {
+      offsets.push_back(offset);
+      offset += packPosition(*g, packed.data() + offset);
+    }
+  }
+  auto stop = std::chrono::high_resolution_clock::now();
+  double packNs = std::chrono::duration<double, std::nano>(stop - start).count() / (rounds * positions.size());
+
+  Game g = Game();
+  uint64_t checksum = 0;
+  start = std::chrono::high_resolution_clock::now();
+  for(int round = 0; round < rounds; round++) {
+    for(size_t offset: offsets) {
+      unpackPosition(packed.data() + offset, MAX_PACKED_POSITION_SIZE, g);
+      checksum += g.moveNumber;
+    }
+  }
+  stop = std::chrono::high_resolution_clock::now();
+  double unpackNs = std::chrono::duration<double, std::nano>(stop - start).count() / (rounds * positions.size());
+
+  Piece squares[NUM_SQUARES];
+  Player player;
+  int moveNumber;
+  start = std::chrono::high_resolution_clock::now();
+  for(int round = 0; round < rounds; round++) {
+    for(size_t offset: offsets) {
+      unpackSquares(packed.data() + offset, MAX_PACKED_POSITION_SIZE, squares, player, moveNumber);
+      checksum += squares[moveNumber % NUM_SQUARES].healthPoints;
+    }
+  }
+  stop = std::chrono::high_resolution_clock::now();
+  double unpackSquaresNs = std::chrono::duration<double, std::nano>(stop - start).count() / (rounds * positions.size());
+
+  std::cout << "pack: " << packNs << " ns, unpack: " << unpackNs << " ns, unpack squares only: " << unpackSquaresNs <<
+    " ns per position (" << checksum << ")\n";
+  for(Game* p: positions) {
+    delete p;
+  }
+  return 0;
+}
+
+int packedpositiontest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return packedPositionTest1();
+  case 2:
+    return packedPositionTest2();
+  case 3:
+    return packedPositionTest3();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
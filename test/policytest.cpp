@@ -0,0 +1,130 @@
+#include "nichess/nichess.hpp"
+#include "nichess/policy.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+
+using namespace nichess;
+
+// Policy indices map back to the same legal actions, encoded visits decode to their fractions.
+int policyTest1() {
+  std::mt19937 rng(1);
+  std::vector<uint8_t> buffer;
+  std::vector<uint16_t> indices;
+  std::vector<float> fractions;
+  std::vector<float> dense(POLICY_SIZE);
+  for(int i = 0; i < 50; i++) {
+    Game g = Game();
+    for(int ply = 0; ply < 60 && !g.isGameOver(); ply++) {
+      std::vector<PlayerAction> actions = g.generateLegalActions();
+      std::vector<uint32_t> visits(actions.size());
+      uint64_t total = 0;
+      for(size_t j = 0; j < actions.size(); j++) {
+        std::optional<PlayerAction> action = policyAction(g, policyIndex(actions[j]));
+        if(!action || packAction(*action) != packAction(actions[j])) return -1;
+        // Many actions without visits, a few with many.
+        visits[j] = rng() % 3 == 0 ? rng() % 1000 : 0;
+        total += visits[j];
+      }
+      buffer.resize(maxSparsePolicySize(actions.size()));
+      size_t size = encodeSparsePolicy(actions.data(), visits.data(), actions.size(), buffer.data());
+      if(sparsePolicySize(buffer.data(), buffer.size()) != size || sparsePolicySize(buffer.data(), size - 1) != 0) return -1;
+      size_t length = sparsePolicyLength(buffer.data());
+      indices.resize(length);
+      fractions.resize(length);
+      if(decodeSparsePolicy(buffer.data(), indices.data(), fractions.data()) != length) return -1;
+      const uint8_t* policies[] = {buffer.data()};
+      expandSparsePolicies(policies, 1, dense.data());
+      size_t k = 0;
+      for(size_t j = 0; j < actions.size(); j++) {
+        float expected = total > 0 ? (float)visits[j] / total : 0;
+        float value = dense[policyIndex(actions[j])];
+        if(std::abs(value - expected) > 2.0f / POLICY_WEIGHT_SCALE) return -1;
+        if(value == 0) continue;
+        if(k >= length || indices[k] != policyIndex(actions[j]) || fractions[k] != value) return -1;
+        k++;
+      }
+      if(k != length) return -1;
+      g.makeAction(actions[rng() % actions.size()]);
+    }
+  }
+  Game start = Game();
+  if(policyAction(start, policyIndex(PlayerAction(0, 63, ActionType::MOVE_REGULAR))) || policyAction(start, POLICY_SIZE)) return -1;
+  return 0;
+}
+
+// Benchmark, policies encoded and expanded per second.
+int policyTest2() {
+  std::mt19937 rng(2);
+  std::vector<std::vector<PlayerAction>> actions;
+  std::vector<std::vector<uint32_t>> visits;
+  std::unique_ptr<Game> g = std::make_unique<Game>();
+  while(actions.size() < 256) {
+    std::vector<PlayerAction> legalActions = g->generateLegalActions();
+    if(g->isGameOver() || g->isGameDraw() || legalActions.empty()) {
+      g = std::make_unique<Game>();
+      continue;
+    }
+    actions.push_back(legalActions);
+    visits.emplace_back();
+    for(size_t i = 0; i < legalActions.size(); i++) {
+      visits.back().push_back(rng() % 2 == 0 ? rng() % 200 : 0);
+    }
+    g->makeAction(legalActions[rng() % legalActions.size()]);
+  }
+  std::vector<uint8_t> buffer(actions.size() * maxSparsePolicySize(256));
+  std::vector<const uint8_t*> policies(actions.size());
+  size_t bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  int rounds = 2000;
+  for(int round = 0; round < rounds; round++) {
+    uint8_t* out = buffer.data();
+    for(size_t i = 0; i < actions.size(); i++) {
+      policies[i] = out;
+      out += encodeSparsePolicy(actions[i].data(), visits[i].data(), actions[i].size(), out);
+    }
+    bytes = out - buffer.data();
+  }
+  double encodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::vector<float> dense(actions.size() * POLICY_SIZE);
+  start = std::chrono::steady_clock::now();
+  rounds = 50;
+  float sum = 0;
+  for(int round = 0; round < rounds; round++) {
+    expandSparsePolicies(policies.data(), policies.size(), dense.data());
+    sum += dense[round];
+  }
+  double expandSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << (uint64_t)(2000 * actions.size() / encodeSeconds) << " encodes per second, "
+    << (uint64_t)(rounds * actions.size() / expandSeconds) << " dense rows per second, "
+    << (double)bytes / actions.size() << " bytes per policy (" << sum << ")\n";
+  return 0;
+}
+
+int policytest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return policyTest1();
+  case 2:
+    return policyTest2();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
@@ -0,0 +1,245 @@
+#include "nichess/nichess.hpp"
+#include "nichess/packedposition.hpp"
+#include "nichess/positiondb.hpp"
+#include "nichess/selfplay.hpp"
+#include "nichess/symmetry.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+using namespace nichess;
+
+class PositionCounts {
+  public:
+    uint32_t wins = 0;
+    uint32_t draws = 0;
+    uint32_t losses = 0;
+};
+
+using KeyPair = std::pair<uint64_t, uint64_t>;
+
+static PositionKey randomKey(std::mt19937_64& rng, int numKeys) {
+  // Few distinct keys so that they repeat.
+  uint64_t k = rng() % numKeys;
+  PositionKey key;
+  key.key1 = k * 0x9E37'79B9'7F4A'7C15ULL;
+  key.key2 = (k + 1) * 0xD6E8'FEB8'6659'FD93ULL;
+  return key;
+}
+
+static bool matches(const PositionDatabase& db, const std::map<KeyPair, PositionCounts>& expected) {
+  if(db.size() != expected.size()) return false;
+  for(const auto& [k, counts]: expected) {
+    PositionKey key;
+    key.key1 = k.first;
+    key.key2 = k.second;
+    const PositionEntry* entry = db.find(key);
+    if(entry == nullptr || entry->wins != counts.wins || entry->draws != counts.draws || entry->losses != counts.losses) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Single adds, batches and merges against a std::map while the table grows, then reopened.
+int positiondbTest1() {
+  std::mt19937_64 rng(1);
+  std::map<KeyPair, PositionCounts> expected;
+  PositionDatabase db;
+  db.create("positiondbtest1.db", 4);
+  for(int i = 0; i < 5000; i++) {
+    PositionKey key = randomKey(rng, 3000);
+    int outcome = (int)(rng() % 3) - 1;
+    db.add(key, outcome);
+    PositionCounts& counts = expected[{key.key1, key.key2}];
+    counts.wins += outcome > 0;
+    counts.draws += outcome == 0;
+    counts.losses += outcome < 0;
+  }
+  if(!matches(db, expected) || db.size() > db.maxLoad * db.capacity()) return -1;
+
+  std::vector<PositionEntry> batch;
+  for(int i = 0; i < 20000; i++) {
+    PositionEntry entry;
+    entry.key = randomKey(rng, 10000);
+    entry.wins = rng() % 3;
+    entry.draws = rng() % 3;
+    entry.losses = rng() % 3;
+    entry.reserved = 0;
+    batch.push_back(entry);
+    PositionCounts& counts = expected[{entry.key.key1, entry.key.key2}];
+    counts.wins += entry.wins;
+    counts.draws += entry.draws;
+    counts.losses += entry.losses;
+  }
+  db.insertBatch(batch);
+  if(!matches(db, expected)) return -1;
+
+  PositionDatabase other;
+  other.create("positiondbtest1-other.db", 16);
+  for(int i = 0; i < 3000; i++) {
+    PositionKey key = randomKey(rng, 20000);
+    other.add(key, 1);
+    expected[{key.key1, key.key2}].wins++;
+  }
+  db.merge(other);
+  other.close();
+  std::remove("positiondbtest1-other.db");
+  if(!matches(db, expected)) return -1;
+
+  uint64_t capacity = db.capacity();
+  db.close();
+  if(db.find(randomKey(rng, 1)) != nullptr) return -1;
+  PositionDatabase reopened;
+  reopened.open("positiondbtest1.db");
+  bool ok = reopened.capacity() == capacity && matches(reopened, expected);
+  reopened.close();
+  std::cout << expected.size() << " positions in " << capacity << " slots\n";
+
+  // Not a position database.
+  FILE* f = std::fopen("positiondbtest1.db", "r+b");
+  std::fputc('X', f);
+  std::fclose(f);
+  try {
+    reopened.open("positiondbtest1.db");
+    ok = false;
+  } catch(const std::runtime_error& e) {
+  }
+  std::remove("positiondbtest1.db");
+  return ok ? 0 : -1;
+}
+
+// A parallel build from self-play shards counts every sample, mirror images as one position.
+int positiondbTest2() {
+  SelfPlayConfig config;
+  config.engine = SelfPlayEngine::RANDOM;
+  config.numThreads = 2;
+  config.numGames = 60;
+  config.shardPrefix = "positiondbtest2";
+  config.blockSize = 4096;
+  config.shardSize = 16384;
+  SelfPlay selfPlay(config);
+  selfPlay.run();
+  std::vector<std::string> shards = selfPlay.shards();
+
+  std::map<KeyPair, PositionCounts> expected;
+  SelfPlaySample sample;
+  Piece squares[NUM_SQUARES];
+  Piece mirrored[NUM_SQUARES];
+  Player player;
+  int moveNumber;
+  bool ok = true;
+  int mirrorsChecked = 0;
+  for(const std::string& path: shards) {
+    SelfPlayShardReader reader;
+    reader.load(path);
+    while(reader.next(sample)) {
+      unpackSquares(sample.position, MAX_PACKED_POSITION_SIZE, squares, player, moveNumber);
+      PositionKey key = positionKey(squares, player);
+      PositionCounts& counts = expected[{key.key1, key.key2}];
+      counts.wins += sample.outcome > 0;
+      counts.draws += sample.outcome == 0;
+      counts.losses += sample.outcome < 0;
+
+      mirrorSquares(squares, mirrored);
+      PositionKey mirroredKey = positionKey(mirrored, player);
+      bool exact = canonicalKey(squares, player).key == canonicalKey(mirrored, player).key;
+      if(exact) {
+        if(!(mirroredKey == key)) ok = false;
+        mirrorsChecked++;
+      } else if(mirroredKey.key1 == key.key1) {
+        ok = false;
+      }
+    }
+  }
+
+  // Random games hardly ever get rid of every warrior and pawn.
+  Game g = Game("0|0-king-10,empty,empty,0-mage-10,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,"
+    "empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,"
+    "empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,"
+    "empty,empty,empty,empty,empty,empty,1-assassin-10,empty,empty,empty,empty,empty,empty,empty,empty,1-king-10,");
+  Game m = Game(g);
+  mirrorGame(m);
+  if(!(positionKey(g) == positionKey(m)) || positionKey(g).key1 != canonicalKey(g).key) ok = false;
+  m.makeAction(m.generateLegalActions()[0]);
+  if(positionKey(g) == positionKey(m)) ok = false;
+
+  PositionDatabase db;
+  db.create("positiondbtest2.db", 16);
+  db.build(shards, 3);
+  ok = ok && matches(db, expected);
+  db.close();
+
+  // Built once more into a table that doesn't need to grow.
+  PositionDatabase large;
+  large.create("positiondbtest2.db", 4 * expected.size());
+  large.build(shards, 4);
+  ok = ok && matches(large, expected);
+  large.close();
+
+  std::remove("positiondbtest2.db");
+  for(const std::string& path: shards) {
+    std::remove(path.c_str());
+  }
+  std::cout << shards.size() << " shards, " << expected.size() << " positions, " << mirrorsChecked << " with equivalent mirror images\n";
+  return ok && shards.size() > 3 ? 0 : -1;
+}
+
+// Benchmark, batches of random keys.
+int positiondbTest3() {
+  std::mt19937_64 rng(3);
+  const int numBatches = 20;
+  const int batchSize = 1 << 18;
+  PositionDatabase db;
+  db.create("positiondbtest3.db", 1 << 10);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<PositionEntry> batch(batchSize);
+  for(int b = 0; b < numBatches; b++) {
+    for(PositionEntry& entry: batch) {
+      entry.key = randomKey(rng, 1 << 22);
+      entry.wins = 1;
+      entry.draws = 0;
+      entry.losses = 0;
+      entry.reserved = 0;
+    }
+    db.insertBatch(batch);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << (uint64_t)(numBatches * batchSize / seconds) << " inserts per second, " << db.size() << " positions in "
+    << db.capacity() << " slots\n";
+  db.close();
+  std::remove("positiondbtest3.db");
+  return 0;
+}
+
+int positiondbtest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return positiondbTest1();
+  case 2:
+    return positiondbTest2();
+  case 3:
+    return positiondbTest3();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
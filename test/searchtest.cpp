@@ -0,0 +1,135 @@
+#include "nichess/nichess.hpp"
+#include "nichess/search.hpp"
+#include "nichess/util.hpp"
+#include "testboards.hpp"
+
+#include <iostream>
+#include <chrono>
+#include <thread>
+
+using namespace nichess;
+
+int searchTest1() {
+  Game g = Game(kingKillBoard());
+  AlphaBetaSearch search;
+  SearchLimits limits;
+  limits.depth = 4;
+  SearchResult result = search.search(g, limits);
+  std::cout << "score: " << result.score << " depth: " << result.depth << "\n";
+  if(result.bestAction == PlayerAction(4, 13, ActionType::ABILITY_KING_DAMAGE) && result.score >= MATE_BOUND) {
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+// Hard deadline has to be respected even when the depth limit can't be reached.
+int searchTest2() {
+  Game g = Game();
+  AlphaBetaSearch search;
+  SearchLimits limits;
+  limits.hardDeadline = 50;
+  SearchResult result = search.search(g, limits);
+  std::cout << "elapsed: " << result.elapsed << " microseconds, depth: " << result.depth << "\n";
+  if(result.stopped && result.elapsed <= 51000 && result.depth > 0) {
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+// Stop flag set from another thread.
+int searchTest3() {
+  Game g = Game();
+  AlphaBetaSearch search;
+  SearchLimits limits;
+  SearchResult result;
+  std::thread searchThread([&]() { result = search.search(g, limits); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  auto stopTime = std::chrono::steady_clock::now();
+  search.stop();
+  searchThread.join();
+  auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - stopTime);
+  std::cout << "stop latency: " << latency.count() << " microseconds\n";
+  // The search must leave the game untouched.
+  if(!result.stopped || latency.count() > 1000 || g.boardToString() != Game().boardToString()) return -1;
+
+  // A stop that arrives after a search finished doesn't shorten the next one.
+  limits.depth = 2;
+  result = search.search(g, limits);
+  if(result.stopped) return -1;
+  search.stop();
+  limits.depth = 4;
+  result = search.search(g, limits);
+  std::cout << "after a late stop: depth " << result.depth << ", " << result.nodes << " nodes\n";
+  if(result.stopped || result.depth != 4) return -1;
+  return 0;
+}
+
+int searchTest4() {
+  Game g = Game();
+  AlphaBetaSearch search;
+  SearchLimits limits;
+  limits.nodes = 5000;
+  SearchResult result = search.search(g, limits);
+  std::cout << "nodes: " << result.nodes << "\n";
+  if(result.stopped && result.nodes <= 5000) {
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+int searchTest5() {
+  Game g = Game();
+  AlphaBetaSearch search;
+  int lastDepth = 0;
+  bool ok = true;
+  search.infoCallback = [&](const SearchInfo& info) {
+    std::cout << "depth " << info.depth << " score " << info.score << " nodes " << info.nodes << " nps " << info.nps << " pv";
+    for(const PlayerAction& pa: info.pv) {
+      std::cout << " " << pa.srcIdx << "-" << pa.dstIdx;
+    }
+    std::cout << "\n";
+    if(info.depth != lastDepth + 1 || (int)info.pv.size() != info.depth) ok = false;
+    lastDepth = info.depth;
+  };
+  SearchLimits limits;
+  limits.depth = 4;
+  search.search(g, limits);
+  if(ok && lastDepth == 4) {
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+int searchtest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return searchTest1();
+  case 2:
+    return searchTest2();
+  case 3:
+    return searchTest3();
+  case 4:
+    return searchTest4();
+  case 5:
+    return searchTest5();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
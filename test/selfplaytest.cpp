@@ -0,0 +1,154 @@
+#include "nichess/nichess.hpp"
+#include "nichess/packedposition.hpp"
+#include "nichess/policy.hpp"
+#include "nichess/selfplay.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+using namespace nichess;
+
+/*
+ * Reads every shard back, checks that the policies are distributions over legal actions and
+ * counts samples and games. Removes the shards.
+ */
+static bool checkShards(const std::vector<std::string>& paths, const SelfPlayStats& stats, size_t maxShardSize,
+    bool spreadPolicy) {
+  uint64_t samples = 0;
+  uint64_t games = 0;
+  bool ok = true;
+  bool spread = false;
+  Game g;
+  SelfPlaySample sample;
+  std::vector<uint16_t> indices(MAX_SPARSE_POLICY_LENGTH);
+  std::vector<float> fractions(MAX_SPARSE_POLICY_LENGTH);
+  for(const std::string& path: paths) {
+    SelfPlayShardReader reader;
+    reader.load(path);
+    uint64_t shardSamples = 0;
+    while(reader.next(sample)) {
+      unpackPosition(sample.position, MAX_PACKED_POSITION_SIZE, g);
+      size_t length = decodeSparsePolicy(sample.policy, indices.data(), fractions.data());
+      if(sample.outcome < -1 || sample.outcome > 1 || length == 0) ok = false;
+      float sum = 0;
+      for(size_t i = 0; i < length; i++) {
+        if(!policyAction(g, indices[i])) ok = false;
+        sum += fractions[i];
+      }
+      if(std::abs(sum - 1) > 1e-4f) ok = false;
+      if(length > 1) spread = true;
+      shardSamples++;
+    }
+    if(shardSamples != reader.numSamples()) ok = false;
+    samples += shardSamples;
+    games += reader.numGames();
+    FILE* f = std::fopen(path.c_str(), "rb");
+    std::fseek(f, 0, SEEK_END);
+    if((size_t)std::ftell(f) > maxShardSize) ok = false;
+    std::fclose(f);
+    std::remove(path.c_str());
+  }
+  if(spreadPolicy && !spread) ok = false;
+  if(samples != stats.positions || games != stats.games) {
+    std::cout << samples << " samples and " << games << " games in the shards, expected " << stats.positions << " and " << stats.games << "\n";
+    return false;
+  }
+  return ok;
+}
+
+// Random games on two threads, written to several small shards.
+int selfplayTest1() {
+  SelfPlayConfig config;
+  config.engine = SelfPlayEngine::RANDOM;
+  config.numThreads = 2;
+  config.numGames = 40;
+  config.shardPrefix = "selfplaytest1";
+  config.blockSize = 4096;
+  config.shardSize = 32768;
+  SelfPlay selfPlay(config);
+  SelfPlayStats stats = selfPlay.run();
+  std::vector<std::string> shards = selfPlay.shards();
+  std::cout << stats.games << " games, " << stats.positions << " positions, " << shards.size() << " shards\n";
+  if(stats.games + stats.droppedGames != config.numGames || shards.size() < 2) return -1;
+  // A block ends with the game that fills it.
+  return checkShards(shards, stats, config.shardSize + config.blockSize, false) ? 0 : -1;
+}
+
+// MCTS policies spread over several actions, alpha-beta plays, stop ends an endless run.
+int selfplayTest2() {
+  SelfPlayConfig config;
+  config.engine = SelfPlayEngine::MCTS;
+  config.numGames = 2;
+  config.mctsLimits.visits = 64;
+  config.maxPlies = 30;
+  config.shardPrefix = "selfplaytest2";
+  SelfPlay mcts(config);
+  SelfPlayStats stats = mcts.run();
+  if(stats.games != 2 || stats.positions == 0 || !checkShards(mcts.shards(), stats, SIZE_MAX, true)) return -1;
+
+  config.engine = SelfPlayEngine::ALPHA_BETA;
+  config.searchLimits.depth = 2;
+  SelfPlay alphaBeta(config);
+  stats = alphaBeta.run();
+  if(stats.games != 2 || stats.positions == 0 || !checkShards(alphaBeta.shards(), stats, SIZE_MAX, false)) return -1;
+
+  config.engine = SelfPlayEngine::RANDOM;
+  config.numGames = 0;
+  config.numThreads = 2;
+  SelfPlay endless(config);
+  std::thread stopper([&endless]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    endless.stop();
+  });
+  stats = endless.run();
+  stopper.join();
+  std::cout << stats.games << " games before stop\n";
+  return stats.games > 0 && checkShards(endless.shards(), stats, SIZE_MAX, false) ? 0 : -1;
+}
+
+// Benchmark, random games on every core.
+int selfplayTest3() {
+  SelfPlayConfig config;
+  config.engine = SelfPlayEngine::RANDOM;
+  config.numThreads = std::max(1U, std::thread::hardware_concurrency());
+  config.numGames = 400;
+  config.shardPrefix = "selfplaytest3";
+  SelfPlay selfPlay(config);
+  SelfPlayStats stats = selfPlay.run();
+  std::cout << config.numThreads << " threads: " << (uint64_t)stats.gamesPerHour << " games per hour, "
+    << (uint64_t)stats.positionsPerSecond << " positions per second, " << stats.bytesWritten << " bytes\n";
+  for(const std::string& path: selfPlay.shards()) {
+    std::remove(path.c_str());
+  }
+  return stats.games + stats.droppedGames == config.numGames ? 0 : -1;
+}
+
+int selfplaytest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return selfplayTest1();
+  case 2:
+    return selfplayTest2();
+  case 3:
+    return selfplayTest3();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
@@ -0,0 +1,146 @@
+#include "nichess/nichess.hpp"
+#include "nichess/search.hpp"
+#include "nichess/solver.hpp"
+#include "testboards.hpp"
+
+#include <iostream>
+#include <random>
+
+using namespace nichess;
+
+// Positions from random games, skipping ahead so that the kings are exposed.
+static std::vector<Game> solverRandomPositions(int count, unsigned int seed) {
+  std::mt19937 rng(seed);
+  std::vector<Game> positions;
+  while((int)positions.size() < count) {
+    Game g = Game();
+    int plies = 40 + rng() % 120;
+    for(int ply = 0; ply < plies && !g.isGameOver(); ply++) {
+      std::vector<PlayerAction> actions = g.generateLegalActions();
+      if(actions.empty()) break;
+      g.makeAction(actions[rng() % actions.size()]);
+    }
+    if(!g.isGameOver() && !g.generateLegalActions().empty()) {
+      positions.emplace_back(g);
+    }
+  }
+  return positions;
+}
+
+int solverTest1() {
+  Game g = Game(kingKillBoard());
+  KingKillSolver solver;
+  SolverOutcome outcome = solver.solve(g);
+  std::cout << "plies: " << outcome.plies << " nodes: " << outcome.nodes << "\n";
+  if(outcome.result == SolverResult::WIN && outcome.plies == 1 && outcome.bestAction == PlayerAction(4, 13, ActionType::ABILITY_KING_DAMAGE)) {
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+// Agrees with a fixed depth alpha-beta search.
+int solverTest2() {
+  std::vector<Game> positions = solverRandomPositions(60, 1);
+  SolverTable table(16);
+  KingKillSolver solver(&table);
+  solver.maxPlies = 3;
+  int wins = 0;
+  for(Game& g: positions) {
+    std::string before = g.boardToString();
+    SolverOutcome outcome = solver.solve(g);
+    if(outcome.result == SolverResult::UNKNOWN || g.boardToString() != before) return -1;
+
+    AlphaBetaSearch search;
+    SearchLimits limits;
+    limits.depth = 3;
+    SearchResult result = search.search(g, limits);
+    bool searchWin = result.score >= MATE_BOUND;
+    if(searchWin != (outcome.result == SolverResult::WIN)) {
+      std::cout << "solver and search disagree on " << before << "\n";
+      return -1;
+    }
+    if(outcome.result == SolverResult::WIN) {
+      wins++;
+      if(result.score != MATE_SCORE - outcome.plies) return -1;
+    }
+  }
+  std::cout << wins << " wins in " << positions.size() << " positions\n";
+  return wins > 0 ? 0 : -1;
+}
+
+// Node budget, shared table and the search hook, which keeps to the search's limits.
+int solverTest3() {
+  std::vector<Game> positions = solverRandomPositions(20, 2);
+  SolverTable table(16);
+  KingKillSolver solver(&table);
+  solver.maxPlies = 5;
+  solver.nodeBudget = 50;
+  bool unknown = false;
+  for(Game& g: positions) {
+    unknown = unknown || solver.solve(g).result == SolverResult::UNKNOWN;
+  }
+  if(!unknown) return -1;
+
+  solver.nodeBudget = 1 << 20;
+  uint64_t firstNodes = 0;
+  uint64_t secondNodes = 0;
+  for(int pass = 0; pass < 2; pass++) {
+    for(Game& g: positions) {
+      SolverOutcome outcome = solver.solve(g);
+      (pass == 0 ? firstNodes : secondNodes) += outcome.nodes;
+    }
+  }
+  std::cout << "nodes: " << firstNodes << " with a filled table: " << secondNodes << "\n";
+  if(secondNodes >= firstNodes) return -1;
+
+  Game g = Game(kingKillBoard());
+  AlphaBetaSearch search;
+  search.solver = &solver;
+  SearchLimits limits;
+  limits.depth = 4;
+  SearchResult result = search.search(g, limits);
+  if(result.bestAction != PlayerAction(4, 13, ActionType::ABILITY_KING_DAMAGE) || result.score != MATE_SCORE - 1) return -1;
+
+  // A default solver takes seconds to give up on the start position.
+  KingKillSolver slowSolver;
+  search.solver = &slowSolver;
+  Game start = Game();
+  limits = SearchLimits();
+  limits.hardDeadline = 20;
+  result = search.search(start, limits);
+  std::cout << "hard deadline 20 ms: " << result.elapsed << " microseconds\n";
+  if(result.elapsed > 21000 || !result.stopped) return -1;
+  limits = SearchLimits();
+  limits.nodes = 2000;
+  result = search.search(start, limits);
+  std::cout << "node budget 2000: " << result.nodes << " nodes\n";
+  if(result.nodes > 2000 + 100) return -1;
+  return 0;
+}
+
+int solvertest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return solverTest1();
+  case 2:
+    return solverTest2();
+  case 3:
+    return solverTest3();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
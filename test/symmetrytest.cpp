@@ -0,0 +1,169 @@
+#include "nichess/nichess.hpp"
+#include "nichess/policy.hpp"
+#include "nichess/solver.hpp"
+#include "nichess/symmetry.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+using namespace nichess;
+
+static std::vector<PackedAction> sortedActions(const std::vector<PlayerAction>& actions) {
+  std::vector<PackedAction> packed;
+  for(const PlayerAction& action: actions) {
+    packed.push_back(packAction(action));
+  }
+  std::sort(packed.begin(), packed.end());
+  return packed;
+}
+
+// Mirrored positions have the mirrored actions and hash, mirroring twice gives the position back.
+int symmetryTest1() {
+  std::mt19937 rng(1);
+  int mirrored = 0;
+  int castles = 0;
+  std::vector<uint8_t> policy;
+  std::vector<uint8_t> policyMirror;
+  for(int i = 0; i < 100; i++) {
+    Game g = Game();
+    for(int ply = 0; ply < 80 && !g.isGameOver(); ply++) {
+      std::vector<PlayerAction> actions = g.generateLegalActions();
+      if(actions.empty()) break;
+      if(canonicalKey(g).key != (uint64_t)g.zobristHash() && !mirrorIsExact(g)) return -1;
+      bool castle = std::any_of(actions.begin(), actions.end(), [](const PlayerAction& a) {
+        return a.actionType == ActionType::MOVE_CASTLE;
+      });
+      if(castle) {
+        castles++;
+        if(mirrorPreservesActions(g)) return -1;
+      }
+      if(mirrorPreservesActions(g)) {
+        Game m = Game(g);
+        mirrorGame(m);
+        std::vector<PlayerAction> mirroredActions;
+        std::vector<uint32_t> visits;
+        for(const PlayerAction& action: actions) {
+          mirroredActions.push_back(mirrorAction(action));
+          if(mirrorPolicyIndex(policyIndex(action)) != policyIndex(mirroredActions.back())) return -1;
+          visits.push_back(1 + rng() % 10);
+        }
+        if(sortedActions(m.generateLegalActions()) != sortedActions(mirroredActions)) return -1;
+        if((uint64_t)m.zobristHash() != mirroredZobristHash(g) || mirroredZobristHash(m) != (uint64_t)g.zobristHash()) return -1;
+
+        policy.resize(maxSparsePolicySize(actions.size()));
+        policyMirror.resize(policy.size());
+        size_t size = encodeSparsePolicy(actions.data(), visits.data(), actions.size(), policy.data());
+        mirrorSparsePolicy(policy.data(), policyMirror.data());
+        std::vector<uint8_t> expected(policy.size());
+        encodeSparsePolicy(mirroredActions.data(), visits.data(), actions.size(), expected.data());
+        if(!std::equal(expected.begin(), expected.begin() + size, policyMirror.begin())) return -1;
+
+        mirrorGame(m);
+        if(m.boardToString() != g.boardToString()) return -1;
+        mirrored++;
+      }
+      g.makeAction(actions[rng() % actions.size()]);
+    }
+  }
+  try {
+    mirrorAction(PlayerAction(4, 6, ActionType::MOVE_CASTLE));
+    return -1;
+  } catch(const std::runtime_error& e) {
+  }
+  std::cout << mirrored << " positions mirrored, " << castles << " with castles\n";
+  return mirrored > 0 && castles > 0 ? 0 : -1;
+}
+
+// Random boards where nobody can castle, kings, mages, assassins and knights only.
+static std::string noCastleBoard(std::mt19937& rng) {
+  const char* types[] = {"mage", "assassin", "knight"};
+  const int healthPoints[] = {10, 10, 60};
+  std::vector<std::string> squares(NUM_SQUARES, "empty");
+  for(int player = 0; player < 2; player++) {
+    int square;
+    do {
+      square = rng() % NUM_SQUARES;
+    } while(squares[square] != "empty");
+    squares[square] = std::to_string(player) + "-king-10";
+  }
+  int numPieces = 2 + rng() % 8;
+  for(int i = 0; i < numPieces; i++) {
+    int square = rng() % NUM_SQUARES;
+    int type = rng() % 3;
+    if(squares[square] != "empty") continue;
+    squares[square] = std::to_string(rng() % 2) + "-" + types[type] + "-" + std::to_string(healthPoints[type]);
+  }
+  std::string board = std::to_string(rng() % 2) + "|";
+  for(const std::string& square: squares) {
+    board += square + ",";
+  }
+  return board;
+}
+
+// Mirror images share canonical keys and solver results where nobody can castle.
+int symmetryTest2() {
+  std::mt19937 rng(2);
+  // Small solvers, only their agreement matters.
+  SolverTable table(1);
+  KingKillSolver solver(&table);
+  solver.maxPlies = 3;
+  solver.nodeBudget = 1 << 14;
+  int wins = 0;
+  for(int i = 0; i < 300; i++) {
+    Game g = Game(noCastleBoard(rng));
+    if(g.isGameOver() || !mirrorIsExact(g) || !mirrorPreservesActions(g)) return -1;
+    Game m = Game(g);
+    mirrorGame(m);
+    CanonicalKey key = canonicalKey(g);
+    CanonicalKey mirroredKey = canonicalKey(m);
+    if(key.key != mirroredKey.key) return -1;
+    if(key.key != std::min((uint64_t)g.zobristHash(), (uint64_t)m.zobristHash())) return -1;
+    if(key.mirrored != (key.key != (uint64_t)g.zobristHash())) return -1;
+
+    // The mirror image is answered from the table, a solver of its own finds the same.
+    SolverResult result = solver.solve(g).result;
+    if(result == SolverResult::UNKNOWN) continue;
+    if(solver.solve(m).result != result) return -1;
+    SolverTable freshTable(1);
+    KingKillSolver fresh(&freshTable);
+    fresh.maxPlies = solver.maxPlies;
+    fresh.nodeBudget = solver.nodeBudget;
+    SolverResult freshResult = fresh.solve(m).result;
+    if(freshResult != SolverResult::UNKNOWN && freshResult != result) return -1;
+    if(result == SolverResult::WIN) wins++;
+  }
+  // A pawn is enough to keep mirror images apart.
+  Game g = Game("0|0-king-10,empty,empty,empty,empty,empty,empty,empty,0-pawn-30,empty,empty,empty,empty,empty,empty,empty,"
+    "empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,"
+    "empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,"
+    "empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,empty,1-king-10,");
+  if(mirrorIsExact(g) || canonicalKey(g).key != (uint64_t)g.zobristHash()) return -1;
+  std::cout << wins << " wins\n";
+  return 0;
+}
+
+int symmetrytest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return symmetryTest1();
+  case 2:
+    return symmetryTest2();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
@@ -0,0 +1,156 @@
+#include "nichess/nichess.hpp"
+#include "nichess/search.hpp"
+#include "nichess/tablebase.hpp"
+#include "nichess/util.hpp"
+#include "testboards.hpp"
+
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+using namespace nichess;
+
+static const std::string TABLEBASE_TEST_DIRECTORY = (std::filesystem::temp_directory_path() / "tablebasetest").string();
+
+static void printStats(const std::vector<TablebaseStats>& stats) {
+  for(const TablebaseStats& s: stats) {
+    std::cout << s.name << ": " << s.positions << " positions, " << s.wins << " wins, " << s.losses << " losses, "
+      << s.draws << " draws, " << s.invalid << " invalid, " << s.seconds << " s\n";
+  }
+}
+
+int tablebaseTest1() {
+  Game expected = Game(boardString(PLAYER_2, {{4, "0-king-10"}, {20, "0-warrior-40"}, {50, "1-king-10"}}));
+  Game g = Game();
+  g.setPieces({Piece(P1_KING, 10, 4), Piece(P1_WARRIOR, 40, 20), Piece(P2_KING, 10, 50)}, PLAYER_2);
+  if(g.boardToString() != expected.boardToString() || !(g.evalAccumulator == expected.evalAccumulator) || g.zobristHash() != expected.zobristHash()) {
+    return -1;
+  }
+  try {
+    g.setPieces({Piece(P1_KING, 10, 4)}, PLAYER_1);
+    return -1;
+  } catch(const std::runtime_error& e) {
+  }
+  return 0;
+}
+
+/*
+ * Checks a position against its successors: a win needs one action that kills the king or leads to
+ * a loss, a loss needs every action to lead to a win.
+ */
+static bool consistent(Game& game, const Tablebase& tablebase) {
+  std::optional<TablebaseResult> value = tablebase.probe(game);
+  if(!value) return false;
+  Player player = game.currentPlayer;
+  std::vector<PlayerAction> actions = game.generateLegalActions();
+  bool canWin = false;
+  bool allLose = !actions.empty();
+  for(const PlayerAction& action: actions) {
+    UndoInfo undoInfo = game.makeAction(action);
+    if(game.playerToKing[~player]->healthPoints <= 0) {
+      canWin = true;
+      allLose = false;
+    } else {
+      std::optional<TablebaseResult> childValue = tablebase.probe(game);
+      if(!childValue) return false;
+      if(*childValue == TablebaseResult::LOSS) canWin = true;
+      if(*childValue != TablebaseResult::WIN) allLose = false;
+    }
+    game.undoAction(undoInfo);
+  }
+  switch(*value) {
+    case TablebaseResult::WIN: return canWin;
+    case TablebaseResult::LOSS: return allLose;
+    case TablebaseResult::DRAW: return !canWin && !allLose;
+    default: return false;
+  }
+}
+
+int tablebaseTest2() {
+  mkdir(TABLEBASE_TEST_DIRECTORY.c_str(), 0755);
+  TablebaseGenerator generator(TABLEBASE_TEST_DIRECTORY, 2);
+  std::vector<TablebaseStats> stats = generator.generate({P2_KING, P1_MAGE, P1_KING});
+  printStats(stats);
+  if(stats.size() != 2 || stats[0].name != "Kk" || stats[1].name != "KMk") return -1;
+
+  Tablebase tablebase;
+  int numTables = tablebase.loadDirectory(TABLEBASE_TEST_DIRECTORY);
+  if(numTables < 2 || tablebase.maxPieces() != 3) return -1;
+  Game start = Game();
+  if(tablebase.probe(start)) return -1;
+
+  std::mt19937 rng(1);
+  Game g = Game();
+  int checked = 0;
+  int wins = 0;
+  while(checked < 3000) {
+    int squares[3] = {(int)(rng() % 64), (int)(rng() % 64), (int)(rng() % 64)};
+    if(squares[0] == squares[1] || squares[0] == squares[2] || squares[1] == squares[2]) continue;
+    g.setPieces({Piece(P1_KING, 10, squares[0]), Piece(P1_MAGE, 10, squares[1]), Piece(P2_KING, 10, squares[2])}, (Player)(rng() % 2));
+    if(!consistent(g, tablebase)) {
+      std::cout << "inconsistent: " << g.boardToString() << "\n";
+      return -1;
+    }
+    std::optional<TablebaseResult> value = tablebase.probe(g);
+    if(*value == TablebaseResult::WIN) {
+      wins++;
+      // The search has to see the win even when the king kill is beyond its depth.
+      AlphaBetaSearch search;
+      search.tablebase = &tablebase;
+      SearchLimits limits;
+      limits.depth = 2;
+      SearchResult result = search.search(g, limits);
+      if(result.score < TABLEBASE_WIN_SCORE - MAX_SEARCH_DEPTH) return -1;
+    }
+    checked++;
+  }
+  std::cout << "checked " << checked << " positions, " << wins << " wins\n";
+  std::filesystem::remove_all(TABLEBASE_TEST_DIRECTORY);
+  return 0;
+}
+
+int tablebaseTest3() {
+  const std::string path = TABLEBASE_TEST_DIRECTORY + "_bad.ntb";
+  std::ofstream out(path, std::ios::binary);
+  out << "not a tablebase";
+  out.close();
+  Tablebase tablebase;
+  bool rejected = false;
+  try {
+    tablebase.load(path);
+  } catch(const std::runtime_error& e) {
+    rejected = true;
+  }
+  std::remove(path.c_str());
+  return rejected && tablebase.numTables() == 0 ? 0 : -1;
+}
+
+int tablebasetest(int argc, char* argv[]) {
+  int defaultchoice = 1;
+  int choice = defaultchoice;
+
+  if (argc > 1) {
+    if(sscanf(argv[1], "%d", &choice) != 1) {
+      printf("Couldn't parse that input as a number\n");
+      return -1;
+    }
+  }
+
+  switch(choice) {
+  case 1:
+    return tablebaseTest1();
+  case 2:
+    return tablebaseTest2();
+  case 3:
+    return tablebaseTest3();
+  default:
+    printf("\nInvalid test number.\n");
+    return -1;
+  }
+
+  return -1;
+}
@@ -0,0 +1,19 @@
+#include "testboards.hpp"
+
+using namespace nichess;
+
+std::string boardString(Player player, const std::vector<std::pair<int, std::string>>& pieces) {
+  std::vector<std::string> squares(NUM_SQUARES, "empty");
+  for(const auto& piece: pieces) {
+    squares[piece.first] = piece.second;
+  }
+  std::string retval = std::to_string(player) + "|";
+  for(const std::string& square: squares) {
+    retval += square + ",";
+  }
+  return retval;
+}
+
+std::string kingKillBoard() {
+  return boardString(PLAYER_1, {{4, "0-king-10"}, {13, "1-king-10"}, {63, "1-warrior-60"}});
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "nichess/nichess.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * Boards shared by the tests, in the format of Game(std::string).
+ */
+
+// Every square empty but the given (square, piece) pairs, player to move.
+std::string boardString(nichess::Player player, const std::vector<std::pair<int, std::string>>& pieces);
+// P1 king on 4, P2 king on 13 and P2 warrior on 63, P1 to move. Killing the king is the only
+// winning action.
+std::string kingKillBoard();